@@ -0,0 +1,684 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#include "Benchmark/Nsv_Generator.h"
+#include "Common/Adts_Validator.h"
+#include "Common/Core.h"
+#include "Common/Matroska_Writer.h"
+#include "Common/Template_Engine.h"
+#include "ZenLib/Dir.h"
+#include "ZenLib/File.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Options
+//***************************************************************************
+
+struct options
+{
+    // Input files
+    nsv_config          Nsv;
+    size_t              Files = 10;
+
+    // Micro-benchmarks
+    Ztring              TemplatesPath;      // Default is the current directory
+    size_t              Chapters = 100;
+    float64             MinTime = 1;        // In seconds, per benchmark
+
+    // Check
+    Ztring              SamplesPath;        // Real AAC streams
+
+    // Process
+    Ztring              TempPath;
+    size_t              ThreadCount = 0;
+    bool                Mkvmerge = false;
+    bool                Streaming = false;
+    vector<pair<string, string>> Stubs;     // Environment of the stub tools
+
+    // Results
+    Ztring              Output;             // JSON Lines, appended
+    string              Label;              // e.g. the tested revision
+};
+
+//***************************************************************************
+// Results
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+static string Json_Escape(const string& Value)
+{
+    string ToReturn;
+    for (auto Item : Value)
+    {
+        if (Item == '"' || Item == '\\')
+            ToReturn += '\\';
+        if ((unsigned char)Item < 0x20)
+        {
+            char Temp[7];
+            snprintf(Temp, sizeof(Temp), "\\u%04X", (unsigned char)Item);
+            ToReturn += Temp;
+        }
+        else
+            ToReturn += Item;
+    }
+    return ToReturn;
+}
+
+//---------------------------------------------------------------------------
+static string Json_Number(float64 Value)
+{
+    char Temp[32];
+    snprintf(Temp, sizeof(Temp), "%.6g", Value);
+    return Temp;
+}
+
+//---------------------------------------------------------------------------
+struct result
+{
+    string              Name;
+    size_t              Iterations = 0;
+    float64             Seconds = 0;        // All iterations
+    int64u              Bytes = 0;          // Per iteration
+    string              Extra;              // JSON members
+};
+
+//---------------------------------------------------------------------------
+// A JSON object per line, so results of several runs and versions can be appended to the same file
+class results
+{
+public:
+    results(const options& Options_) : Options(Options_) {}
+
+    bool Add(const result& Result, const string& Params)
+    {
+        char Date[32];
+        auto Now = time(nullptr);
+        strftime(Date, sizeof(Date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&Now));
+
+        string Line = "{\"benchmark\":\"" + Json_Escape(Result.Name) + '"';
+        Line += ",\"version\":\"" Program_Version "\"";
+        Line += ",\"mediainfo\":\"" + Json_Escape(MediaInfo_Version()) + '"';
+        if (!Options.Label.empty())
+            Line += ",\"label\":\"" + Json_Escape(Options.Label) + '"';
+        Line += ",\"date\":\"" + string(Date) + '"';
+        Line += ",\"params\":{" + Params + '}';
+        Line += ",\"iterations\":" + to_string(Result.Iterations);
+        Line += ",\"seconds\":" + Json_Number(Result.Seconds);
+        if (Result.Iterations)
+            Line += ",\"ms_per_iteration\":" + Json_Number(Result.Seconds * 1000 / Result.Iterations);
+        if (Result.Bytes && Result.Seconds)
+            Line += ",\"mib_per_second\":" + Json_Number(Result.Bytes * Result.Iterations / Result.Seconds / (1024 * 1024));
+        Line += Result.Extra;
+        Line += "}\n";
+
+        cerr << Result.Name << ": " << Json_Number(Result.Iterations ? Result.Seconds * 1000 / Result.Iterations : 0) << " ms\n";
+        if (Options.Output.empty())
+        {
+            cout << Line;
+            return true;
+        }
+        File F;
+        if (!F.Open(Options.Output, File::Access_Write_Append) && !F.Create(Options.Output))
+            return false;
+        auto Written = F.Write((const int8u*)Line.data(), Line.size());
+        F.Close();
+        return Written == Line.size();
+    }
+
+private:
+    const options&      Options;
+};
+
+//---------------------------------------------------------------------------
+static string Params_Nsv(const nsv_config& Config)
+{
+    return "\"duration_ms\":" + to_string(Config.Duration)
+         + ",\"channels\":" + to_string(Config.ChannelCount)
+         + ",\"sps_patch_ratio\":" + Json_Number(Config.SpsPatch_Ratio)
+         + ",\"corruption_ratio\":" + Json_Number(Config.AdtsCorruption_Ratio)
+         + ",\"seed\":" + to_string(Config.Seed);
+}
+
+//---------------------------------------------------------------------------
+// After a warm-up run, the function is run until MinTime is reached
+template<typename F> static result Measure(const char* Name, float64 MinTime, F Function)
+{
+    Function();
+
+    result Result;
+    Result.Name = Name;
+    auto Start = chrono::steady_clock::now();
+    do
+    {
+        Function();
+        Result.Iterations++;
+        Result.Seconds = chrono::duration<float64>(chrono::steady_clock::now() - Start).count();
+    }
+    while (Result.Seconds < MinTime);
+    return Result;
+}
+
+//---------------------------------------------------------------------------
+// Packets as given by MediaInfo to the demux callback, contents are in Frames
+static vector<MediaInfo_Event_Global_Demux_4> Demux_Events(const vector<nsv_frame>& Frames, int64u* Bytes = nullptr)
+{
+    vector<MediaInfo_Event_Global_Demux_4> Events;
+    for (const auto& Frame : Frames)
+        for (size_t i = 0; i < 2; i++)
+        {
+            const auto& Content = i ? Frame.Audio : Frame.Video;
+            MediaInfo_Event_Global_Demux_4 Event;
+            memset(&Event, 0, sizeof(Event));
+            Event.EventCode = MediaInfo_Event_Global_Demux;
+            Event.EventSize = sizeof(Event);
+            Event.StreamIDs_Size = 1;
+            Event.StreamIDs[0] = i;
+            Event.PTS = Frame.PTS;
+            Event.DTS = Frame.PTS;
+            Event.Content = Content.data();
+            Event.Content_Size = Content.size();
+            Events.push_back(Event);
+            if (Bytes)
+                *Bytes += Content.size();
+        }
+    return Events;
+}
+
+//***************************************************************************
+// Commands
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+static int Generate(const options& Options, const Ztring& Dir_Name)
+{
+    Dir::Create(Dir_Name);
+    auto Config = Options.Nsv;
+    for (size_t i = 0; i < Options.Files; i++)
+    {
+        Ztring FileName = Dir_Name + __T("/Benchmark_") + Ztring::ToZtring(i) + __T(".nsv");
+        nsv_stats Stats;
+        if (!Nsv_Write(FileName, Config, &Stats))
+        {
+            cerr << "Error: can not write " << FileName.To_Local() << ".\n";
+            return 1;
+        }
+        cerr << FileName.To_Local() << ": " << Stats.SpsPatches << " SPS to patch, " << Stats.Aac_Corrupted << '/' << Stats.Aac_Frames << " AAC frames corrupted\n";
+        Config.Seed++;
+    }
+    return 0;
+}
+
+//---------------------------------------------------------------------------
+static int Micro(const options& Options)
+{
+    results Results(Options);
+    auto Params = Params_Nsv(Options.Nsv);
+    auto TempNamePrefix = Options.TempPath + __T("LeaveSD_Benchmark_temp");
+
+    // Core::Frame, first pass and second pass
+    {
+        nsv_stats Stats;
+        auto Frames = Nsv_Frames(Options.Nsv, &Stats);
+        int64u Bytes = 0;
+        auto Events = Demux_Events(Frames, &Bytes);
+
+        Core C;
+        Ztring ChannelCount = Options.Nsv.ChannelCount == 1 ? __T("1") : __T("8");
+        for (size_t i = 0; i < 2; i++)
+        {
+            size_t Invalid = 0;
+            auto Result = Measure(i ? "frame_fullcheck" : "frame_fast", Options.MinTime, [&]()
+            {
+                Invalid = C.Frame_Replay(Events, i != 0, ChannelCount, TempNamePrefix);
+            });
+            if (Invalid == (size_t)-1)
+            {
+                cerr << "Error: can not write temporary files in " << (Options.TempPath.empty() ? string("current directory") : Options.TempPath.To_Local()) << ".\n";
+                return 1;
+            }
+            Result.Bytes = Bytes;
+            Result.Extra = ",\"packets\":" + to_string(Events.size()) + ",\"invalid_audio_packets\":" + to_string(Invalid) + ",\"sps_patches\":" + to_string(Stats.SpsPatches);
+            if (!Results.Add(Result, Params))
+                return 1;
+        }
+    }
+
+    // Templates
+    {
+        auto TemplatesPath = Options.TemplatesPath;
+        if (!TemplatesPath.empty() && TemplatesPath.back() != __T('/') && TemplatesPath.back() != __T('\\'))
+            TemplatesPath += __T('/');
+        text_template Encode;
+        mkvmerge_command Mux_Command;
+        if (!Encode.Load(TemplatesPath + __T("LeaveSD_Encode.txt")) || !Mux_Command.Load(TemplatesPath + __T("LeaveSD_Mux_Command_Template.json")))
+            cerr << "Warning: templates not found in " << (TemplatesPath.empty() ? string("current directory") : TemplatesPath.To_Local()) << ", template benchmarks are skipped.\n";
+        else
+        {
+            template_values Values;
+            Values.Fields[Field_TempPath] = TempNamePrefix + __T("0");
+            Values.Fields[Field_Channels] = __T("8");
+            Values.Fields[Field_AacProfile] = __T("aac_he");
+            Values.Fields[Field_DelayV] = __T("0");
+            Values.Fields[Field_DelayA] = __T("120");
+            size_t Size = 0;
+            auto Result = Measure("template_encode", Options.MinTime, [&]()
+            {
+                for (size_t i = 0; i < 1000; i++)
+                    Size += Encode.Render(Values).size();
+            });
+            Result.Extra = ",\"renders_per_iteration\":1000";
+            if (!Results.Add(Result, string()))
+                return 1;
+            Result = Measure("template_mux_command", Options.MinTime, [&]()
+            {
+                for (size_t i = 0; i < 1000; i++)
+                    Size += Mux_Command.Json(Values).size();
+            });
+            Result.Extra = ",\"renders_per_iteration\":1000";
+            if (!Results.Add(Result, string()))
+                return 1;
+        }
+    }
+
+    // Chapters, mkvmerge XML file and native writer
+    {
+        vector<mkv_chapter> Chapters;
+        for (size_t i = 0; i < Options.Chapters; i++)
+            Chapters.push_back({ (int64u)i * 61000, "Chapter " + to_string(i + 1), "eng", i % 4 != 0 });
+        auto Chapters_Params = "\"chapters\":" + to_string(Options.Chapters);
+        size_t Size = 0;
+        auto Result = Measure("chapters_xml", Options.MinTime, [&]()
+        {
+            for (size_t i = 0; i < 100; i++)
+                Size += Chapters_Xml(Chapters).size();
+        });
+        Result.Extra = ",\"builds_per_iteration\":100";
+        if (!Results.Add(Result, Chapters_Params))
+            return 1;
+
+        matroska_writer Writer;
+        Writer.App = "LeaveSD v." Program_Version;
+        Writer.Chapters = Chapters;
+        auto FileName = TempNamePrefix + __T(".mkv");
+        bool WriteError = false;
+        Result = Measure("chapters_mkv", Options.MinTime, [&]()
+        {
+            if (!Writer.Write(FileName))
+                WriteError = true;
+        });
+        File::Delete(FileName);
+        if (WriteError)
+        {
+            cerr << "Error: " << Writer.ErrorMessage << ".\n";
+            return 1;
+        }
+        if (!Results.Add(Result, Chapters_Params))
+            return 1;
+    }
+
+    return 0;
+}
+
+//---------------------------------------------------------------------------
+// Real AAC LC streams, 44.1 kHz, from the ffmpeg 7.0 native encoder (-aac_pce 1 for 2 and 8 channels, so with channel_configuration 0)
+// Mono_96k_Pulse has pulse_data added by a bit-level edit to a long window ICS of half of the frames, as no encoder writes it
+struct check_sample
+{
+    const char*         Name;
+    const Char*         Channels;
+    const char*         Features;
+};
+static const check_sample Check_Samples[] =
+{
+    { "Mono_32k.aac",               __T("1"), "short windows, TNS, noise substitution" },
+    { "Mono_96k_Pulse.aac",         __T("1"), "pulse data, short windows, most codebooks" },
+    { "Mono_256k.aac",              __T("1"), "escape codebook with long escape sequences" },
+    { "Stereo_48k_MS_IS.aac",       __T("2"), "common window with M/S, intensity stereo" },
+    { "Stereo_128k.aac",            __T("2"), "independent windows, all spectral codebooks" },
+    { "Channels_8_320k.aac",        __T("8"), "7.1 with PCE in the first frame then implicit mapping, LFE" },
+};
+static const size_t Check_Sample_Corruptions = 16; // Per frame
+
+//---------------------------------------------------------------------------
+// Checks of the results on synthetic streams, not timed
+static int Check(const options& Options)
+{
+    auto TempNamePrefix = Options.TempPath + __T("LeaveSD_Benchmark_temp");
+    size_t Errors = 0;
+    auto Error = [&](const string& Message)
+    {
+        cerr << "Error: " << Message << ".\n";
+        Errors++;
+    };
+
+    // Clean streams, no packet is replaced by silence in the first pass or in the second pass
+    for (int8u ChannelCount : { 1, 8 })
+    {
+        auto Config = Options.Nsv;
+        Config.ChannelCount = ChannelCount;
+        Config.AdtsCorruption_Ratio = 0;
+        auto Frames = Nsv_Frames(Config);
+        auto Events = Demux_Events(Frames);
+        Core C;
+        for (size_t i = 0; i < 2; i++)
+        {
+            auto Invalid = C.Frame_Replay(Events, i != 0, ChannelCount == 1 ? __T("1") : __T("8"), TempNamePrefix);
+            if (Invalid == (size_t)-1)
+                Error("can not write temporary files");
+            else if (Invalid)
+                Error(to_string(Invalid) + " invalid audio packets in a clean " + to_string(ChannelCount) + " channel stream, " + (i ? "second" : "first") + " pass");
+        }
+    }
+
+    // Corrupted streams, the native AAC check has the verdicts of the MediaInfo parser
+    for (int8u ChannelCount : { 1, 8 })
+        for (int32u Seed = 1; Seed <= 4; Seed++)
+        {
+            auto Config = Options.Nsv;
+            Config.ChannelCount = ChannelCount;
+            Config.AdtsCorruption_Ratio = 0.2;
+            Config.Seed = Seed;
+            auto Frames = Nsv_Frames(Config);
+            const Char* Channels = ChannelCount == 1 ? __T("1") : __T("8");
+            adts_validator Validator;
+            size_t Checked = 0, Invalid = 0, Mismatches = 0;
+            for (const auto& Frame : Frames)
+            {
+                size_t Offset = 0;
+                while (Offset < Frame.Audio.size())
+                {
+                    auto Buffer = Frame.Audio.data() + Offset;
+                    auto Buffer_Size = Frame.Audio.size() - Offset;
+                    size_t Frame_Size;
+                    if (Validator.Header(Buffer, Buffer_Size, Frame_Size) != Adts_Valid)
+                    {
+                        Offset++;
+                        continue;
+                    }
+                    auto IsValid = Validator.Frame(Buffer, Buffer_Size, Frame_Size, Channels) == Adts_Valid;
+                    if (IsValid != (Validator.Frame_MediaInfo(Buffer, Buffer_Size, Frame_Size, Channels) == Adts_Valid))
+                        Mismatches++;
+                    Checked++;
+                    Invalid += !IsValid;
+                    Offset += Frame_Size;
+                }
+            }
+            if (!Invalid)
+                Error("no invalid audio packet in a corrupted " + to_string(ChannelCount) + " channel stream, seed " + to_string(Seed));
+            if (Mismatches)
+                Error(to_string(Mismatches) + " of " + to_string(Checked) + " audio packets with a verdict not the MediaInfo one in a corrupted " + to_string(ChannelCount) + " channel stream, seed " + to_string(Seed));
+        }
+
+    // Real streams and their corrupted copies, the native AAC check has the verdicts of the MediaInfo parser
+    if (Options.SamplesPath.empty())
+        cerr << "Warning: AAC samples not checked, use --samples <dir>.\n";
+    else
+        for (const auto& Sample : Check_Samples)
+        {
+            auto FileName = Options.SamplesPath + __T('/') + Ztring().From_Local(Sample.Name);
+            File F;
+            vector<int8u> Content;
+            if (F.Open(FileName))
+            {
+                Content.resize((size_t)F.Size_Get());
+                Content.resize(F.Read(Content.data(), Content.size()));
+            }
+            if (Content.empty())
+            {
+                Error(string("can not read ") + Sample.Name);
+                continue;
+            }
+
+            adts_validator Validator;
+            size_t Frames = 0, Rejected = 0, Checked = 0, Mismatches = 0;
+            int32u Random = 1;
+            auto Compare = [&](const int8u* Buffer, size_t Buffer_Size, size_t Frame_Size, const Char* Channels)
+            {
+                auto IsValid = Validator.Frame(Buffer, Buffer_Size, Frame_Size, Channels) == Adts_Valid;
+                if (IsValid != (Validator.Frame_MediaInfo(Buffer, Buffer_Size, Frame_Size, Channels) == Adts_Valid))
+                    Mismatches++;
+                Checked++;
+                return IsValid;
+            };
+            for (size_t Offset = 0; Offset < Content.size();)
+            {
+                auto Buffer = Content.data() + Offset;
+                auto Buffer_Size = Content.size() - Offset;
+                size_t Frame_Size;
+                if (Validator.Header(Buffer, Buffer_Size, Frame_Size) != Adts_Valid || Frame_Size > Buffer_Size)
+                {
+                    Error(string("unexpected ADTS header in ") + Sample.Name + " at byte " + to_string(Offset));
+                    break;
+                }
+                Frames++;
+                if (!Compare(Buffer, Buffer_Size, Frame_Size, Sample.Channels))
+                    Rejected++;
+                Compare(Buffer, Buffer_Size, Frame_Size, Sample.Channels[0] == __T('1') ? __T("2") : __T("1"));
+
+                // A bit flipped in the raw_data_block, most of them break the syntax
+                vector<int8u> Corrupted(Buffer, Buffer + Frame_Size);
+                for (size_t i = 0; i < Check_Sample_Corruptions; i++)
+                {
+                    Random = Random * 1103515245 + 12345;
+                    auto Bit = 7 * 8 + (Random >> 8) % ((Frame_Size - 7) * 8);
+                    Corrupted[Bit >> 3] ^= 0x80 >> (Bit & 7);
+                    Compare(Corrupted.data(), Corrupted.size(), Frame_Size, Sample.Channels);
+                    Corrupted[Bit >> 3] ^= 0x80 >> (Bit & 7);
+                }
+                Offset += Frame_Size;
+            }
+            if (Rejected)
+                Error(to_string(Rejected) + " of " + to_string(Frames) + " valid frames rejected in " + Sample.Name + " (" + Sample.Features + ')');
+            if (Mismatches)
+                Error(to_string(Mismatches) + " of " + to_string(Checked) + " frames with a verdict not the MediaInfo one in " + Sample.Name + " (" + Sample.Features + ')');
+        }
+
+    if (!Errors)
+        cerr << "All checks passed.\n";
+    return Errors ? 1 : 0;
+}
+
+//---------------------------------------------------------------------------
+static void Env_Set(const string& Name, const string& Value)
+{
+    #ifdef _WIN32
+        _putenv_s(Name.c_str(), Value.c_str());
+    #else
+        setenv(Name.c_str(), Value.c_str(), 1);
+    #endif
+}
+
+//---------------------------------------------------------------------------
+// Core::Process() with the stub tools, which must be next to this executable with the templates
+static int Process(const options& Options, const Ztring& Input, const Ztring& Output)
+{
+    results Results(Options);
+    string Params;
+    for (const auto& Stub : Options.Stubs)
+    {
+        Env_Set(Stub.first, Stub.second);
+        Params += ",\"" + Json_Escape(Stub.first) + "\":\"" + Json_Escape(Stub.second) + '"';
+    }
+
+    int64u Bytes = 0;
+    size_t Files = 0;
+    auto AllFiles = Dir::GetAllFileNames(Input);
+    for (const auto& FileName : AllFiles)
+        if (FileName.size() > 4 && FileName.find(__T(".nsv"), FileName.size() - 4) != (size_t)-1)
+        {
+            Bytes += File::Size_Get(FileName);
+            Files++;
+        }
+    if (!Files)
+    {
+        cerr << "Error: no NSV file in " << Input.To_Local() << ".\n";
+        return 1;
+    }
+
+    Core C;
+    C.Inputs.push_back(Input);
+    C.OutputDir = Output;
+    C.TempPath = Options.TempPath;
+    C.ThreadCount = Options.ThreadCount;
+    C.Mkvmerge = Options.Mkvmerge;
+    C.Streaming = Options.Streaming;
+
+    result Result;
+    Result.Name = "process";
+    Result.Iterations = 1;
+    Result.Bytes = Bytes;
+    auto Start = chrono::steady_clock::now();
+    auto ReturnValue = C.Process();
+    Result.Seconds = chrono::duration<float64>(chrono::steady_clock::now() - Start).count();
+    Result.Extra = ",\"files\":" + to_string(Files) + ",\"files_per_second\":" + Json_Number(Files / Result.Seconds) + ",\"success\":" + (ReturnValue == ReturnValue_OK ? "true" : "false");
+    Params = "\"threads\":" + to_string(C.ThreadCount) + ",\"mkvmerge\":" + (Options.Mkvmerge ? "true" : "false") + ",\"streaming\":" + (Options.Streaming ? "true" : "false") + Params;
+    if (!Results.Add(Result, Params))
+        return 1;
+    return ReturnValue == ReturnValue_OK ? 0 : 1;
+}
+
+//***************************************************************************
+// Main
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+static int Help(const char* Name)
+{
+    cerr <<
+        "Usage:\n"
+        "  " << Name << " generate <dir> [options]\n"
+        "    Synthetic NSV files\n"
+        "  " << Name << " micro [options]\n"
+        "    Micro-benchmarks of demux callbacks, templates and chapters\n"
+        "  " << Name << " check [options]\n"
+        "    Checks of the results on synthetic streams, and of the AAC check against MediaInfo\n"
+        "  " << Name << " process <input dir> <output dir> [options]\n"
+        "    Full conversion, faad, ffmpeg and mkvmerge stubs (copies of LeaveSD_StubTool)\n"
+        "    and templates must be next to this executable\n"
+        "\n"
+        "Synthetic files:\n"
+        "  --files <count>            Count of generated files (default 10)\n"
+        "  --duration <s>             Duration of a file (default 60)\n"
+        "  --channels <1|8>           Audio channel count (default 8)\n"
+        "  --sps-patch <percent>      Key frames with the SPS to patch (default 100)\n"
+        "  --corrupt <percent>        Corrupted AAC frames (default 0)\n"
+        "  --seed <value>             Random seed (default 1)\n"
+        "Micro-benchmarks:\n"
+        "  --templates <dir>          Directory of the templates\n"
+        "  --chapters <count>         Count of chapters (default 100)\n"
+        "  --min-time <s>             Minimal time per benchmark (default 1)\n"
+        "Check:\n"
+        "  --samples <dir>            Directory of the AAC samples (Source/Benchmark/Samples)\n"
+        "Process:\n"
+        "  --threads <count>, --mkvmerge, --streaming, --temp <dir>\n"
+        "                             Same as LeaveSD options\n"
+        "  --stub-cpu <tool>=<ms>     CPU time of the stub tool per MiB read\n"
+        "  --stub-rate <tool>=<MiB/s> I/O rate limit of the stub tool\n"
+        "Results:\n"
+        "  --output <file>            Results are appended as JSON lines (default stdout)\n"
+        "  --label <text>             Label added to results, e.g. a revision\n";
+    return 1;
+}
+
+//---------------------------------------------------------------------------
+int main(int argc, const char* argv[])
+{
+    setlocale(LC_ALL, "");
+
+    options Options;
+    vector<Ztring> Args;
+    for (int i = 1; i < argc; i++)
+    {
+        auto Value = [&]()
+        {
+            if (i + 1 >= argc)
+            {
+                cerr << "Error: missing value after " << argv[i] << ".\n";
+                exit(1);
+            }
+            return argv[++i];
+        };
+        auto Stub = [&](const char* Kind)
+        {
+            string Item = Value();
+            auto Equal = Item.find('=');
+            if (Equal == string::npos)
+            {
+                cerr << "Error: " << Item << " is not <tool>=<value>.\n";
+                exit(1);
+            }
+            auto Tool = Item.substr(0, Equal);
+            for (auto& Char : Tool)
+                Char = (char)toupper((unsigned char)Char);
+            Options.Stubs.emplace_back("LEAVESD_STUB_" + Tool + '_' + Kind, Item.substr(Equal + 1));
+        };
+
+             if (!strcmp(argv[i], "--channels"))
+            Options.Nsv.ChannelCount = atoi(Value()) == 1 ? 1 : 8;
+        else if (!strcmp(argv[i], "--chapters"))
+            Options.Chapters = atoi(Value());
+        else if (!strcmp(argv[i], "--corrupt"))
+            Options.Nsv.AdtsCorruption_Ratio = atof(Value()) / 100;
+        else if (!strcmp(argv[i], "--duration"))
+            Options.Nsv.Duration = (int64u)(atof(Value()) * 1000);
+        else if (!strcmp(argv[i], "--files"))
+            Options.Files = atoi(Value());
+        else if (!strcmp(argv[i], "--label"))
+            Options.Label = Value();
+        else if (!strcmp(argv[i], "--min-time"))
+            Options.MinTime = atof(Value());
+        else if (!strcmp(argv[i], "--mkvmerge"))
+            Options.Mkvmerge = true;
+        else if (!strcmp(argv[i], "--output"))
+            Options.Output.From_Local(Value());
+        else if (!strcmp(argv[i], "--samples"))
+            Options.SamplesPath.From_Local(Value());
+        else if (!strcmp(argv[i], "--seed"))
+            Options.Nsv.Seed = atoi(Value());
+        else if (!strcmp(argv[i], "--sps-patch"))
+            Options.Nsv.SpsPatch_Ratio = atof(Value()) / 100;
+        else if (!strcmp(argv[i], "--streaming"))
+            Options.Streaming = true;
+        else if (!strcmp(argv[i], "--stub-cpu"))
+            Stub("CPU");
+        else if (!strcmp(argv[i], "--stub-rate"))
+            Stub("RATE");
+        else if (!strcmp(argv[i], "--temp"))
+        {
+            Options.TempPath.From_Local(Value());
+            if (!Options.TempPath.empty() && Options.TempPath.back() != __T('/') && Options.TempPath.back() != __T('\\'))
+                Options.TempPath += __T('/');
+        }
+        else if (!strcmp(argv[i], "--templates"))
+            Options.TemplatesPath.From_Local(Value());
+        else if (!strcmp(argv[i], "--threads"))
+            Options.ThreadCount = atoi(Value());
+        else if (argv[i][0] == '-' && argv[i][1] == '-')
+        {
+            cerr << "Error: unknown option " << argv[i] << ".\n";
+            return 1;
+        }
+        else
+            Args.push_back(Ztring().From_Local(argv[i]));
+    }
+
+    if (Args.size() == 2 && Args[0] == __T("generate"))
+        return Generate(Options, Args[1]);
+    if (Args.size() == 1 && Args[0] == __T("micro"))
+        return Micro(Options);
+    if (Args.size() == 1 && Args[0] == __T("check"))
+        return Check(Options);
+    if (Args.size() == 3 && Args[0] == __T("process"))
+        return Process(Options, Args[1], Args[2]);
+    return Help(argc ? argv[0] : "LeaveSD_Benchmark");
+}
@@ -0,0 +1,204 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#include "Benchmark/Nsv_Generator.h"
+#include "Common/Adts_Validator.h"
+#include "Common/Pattern_Scanner.h"
+#include "ZenLib/File.h"
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Helpers
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+// Same sequence for the same seed, so runs are comparable
+class random_generator
+{
+public:
+    random_generator(int32u Seed) : State(Seed ? Seed : 1) {}
+
+    int32u Next()
+    {
+        State ^= State << 13;
+        State ^= State >> 17;
+        State ^= State << 5;
+        return State;
+    }
+    bool Next(float64 Ratio)
+    {
+        return Next() < Ratio * 4294967296.0;
+    }
+
+private:
+    int32u State;
+};
+
+//---------------------------------------------------------------------------
+// No zero byte, so there is no start code emulation
+static void Filler_Append(vector<int8u>& Buffer, size_t Size, random_generator& Random)
+{
+    for (size_t i = 0; i < Size; i++)
+        Buffer.push_back((int8u)(Random.Next() % 255 + 1));
+}
+
+//---------------------------------------------------------------------------
+static void Put_L2(vector<int8u>& Buffer, int16u Value)
+{
+    Buffer.push_back((int8u)Value);
+    Buffer.push_back((int8u)(Value >> 8));
+}
+
+//---------------------------------------------------------------------------
+static void Put_L4(vector<int8u>& Buffer, int32u Value)
+{
+    Put_L2(Buffer, (int16u)Value);
+    Put_L2(Buffer, (int16u)(Value >> 16));
+}
+
+//***************************************************************************
+// Generator
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+vector<nsv_frame> Nsv_Frames(const nsv_config& Config, nsv_stats* Stats)
+{
+    static const int8u Pps[] = { 0x68, 0xEE, 0x3C, 0x80, 0x00, 0x00, 0x00, 0x01, 0x65 };
+    static const int8u Slice[] = { 0x00, 0x00, 0x00, 0x01, 0x41 };
+    static const size_t Aac_SamplesPerFrame = 1024;
+    static const size_t Aac_SamplingRate = 44100;
+
+    nsv_stats Stats_Temp;
+    if (!Stats)
+        Stats = &Stats_Temp;
+    *Stats = nsv_stats();
+    random_generator Random(Config.Seed);
+    const auto& Patch = SpsPatches[0];
+    auto FrameRate = Config.FrameRate ? Config.FrameRate : 30;
+    auto KeyFrame_Interval = Config.KeyFrame_Interval ? Config.KeyFrame_Interval : 1;
+    auto Silence_Data = Config.ChannelCount == 1 ? AdtsSilence_1_Data : AdtsSilence_8_Data;
+    auto Silence_Size = Config.ChannelCount == 1 ? AdtsSilence_1_Size : AdtsSilence_8_Size;
+
+    vector<nsv_frame> Frames;
+    size_t Frame_Count = (size_t)(Config.Duration * FrameRate / 1000);
+    Frames.reserve(Frame_Count);
+    size_t Aac_Pos = 0;
+    for (size_t i = 0; i < Frame_Count; i++)
+    {
+        Frames.emplace_back();
+        auto& Frame = Frames.back();
+        Frame.PTS = (int64u)i * 1000000000 / FrameRate;
+
+        // Video
+        Frame.IsKeyFrame = !(i % KeyFrame_Interval);
+        if (Frame.IsKeyFrame)
+        {
+            Frame.Video.assign(Patch.Data, Patch.Data + Patch.Size);
+            if (Random.Next(Config.SpsPatch_Ratio))
+                Stats->SpsPatches++;
+            else
+                Frame.Video[Patch.Offset] = Patch.ReplacedBy;
+            Frame.Video.insert(Frame.Video.end(), Pps, Pps + sizeof(Pps));
+            Filler_Append(Frame.Video, Config.Video_FrameSize * 4, Random);
+        }
+        else
+        {
+            Frame.Video.assign(Slice, Slice + sizeof(Slice));
+            Filler_Append(Frame.Video, Config.Video_FrameSize, Random);
+        }
+
+        // Audio, until the next video frame
+        for (; Aac_Pos * Aac_SamplesPerFrame * FrameRate < (i + 1) * Aac_SamplingRate; Aac_Pos++)
+        {
+            auto Begin = Frame.Audio.size();
+            Frame.Audio.insert(Frame.Audio.end(), Silence_Data, Silence_Data + Silence_Size);
+            Stats->Aac_Frames++;
+            if (Random.Next(Config.AdtsCorruption_Ratio))
+            {
+                if (Stats->Aac_Corrupted % 2)
+                {
+                    for (auto j = Begin + 7; j < Frame.Audio.size(); j += 3)
+                        Frame.Audio[j] ^= (int8u)Random.Next();
+                }
+                else
+                    Frame.Audio[Begin + 1] = 0x01; // Not a sync anymore
+                Stats->Aac_Corrupted++;
+            }
+        }
+    }
+
+    return Frames;
+}
+
+//---------------------------------------------------------------------------
+bool Nsv_Write(const Ztring& FileName, const nsv_config& Config, nsv_stats* Stats)
+{
+    static const size_t FileHeader_Size = 28;
+
+    auto Frames = Nsv_Frames(Config, Stats);
+
+    File F;
+    if (!F.Create(FileName))
+        return false;
+
+    vector<int8u> Buffer;
+    Buffer.reserve(1024 * 1024);
+    int64u File_Size = FileHeader_Size;
+    for (const auto& Frame : Frames)
+    {
+        if (Frame.IsKeyFrame)
+            File_Size += 19;
+        else
+            File_Size += 2;
+        File_Size += 5 + Frame.Video.size() + Frame.Audio.size();
+    }
+
+    // File header, no metadata and no TOC
+    Buffer.insert(Buffer.end(), { 'N', 'S', 'V', 'f' });
+    Put_L4(Buffer, (int32u)FileHeader_Size);
+    Put_L4(Buffer, (int32u)File_Size);
+    Put_L4(Buffer, (int32u)Config.Duration);
+    Put_L4(Buffer, 0); // metadata_len
+    Put_L4(Buffer, 0); // toc_alloc
+    Put_L4(Buffer, 0); // toc_size
+
+    bool WriteError = false;
+    for (const auto& Frame : Frames)
+    {
+        if (Frame.IsKeyFrame)
+        {
+            Buffer.insert(Buffer.end(), { 'N', 'S', 'V', 's', 'H', '2', '6', '4', 'A', 'A', 'C', ' ' });
+            Put_L2(Buffer, Config.Width);
+            Put_L2(Buffer, Config.Height);
+            Buffer.push_back(Config.FrameRate & 0x7F); // Integer frame rate
+            Put_L2(Buffer, 0); // syncoffs
+        }
+        else
+            Put_L2(Buffer, 0xBEEF);
+
+        // num_aux (4 bits), vid_len (20 bits), aud_len (16 bits)
+        auto Video_Size = (int32u)Frame.Video.size();
+        Buffer.push_back((int8u)(Video_Size << 4));
+        Buffer.push_back((int8u)(Video_Size >> 4));
+        Buffer.push_back((int8u)(Video_Size >> 12));
+        Put_L2(Buffer, (int16u)Frame.Audio.size());
+        Buffer.insert(Buffer.end(), Frame.Video.begin(), Frame.Video.end());
+        Buffer.insert(Buffer.end(), Frame.Audio.begin(), Frame.Audio.end());
+
+        if (Buffer.size() >= 1024 * 1024)
+        {
+            if (F.Write(Buffer.data(), Buffer.size()) != Buffer.size())
+                WriteError = true;
+            Buffer.clear();
+        }
+    }
+    if (!Buffer.empty() && F.Write(Buffer.data(), Buffer.size()) != Buffer.size())
+        WriteError = true;
+    F.Close();
+
+    return !WriteError;
+}
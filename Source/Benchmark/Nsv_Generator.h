@@ -0,0 +1,57 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#pragma once
+#include "ZenLib/Ztring.h"
+#include <vector>
+using namespace ZenLib;
+using namespace std;
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Config
+//***************************************************************************
+
+struct nsv_config
+{
+    int64u          Duration = 60000;           // In ms
+    int8u           ChannelCount = 8;           // 1 or 8
+    float64         SpsPatch_Ratio = 1;         // Part of key frames with the SPS to patch
+    float64         AdtsCorruption_Ratio = 0;   // Part of AAC frames corrupted, half with a broken sync, half with a broken payload
+    int8u           FrameRate = 30;
+    size_t          KeyFrame_Interval = 30;     // In frames
+    size_t          Video_FrameSize = 2000;     // In bytes, key frames are 4 times bigger
+    int16u          Width = 320;
+    int16u          Height = 240;
+    int32u          Seed = 1;
+};
+
+//***************************************************************************
+// Generator
+//***************************************************************************
+
+// One NSV frame: a video packet and all AAC frames until the next video frame
+struct nsv_frame
+{
+    bool            IsKeyFrame = false;
+    int64u          PTS = 0;                    // In ns
+    vector<int8u>   Video;                      // Annex B H.264, dummy slices
+    vector<int8u>   Audio;                      // ADTS, silent frames
+};
+
+struct nsv_stats
+{
+    size_t          SpsPatches = 0;
+    size_t          Aac_Frames = 0;
+    size_t          Aac_Corrupted = 0;
+};
+
+// Frames as demuxed from a NSV file
+vector<nsv_frame>   Nsv_Frames(const nsv_config& Config, nsv_stats* Stats = nullptr);
+
+// NSV file with NSVf header, sync frames on key frames
+bool                Nsv_Write(const Ztring& FileName, const nsv_config& Config, nsv_stats* Stats = nullptr);
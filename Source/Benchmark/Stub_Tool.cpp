@@ -0,0 +1,562 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+// Stand-in for faad, ffmpeg and mkvmerge, the behavior depends on the executable name
+// Outputs have the size and the frame counts LeaveSD expects, content is silent audio and copied streams
+// Cost is configurable per tool with environment variables:
+// LEAVESD_STUB_<TOOL>_CPU: CPU time in ms per MiB read (busy loop)
+// LEAVESD_STUB_<TOOL>_RATE: I/O rate limit in MiB/s (read and written bytes), 0 is no limit
+
+//---------------------------------------------------------------------------
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+    #include <fcntl.h>
+    #include <io.h>
+#endif
+using namespace std;
+//---------------------------------------------------------------------------
+
+typedef unsigned char int8u;
+typedef unsigned long long int64u;
+
+//***************************************************************************
+// Cost
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+class cost
+{
+public:
+    void Init(const string& Tool)
+    {
+        string Prefix = "LEAVESD_STUB_" + Tool;
+        transform(Prefix.begin(), Prefix.end(), Prefix.begin(), ::toupper);
+        if (auto Value = getenv((Prefix + "_CPU").c_str()))
+            Cpu = atof(Value);
+        if (auto Value = getenv((Prefix + "_RATE").c_str()))
+            Rate = atof(Value);
+        Start = chrono::steady_clock::now();
+    }
+
+    void Read(size_t Size)
+    {
+        Bytes += Size;
+        Throttle();
+        if (Cpu <= 0)
+            return;
+
+        // Busy loop, not a sleep, so a core is actually used
+        auto End = chrono::steady_clock::now() + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double, milli>(Cpu * Size / (1024 * 1024)));
+        volatile int64u Dummy = 0;
+        while (chrono::steady_clock::now() < End)
+            for (int i = 0; i < 1000; i++)
+                Dummy = Dummy + i;
+    }
+
+    void Written(size_t Size)
+    {
+        Bytes += Size;
+        Throttle();
+    }
+
+private:
+    double Cpu = 0;
+    double Rate = 0;
+    int64u Bytes = 0;
+    chrono::steady_clock::time_point Start;
+
+    void Throttle()
+    {
+        if (Rate <= 0)
+            return;
+        auto Due = Start + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(Bytes / (Rate * 1024 * 1024)));
+        if (Due > chrono::steady_clock::now())
+            this_thread::sleep_until(Due);
+    }
+};
+static cost Cost;
+
+//***************************************************************************
+// Helpers
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+static FILE* File_Open(const string& FileName, const char* Mode)
+{
+    if (FileName == "-")
+    {
+        auto F = *Mode == 'r' ? stdin : stdout;
+        #ifdef _WIN32
+            _setmode(_fileno(F), _O_BINARY);
+        #endif
+        return F;
+    }
+    return fopen(FileName.c_str(), Mode);
+}
+
+//---------------------------------------------------------------------------
+static void File_Close(FILE* F)
+{
+    if (F != stdin && F != stdout)
+        fclose(F);
+    else
+        fflush(F);
+}
+
+//---------------------------------------------------------------------------
+static bool File_Read(const string& FileName, vector<int8u>& Content)
+{
+    auto F = File_Open(FileName, "rb");
+    if (!F)
+        return false;
+    Content.clear();
+    int8u Buffer[65536];
+    while (auto Size = fread(Buffer, 1, sizeof(Buffer), F))
+    {
+        Content.insert(Content.end(), Buffer, Buffer + Size);
+        Cost.Read(Size);
+    }
+    File_Close(F);
+    return true;
+}
+
+//---------------------------------------------------------------------------
+static bool File_Write(FILE* F, const void* Data, size_t Size)
+{
+    auto Written = fwrite(Data, 1, Size, F);
+    Cost.Written(Written);
+    return Written == Size;
+}
+
+//---------------------------------------------------------------------------
+static string Extension(const string& FileName)
+{
+    auto Pos = FileName.rfind('.');
+    if (Pos == string::npos || FileName.find_first_of("/\\", Pos) != string::npos)
+        return string();
+    return FileName.substr(Pos);
+}
+
+//***************************************************************************
+// ADTS
+//***************************************************************************
+
+static const int Adts_SamplingRates[16] = { 96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000, 7350, 0, 0, 0 };
+
+//---------------------------------------------------------------------------
+// Frame count, first channel configuration and duration in ms, each lost sync calls Error
+template<typename F> static size_t Adts_Parse(const vector<int8u>& Content, int& ChannelConfiguration, int64u& Duration, F Error)
+{
+    size_t Count = 0;
+    int64u Samples = 0;
+    int SamplingRate = 0;
+    ChannelConfiguration = -1;
+    for (size_t Pos = 0; Pos + 7 <= Content.size();)
+    {
+        const auto* B = Content.data() + Pos;
+        size_t Size = ((B[3] & 0x03) << 11) | (B[4] << 3) | (B[5] >> 5);
+        if (B[0] != 0xFF || (B[1] & 0xF6) != 0xF0 || Size < 7)
+        {
+            Error();
+            Pos++;
+            while (Pos + 1 < Content.size() && (Content[Pos] != 0xFF || (Content[Pos + 1] & 0xF6) != 0xF0))
+                Pos++;
+            continue;
+        }
+        if (ChannelConfiguration == -1)
+        {
+            ChannelConfiguration = ((B[2] & 0x01) << 2) | (B[3] >> 6);
+            SamplingRate = Adts_SamplingRates[(B[2] >> 2) & 0x0F];
+        }
+        Count++;
+        Samples += 1024;
+        Pos += Size;
+    }
+    Duration = SamplingRate ? Samples * 1000 / SamplingRate : 0;
+    return Count;
+}
+
+//***************************************************************************
+// faad
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+// faad -f 2 [-w] input.aac, raw PCM in input.aif or stdout, mono is decoded as stereo
+static int Faad(const vector<string>& Args)
+{
+    bool ToStdout = false;
+    string Input;
+    for (size_t i = 1; i < Args.size(); i++)
+    {
+        if (Args[i] == "-w")
+            ToStdout = true;
+        else if (Args[i] == "-f")
+            i++;
+        else
+            Input = Args[i];
+    }
+
+    vector<int8u> Content;
+    if (Input.empty() || !File_Read(Input, Content))
+    {
+        fprintf(stderr, "Error opening file: %s\n", Input.c_str());
+        return 1;
+    }
+    bool Errors = false;
+    int ChannelConfiguration;
+    int64u Duration;
+    auto Count = Adts_Parse(Content, ChannelConfiguration, Duration, [&]()
+    {
+        fprintf(stderr, "Error: Bitstream value not allowed by specification\n");
+        Errors = true;
+    });
+    size_t Channels = ChannelConfiguration == 1 ? 2 : 8;
+
+    auto Output = ToStdout ? string("-") : (Input.substr(0, Input.size() - Extension(Input).size()) + ".aif");
+    auto F = File_Open(Output, "wb");
+    if (!F)
+    {
+        fprintf(stderr, "Error opening file: %s\n", Output.c_str());
+        return 1;
+    }
+    vector<int8u> Silence(1024 * Channels * 2);
+    for (size_t i = 0; i < Count; i++)
+        if (!File_Write(F, Silence.data(), Silence.size()))
+        {
+            File_Close(F);
+            return 1;
+        }
+    File_Close(F);
+    return Errors ? 1 : 0;
+}
+
+//***************************************************************************
+// ffmpeg
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+// ffmpeg -y -f s16le -ar 44.1k -ac N -i input [-map_channel x -b:a x -c:a x -profile:a x] output.aac..., an ADTS mono track per output
+static int Ffmpeg(const vector<string>& Args)
+{
+    static const char* Options_WithValue[] = { "-f", "-ar", "-ac", "-i", "-map_channel", "-b:a", "-c:a", "-profile:a" };
+    string Input;
+    size_t Channels = 2;
+    bool Sbr = false;
+    vector<string> Outputs;
+    for (size_t i = 1; i < Args.size(); i++)
+    {
+        const auto& Arg = Args[i];
+        if (Arg.size() > 1 && Arg[0] == '-')
+        {
+            if (find_if(begin(Options_WithValue), end(Options_WithValue), [&](const char* Option) { return Arg == Option; }) == end(Options_WithValue) || i + 1 >= Args.size())
+                continue;
+            const auto& Value = Args[++i];
+            if (Arg == "-i")
+                Input = Value;
+            else if (Arg == "-ac")
+                Channels = max(atoi(Value.c_str()), 1);
+            else if (Arg == "-profile:a")
+                Sbr = Value == "aac_he";
+        }
+        else
+            Outputs.push_back(Arg);
+    }
+
+    vector<int8u> Content;
+    if (Input.empty() || !File_Read(Input, Content))
+    {
+        fprintf(stderr, "%s: No such file or directory\nConversion failed!\n", Input.c_str());
+        return 1;
+    }
+
+    // 48 kb/s, HE-AAC has half the frames at half the sampling rate
+    size_t Samples = Content.size() / (2 * Channels);
+    size_t SamplesPerFrame = Sbr ? 2048 : 1024;
+    size_t Count = (Samples + SamplesPerFrame - 1) / SamplesPerFrame;
+    size_t Frame_Size = 48000 / 8 * SamplesPerFrame / 44100;
+    vector<int8u> Frame(Frame_Size);
+    Frame[0] = 0xFF;
+    Frame[1] = 0xF1;
+    Frame[2] = (1 << 6) | ((Sbr ? 7 : 4) << 2); // AAC LC, 22050 or 44100 Hz
+    Frame[3] = (1 << 6) | (int8u)(Frame_Size >> 11); // 1 channel
+    Frame[4] = (int8u)(Frame_Size >> 3);
+    Frame[5] = (int8u)(Frame_Size << 5) | 0x1F;
+    Frame[6] = 0xFC;
+    for (const auto& Output : Outputs)
+    {
+        auto F = File_Open(Output, "wb");
+        if (!F)
+        {
+            fprintf(stderr, "%s: Permission denied\nConversion failed!\n", Output.c_str());
+            return 1;
+        }
+        for (size_t i = 0; i < Count; i++)
+            if (!File_Write(F, Frame.data(), Frame.size()))
+            {
+                File_Close(F);
+                fprintf(stderr, "Conversion failed!\n");
+                return 1;
+            }
+        File_Close(F);
+    }
+    return 0;
+}
+
+//***************************************************************************
+// mkvmerge
+//***************************************************************************
+
+static const char Mkv_Magic[] = "LeaveSD stub output\n";
+
+//---------------------------------------------------------------------------
+// JSON array of strings, as in mkvmerge option files
+static bool Json_Array(const vector<int8u>& Content, vector<string>& Items)
+{
+    size_t Pos = 0;
+    auto Skip = [&]()
+    {
+        while (Pos < Content.size() && (Content[Pos] == ' ' || Content[Pos] == '\t' || Content[Pos] == '\r' || Content[Pos] == '\n' || Content[Pos] == ','))
+            Pos++;
+    };
+    Skip();
+    if (Pos >= Content.size() || Content[Pos++] != '[')
+        return false;
+    for (;;)
+    {
+        Skip();
+        if (Pos >= Content.size())
+            return false;
+        if (Content[Pos] == ']')
+            return true;
+        if (Content[Pos++] != '"')
+            return false;
+        string Item;
+        while (Pos < Content.size() && Content[Pos] != '"')
+        {
+            auto Value = Content[Pos++];
+            if (Value == '\\' && Pos < Content.size())
+            {
+                Value = Content[Pos++];
+                if (Value == 'u' && Pos + 4 <= Content.size())
+                {
+                    auto Code = strtoul(string(Content.begin() + Pos, Content.begin() + Pos + 4).c_str(), nullptr, 16);
+                    Pos += 4;
+                    if (Code < 0x80)
+                        Item += (char)Code;
+                    else if (Code < 0x800)
+                    {
+                        Item += (char)(0xC0 | (Code >> 6));
+                        Item += (char)(0x80 | (Code & 0x3F));
+                    }
+                    else
+                    {
+                        Item += (char)(0xE0 | (Code >> 12));
+                        Item += (char)(0x80 | ((Code >> 6) & 0x3F));
+                        Item += (char)(0x80 | (Code & 0x3F));
+                    }
+                    continue;
+                }
+                switch (Value)
+                {
+                    case 'n': Value = '\n'; break;
+                    case 'r': Value = '\r'; break;
+                    case 't': Value = '\t'; break;
+                    default:;
+                }
+            }
+            Item += (char)Value;
+        }
+        Pos++;
+        Items.push_back(Item);
+    }
+}
+
+//---------------------------------------------------------------------------
+// Access units in Annex B H.264, one slice per frame
+static size_t Avc_FrameCount(const vector<int8u>& Content)
+{
+    size_t Count = 0;
+    for (size_t Pos = 0; Pos + 3 < Content.size(); Pos++)
+        if (!Content[Pos] && !Content[Pos + 1] && Content[Pos + 2] == 1)
+        {
+            auto Type = Content[Pos + 3] & 0x1F;
+            if (Type == 1 || Type == 5)
+                Count++;
+            Pos += 2;
+        }
+    return Count;
+}
+
+//---------------------------------------------------------------------------
+// mkvmerge @options.json: output is a header with the counts, then the streams as is
+static int Mkvmerge_Mux(const string& OptionFile)
+{
+    vector<int8u> Content;
+    vector<string> Args;
+    if (!File_Read(OptionFile, Content) || !Json_Array(Content, Args))
+    {
+        printf("Error: The option file '%s' could not be read.\n", OptionFile.c_str());
+        return 2;
+    }
+
+    string Output;
+    vector<string> Inputs;
+    for (size_t i = 0; i < Args.size(); i++)
+    {
+        if (Args[i] == "-o" && i + 1 < Args.size())
+            Output = Args[++i];
+        else
+        {
+            auto Ext = Extension(Args[i]);
+            if (Ext == ".avc" || Ext == ".aac")
+                Inputs.push_back(Args[i]);
+        }
+    }
+    if (Output.empty())
+    {
+        printf("Error: No output file name was given.\n");
+        return 2;
+    }
+
+    // Counts of the video track and the first audio track
+    int64u Duration = 0;
+    size_t Counts[2] = {};
+    bool IsPresent[2] = {};
+    vector<vector<int8u>> Contents(Inputs.size());
+    for (size_t i = 0; i < Inputs.size(); i++)
+    {
+        if (!File_Read(Inputs[i], Contents[i]))
+        {
+            printf("Error: The file '%s' could not be opened for reading.\n", Inputs[i].c_str());
+            return 2;
+        }
+        if (Extension(Inputs[i]) == ".avc")
+        {
+            if (!IsPresent[0])
+                Counts[0] = Avc_FrameCount(Contents[i]);
+            IsPresent[0] = true;
+        }
+        else if (!IsPresent[1])
+        {
+            int ChannelConfiguration;
+            Counts[1] = Adts_Parse(Contents[i], ChannelConfiguration, Duration, []() {});
+            IsPresent[1] = true;
+        }
+    }
+
+    auto F = File_Open(Output, "wb");
+    if (!F)
+    {
+        printf("Error: The file '%s' could not be opened for writing.\n", Output.c_str());
+        return 2;
+    }
+    string Header = Mkv_Magic;
+    Header += to_string(Duration) + ' ' + (IsPresent[0] ? to_string(Counts[0]) : string("-")) + ' ' + (IsPresent[1] ? to_string(Counts[1]) : string("-")) + '\n';
+    bool WriteError = !File_Write(F, Header.data(), Header.size());
+    for (const auto& Item : Contents)
+        if (!Item.empty() && !File_Write(F, Item.data(), Item.size()))
+            WriteError = true;
+    File_Close(F);
+    if (WriteError)
+    {
+        printf("Error: Could not write to the output file.\n");
+        return 2;
+    }
+    printf("Multiplexing took 0 seconds.\n");
+    return 0;
+}
+
+//---------------------------------------------------------------------------
+// mkvmerge -J file.mkv: identification JSON with the counts of the header
+static int Mkvmerge_Identify(const string& FileName)
+{
+    auto F = File_Open(FileName, "rb");
+    char Line[2][256] = {};
+    if (!F || !fgets(Line[0], sizeof(Line[0]), F) || strcmp(Line[0], Mkv_Magic) || !fgets(Line[1], sizeof(Line[1]), F))
+    {
+        if (F)
+            File_Close(F);
+        printf("{\"errors\":[\"The file '%s' is not a stub output file.\"]}\n", FileName.c_str());
+        return 2;
+    }
+    File_Close(F);
+
+    char Counts[2][32];
+    unsigned long long Duration;
+    if (sscanf(Line[1], "%llu %31s %31s", &Duration, Counts[0], Counts[1]) != 3)
+        return 2;
+
+    static const char* Types[2] = { "video", "audio" };
+    static const char* Codecs[2] = { "AVC/H.264/MPEG-4p10", "AAC" };
+    string Json = "{\"container\":{\"properties\":{\"duration\":" + to_string(Duration * 1000000) + "},\"recognized\":true,\"supported\":true,\"type\":\"Matroska\"},\"tracks\":[";
+    size_t Id = 0;
+    for (size_t i = 0; i < 2; i++)
+    {
+        if (!strcmp(Counts[i], "-"))
+            continue;
+        if (Id)
+            Json += ',';
+        Json += "{\"codec\":\"" + string(Codecs[i]) + "\",\"id\":" + to_string(Id++) + ",\"properties\":{\"tag_number_of_frames\":\"" + Counts[i] + "\"},\"type\":\"" + Types[i] + "\"}";
+    }
+    Json += "]}\n";
+    fputs(Json.c_str(), stdout);
+    return 0;
+}
+
+//---------------------------------------------------------------------------
+static int Mkvmerge(const vector<string>& Args)
+{
+    if (Args.size() == 3 && Args[1] == "-J")
+        return Mkvmerge_Identify(Args[2]);
+    if (Args.size() == 2 && !Args[1].empty() && Args[1][0] == '@')
+        return Mkvmerge_Mux(Args[1].substr(1));
+    printf("Error: Only '@options.json' and '-J file' are supported by this stub.\n");
+    return 2;
+}
+
+//***************************************************************************
+// Main
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+    vector<string> Args(argv, argv + argc);
+    if (Args.empty())
+        return 1;
+
+    // Tool name from the executable name
+    auto Name = Args[0];
+    auto Slash = Name.find_last_of("/\\");
+    if (Slash != string::npos)
+        Name.erase(0, Slash + 1);
+    transform(Name.begin(), Name.end(), Name.begin(), ::tolower);
+    if (Extension(Name) == ".exe")
+        Name.resize(Name.size() - 4);
+
+    static const pair<const char*, int (*)(const vector<string>&)> Tools[] =
+    {
+        { "faad", Faad },
+        { "ffmpeg", Ffmpeg },
+        { "mkvmerge", Mkvmerge },
+    };
+    for (const auto& Tool : Tools)
+        if (Name == Tool.first)
+        {
+            Cost.Init(Tool.first);
+            return Tool.second(Args);
+        }
+
+    fprintf(stderr, "Rename or copy this executable to faad, ffmpeg or mkvmerge.\n");
+    return 1;
+}
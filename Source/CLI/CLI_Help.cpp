@@ -47,8 +47,8 @@ return_value Help(ostream& Out, const char* Name, bool Full)
         "    --temp-path value\n"
         "        Set temporary path to the indicated value.\n"
         "        By defaut it is the system temp path.\n"
-        "        It is advised to use a temporary path on the same disk as the output path\n"
-        "        in order to avoid the cost of a file copy.\n"
+        "        Output files are renamed if the temporary path is on the same disk as the\n"
+        "        output path, else they are cloned or copied by the system.\n"
         "\n"
         "    --keep-temp\n"
         "        Do not delete temporary files (useful for investiguation).\n"
@@ -61,6 +61,96 @@ return_value Help(ostream& Out, const char* Name, bool Full)
         "        Use the old AAC format without extensions.\n"
         "        By default HE-AAC (AAC with SBR extension) is used.\n"
         "\n"
+        "    --streaming\n"
+        "        Pipe the audio decoder output directly to the audio encoder.\n"
+        "        Decoded audio is not written to the temporary path.\n"
+        "\n"
+        "    --mkvmerge\n"
+        "        Use mkvmerge for muxing.\n"
+        "        By default the Matroska file is written by LeaveSD.\n"
+        "\n"
+        "    --verify-full\n"
+        "        Parse again the whole output file for checking it.\n"
+        "        By default counts reported by the muxer are used.\n"
+        "\n"
+        "    --verify-sample <N>\n"
+        "        Parse again the whole output file for 1 file every N files.\n"
+        "\n"
+        "    --damage-report\n"
+        "        Write the ranges of invalid AAC packets, with their times, in a\n"
+        "        <output name>_damage.txt file next to each output file having some.\n"
+        "\n"
+        "    --aac-check-mediainfo\n"
+        "        Check AAC frames with MediaInfo, slower.\n"
+        "        By default the syntax of AAC frames is checked by LeaveSD.\n"
+        "\n"
+        "    --history <file>\n"
+        "        File with the measured speed of each step, used for ordering files.\n"
+        "        Default is LeaveSD_History.txt in the temporary path.\n"
+        "\n"
+        "    --priority <file>\n"
+        "        File with one file name per line, these files are converted first.\n"
+        "        Other files are converted from the longest to the shortest one.\n"
+        "\n"
+        "    --stage-threads <demux>,<audio>,<mux>,<publish>,<verify>\n"
+        "        Set count of parallel processings for each step, empty means default.\n"
+        "        Files go from a step to the next one, so steps of different files overlap.\n"
+        "        Default is 2 for demux and mux, 1 for publish and verify,\n"
+        "        --threads value for audio.\n"
+        "\n"
+        "    --index <file>\n"
+        "        File with the probe results of previous runs (also --scan runs).\n"
+        "        Files with the same path, size and modification date are not probed again.\n"
+        "        Default is LeaveSD_Index.txt in the output directory.\n"
+        "\n"
+        "    --mmap\n"
+        "        Map input files in memory and give them to the parser in large chunks.\n"
+        "        By default the parser reads the input files by itself.\n"
+        "\n"
+        "    --write-buffer <KiB>\n"
+        "        Size of the buffer of each demuxed stream, default is 8192.\n"
+        "        Larger values are better for network temporary paths.\n"
+        "\n"
+        "    --write-background\n"
+        "        Write demuxed streams from another thread while demux continues.\n"
+        "\n"
+        "    --temp-memory <MiB>\n"
+        "        Memory budget for temporary files, shared by all parallel processings.\n"
+        "        Temporary files of a file go to the memory backed path if their estimated\n"
+        "        size fits in what remains of the budget, else to the temporary path.\n"
+        "\n"
+        "    --temp-memory-path <dir>\n"
+        "        Memory backed directory (tmpfs, RAM disk) used with --temp-memory.\n"
+        "        Default is /dev/shm on Linux, there is no default on Windows.\n"
+        "\n"
+        "    --trace <file>\n"
+        "        Write the duration of each processing step of each file, per thread,\n"
+        "        in Chrome trace event format (chrome://tracing, ui.perfetto.dev).\n"
+        "\n"
+        "    --metrics <file>\n"
+        "        Write counters (files, demuxed bytes and packets, AAC issues, busy threads,\n"
+        "        temporary files...) in Prometheus text format, replaced atomically.\n"
+        "        Use a .prom file in the node_exporter textfile collector directory.\n"
+        "\n"
+        "    --metrics-interval <seconds>\n"
+        "        Interval between two writes of the metrics file. Default is 15.\n"
+        "\n"
+        "    --shard <i>/<N>\n"
+        "        Process only the part i (1 to N) of the input files, e.g. one part per node.\n"
+        "        Parts depend only on the file paths relative to the input directory, so\n"
+        "        nodes with different mount points of the same archive get the same parts.\n"
+        "        The journal, the index and the temporary files are per part.\n"
+        "\n"
+        "    --coordinator <socket>\n"
+        "        Do not process the files, give them to processes started with --worker on\n"
+        "        the same Unix domain socket, then display the results of all the workers.\n"
+        "        Files of a worker stopped during their processing go to another worker.\n"
+        "\n"
+        "    --worker <socket>\n"
+        "        Process the files given by the process started with --coordinator.\n"
+        "        Input and output must be the same as the ones of the coordinator.\n"
+        "        The journal, the index and the temporary files are per worker number.\n"
+        "\n"
         << endl;
 
     return ReturnValue_OK;
@@ -14,15 +14,58 @@ struct IUnknown; // Workaround for "combaseapi.h(229): error C2187: syntax error
 #else
 #include <ZenLib/Ztring.h>
 #endif
+#include <cstring>
 using namespace std;
 //---------------------------------------------------------------------------
 
+//***************************************************************************
+// Helpers
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+// Next argument is the value of the option, false if there is none
+static bool Value_Next(Core& C, int argc, const char* argv_ansi[], int& i)
+{
+    if (++i < argc)
+        return true;
+    if (C.Err)
+        *C.Err << "Error: missing value after " << argv_ansi[i - 1] << ".\n";
+    return false;
+}
+
+//---------------------------------------------------------------------------
+// Positive integer at the beginning of Value, Value is moved after it, false if there is none or if it is more than Max
+static bool Number_Read(const char*& Value, size_t Max, size_t& Result)
+{
+    auto Begin = Value;
+    Result = 0;
+    while (*Value >= '0' && *Value <= '9')
+    {
+        Result = Result * 10 + (*Value++ - '0');
+        if (Result > Max)
+            return false;
+    }
+    return Value != Begin && Result;
+}
+
+//---------------------------------------------------------------------------
+// Value of the option is a positive integer, false if it is not
+static bool Value_Positive(Core& C, const char* argv_ansi[], int i, size_t Max, size_t& Result)
+{
+    const char* Value = argv_ansi[i];
+    if (Number_Read(Value, Max, Result) && !*Value)
+        return true;
+    if (C.Err)
+        *C.Err << "Error: " << argv_ansi[i] << " is not a valid value for " << argv_ansi[i - 1] << ", use an integer from 1 to " << Max << ".\n";
+    return false;
+}
+
 //***************************************************************************
 // Command line parser
 //***************************************************************************
 
 //---------------------------------------------------------------------------
-return_value Parse(Core& C, int argc, const char* argv_ansi[], LPCWSTR argv[])
+return_value Parse(Core& C, int argc, const char* argv_ansi[], const MediaInfoNameSpace::Char* argv[])
 {
     return_value ReturnValue = ReturnValue_OK;
     bool ClearInput = false;
@@ -37,10 +80,28 @@ return_value Parse(Core& C, int argc, const char* argv_ansi[], LPCWSTR argv[])
                 return Value;
             ClearInput = true;
         }
+        else if (!strcmp(argv_ansi[i], "--coordinator"))
+        {
+            if (!Value_Next(C, argc, argv_ansi, i))
+                return ReturnValue_ERROR;
+            C.CoordinatorSocket = argv[i];
+        }
         else if (strcmp(argv_ansi[i], "--force-existing") == 0)
         {
             C.ForceExistingFiles = true;
         }
+        else if (!strcmp(argv_ansi[i], "--history"))
+        {
+            if (!Value_Next(C, argc, argv_ansi, i))
+                return ReturnValue_ERROR;
+            C.HistoryFile = argv[i];
+        }
+        else if (!strcmp(argv_ansi[i], "--index"))
+        {
+            if (!Value_Next(C, argc, argv_ansi, i))
+                return ReturnValue_ERROR;
+            C.IndexFile = argv[i];
+        }
         else if (strcmp(argv_ansi[i], "--keep-temp") == 0)
         {
             C.KeepTemp = true;
@@ -49,34 +110,152 @@ return_value Parse(Core& C, int argc, const char* argv_ansi[], LPCWSTR argv[])
         {
             C.LegacyAac = true;
         }
+        else if (!strcmp(argv_ansi[i], "--metrics"))
+        {
+            if (!Value_Next(C, argc, argv_ansi, i))
+                return ReturnValue_ERROR;
+            C.MetricsFile = argv[i];
+        }
+        else if (!strcmp(argv_ansi[i], "--metrics-interval"))
+        {
+            if (!Value_Next(C, argc, argv_ansi, i))
+                return ReturnValue_ERROR;
+            C.MetricsInterval = atoi(argv_ansi[i]);
+            if (!C.MetricsInterval)
+                C.MetricsInterval = 1;
+        }
+        else if (!strcmp(argv_ansi[i], "--mkvmerge"))
+        {
+            C.Mkvmerge = true;
+        }
+        else if (!strcmp(argv_ansi[i], "--mmap"))
+        {
+            C.MappedInput = true;
+        }
+        else if (!strcmp(argv_ansi[i], "--priority"))
+        {
+            if (!Value_Next(C, argc, argv_ansi, i))
+                return ReturnValue_ERROR;
+            C.PriorityFile = argv[i];
+        }
         else if (!strcmp(argv_ansi[i], "--scan"))
         {
             C.Scan = true;
         }
+        else if (!strcmp(argv_ansi[i], "--shard"))
+        {
+            if (!Value_Next(C, argc, argv_ansi, i))
+                return ReturnValue_ERROR;
+            char* End;
+            C.Shard = strtoul(argv_ansi[i], &End, 10);
+            C.ShardCount = *End == '/' ? strtoul(End + 1, &End, 10) : 0;
+            if (*End || !C.Shard || C.Shard > C.ShardCount)
+            {
+                if (C.Err)
+                    *C.Err << "Error: " << argv_ansi[i] << " is not a valid shard, use i/N with i from 1 to N.\n";
+                return ReturnValue_ERROR;
+            }
+        }
         else if (strcmp(argv_ansi[i], "--skip-existing") == 0)
         {
             C.SkipExistingFiles = true;
         }
-        else if (strcmp(argv_ansi[i], "--temp-path") == 0)
+        else if (!strcmp(argv_ansi[i], "--stage-threads"))
         {
-            if (++i >= argc)
+            if (!Value_Next(C, argc, argv_ansi, i))
+                return ReturnValue_ERROR;
+            const char* Value = argv_ansi[i];
+            auto IsValid = true;
+            for (size_t j = 0; j < Stage_Max && IsValid; j++)
+            {
+                C.StageThreadCounts[j] = 0; // Empty means default
+                if (*Value && *Value != ',')
+                    IsValid = Number_Read(Value, 1024, C.StageThreadCounts[j]);
+                if (!*Value)
+                    break;
+                if (*Value == ',' && j + 1 < Stage_Max)
+                    Value++;
+                else
+                    IsValid = false;
+            }
+            if (!IsValid)
             {
                 if (C.Err)
-                    *C.Err << "Error: missing value after " << argv_ansi[i - 1] << ".\n";
+                    *C.Err << "Error: " << argv_ansi[i] << " is not a valid value for " << argv_ansi[i - 1] << ", use up to " << Stage_Max << " comma separated integers from 1 to 1024.\n";
                 return ReturnValue_ERROR;
             }
+        }
+        else if (!strcmp(argv_ansi[i], "--streaming"))
+        {
+            C.Streaming = true;
+        }
+        else if (!strcmp(argv_ansi[i], "--temp-memory"))
+        {
+            if (!Value_Next(C, argc, argv_ansi, i))
+                return ReturnValue_ERROR;
+            C.TempMemory = (int64u)atoi(argv_ansi[i]) * 1024 * 1024;
+        }
+        else if (!strcmp(argv_ansi[i], "--temp-memory-path"))
+        {
+            if (!Value_Next(C, argc, argv_ansi, i))
+                return ReturnValue_ERROR;
+            C.TempMemoryPath = argv[i];
+        }
+        else if (strcmp(argv_ansi[i], "--temp-path") == 0)
+        {
+            if (!Value_Next(C, argc, argv_ansi, i))
+                return ReturnValue_ERROR;
             C.TempPath = argv[i];
         }
         else if (strcmp(argv_ansi[i], "--threads") == 0)
              {
-                 if (++i >= argc)
-                 {
-                     if (C.Err)
-                         *C.Err << "Error: missing value after " << argv_ansi[i - 1] << ".\n";
+                 if (!Value_Next(C, argc, argv_ansi, i))
                      return ReturnValue_ERROR;
-                 }
                  C.ThreadCount = atoi(argv_ansi[i]);
              }
+        else if (!strcmp(argv_ansi[i], "--trace"))
+        {
+            if (!Value_Next(C, argc, argv_ansi, i))
+                return ReturnValue_ERROR;
+            C.TraceFile = argv[i];
+        }
+        else if (!strcmp(argv_ansi[i], "--verify-full"))
+        {
+            C.VerifyFull = true;
+        }
+        else if (!strcmp(argv_ansi[i], "--damage-report"))
+        {
+            C.DamageReport = true;
+        }
+        else if (!strcmp(argv_ansi[i], "--aac-check-mediainfo"))
+        {
+            C.AacCheck_MediaInfo = true;
+        }
+        else if (!strcmp(argv_ansi[i], "--verify-sample"))
+        {
+            if (!Value_Next(C, argc, argv_ansi, i))
+                return ReturnValue_ERROR;
+            if (!Value_Positive(C, argv_ansi, i, 1000000000, C.VerifySample))
+                return ReturnValue_ERROR;
+        }
+        else if (!strcmp(argv_ansi[i], "--worker"))
+        {
+            if (!Value_Next(C, argc, argv_ansi, i))
+                return ReturnValue_ERROR;
+            C.WorkerSocket = argv[i];
+        }
+        else if (!strcmp(argv_ansi[i], "--write-background"))
+        {
+            C.WriteBackground = true;
+        }
+        else if (!strcmp(argv_ansi[i], "--write-buffer"))
+        {
+            if (!Value_Next(C, argc, argv_ansi, i))
+                return ReturnValue_ERROR;
+            if (!Value_Positive(C, argv_ansi, i, 1024 * 1024, C.WriteBufferSize)) // Up to 1 GiB
+                return ReturnValue_ERROR;
+            C.WriteBufferSize *= 1024;
+        }
         else if (!strcmp(argv_ansi[i], "--version"))
         {
             if (!C.Out)
@@ -99,12 +278,8 @@ return_value Parse(Core& C, int argc, const char* argv_ansi[], LPCWSTR argv[])
             }
             else
             {
-                if (++i >= argc)
-                {
-                    if (C.Err)
-                        *C.Err << "Error: missing value after " << argv_ansi[i - 1] << ".\n";
+                if (!Value_Next(C, argc, argv_ansi, i))
                     return ReturnValue_ERROR;
-                }
                 Value = argv[i];
                 EqualPos = 1;
             }
@@ -153,6 +328,13 @@ return_value Parse(Core& C, int argc, const char* argv_ansi[], LPCWSTR argv[])
         return ReturnValue_ERROR;
     }
 
+    if (!C.CoordinatorSocket.empty() && !C.WorkerSocket.empty())
+    {
+        if (C.Err)
+            *C.Err << "Error: --coordinator and --worker are incompatible.\n";
+        return ReturnValue_ERROR;
+    }
+
     return ReturnValue;
 }
 
@@ -162,7 +344,7 @@ return_value Parse(Core& C, int argc, const char* argv_ansi[])
     //Get command line args in main()
 #ifdef UNICODE
 #ifdef _WIN32
-    LPCWSTR* argv = (LPCWSTR*)CommandLineToArgvW(GetCommandLineW(), &argc);
+    auto argv = (const MediaInfoNameSpace::Char**)CommandLineToArgvW(GetCommandLineW(), &argc);
 #else //WIN32
     std::vector<MediaInfoNameSpace::String> argv_Temp;
     for (int i = 0; i < argc; i++)
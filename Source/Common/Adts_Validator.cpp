@@ -0,0 +1,1046 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#include "Common/Adts_Validator.h"
+#include <algorithm>
+#include <vector>
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Silent frames
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+const int8u AdtsSilence_1_Data[] = { 0xFF, 0xF1, 0x50, 0x40, 0x1B, 0x3F, 0xFC, 0x01, 0x16, 0x99, 0xFE, 0x8C, 0x16, 0xA8, 0x8D, 0x09, 0x5A, 0xE2, 0xE9, 0x72, 0x06, 0xB2, 0xF2, 0x4A, 0xB3, 0x07, 0x19, 0xAD, 0xBE, 0xDD, 0x2A, 0x7C, 0x1E, 0x82, 0x67, 0x5E, 0x4D, 0x55, 0xED, 0xE5, 0xA3, 0x71, 0x11, 0x61, 0x4E, 0x2D, 0xCC, 0x87, 0x2F, 0x22, 0x9F, 0xCB, 0xBB, 0x0B, 0x34, 0x7B, 0x3F, 0x5E, 0x9C, 0x72, 0xB7, 0xF1, 0xCE, 0x67, 0xFF, 0x4A, 0x6A, 0xEA, 0xCB, 0xD3, 0xCA, 0x8A, 0xEE, 0x93, 0x45, 0x59, 0xCB, 0x6D, 0x95, 0xD8, 0x49, 0x75, 0x3A, 0xB6, 0x04, 0xF3, 0xC7, 0x11, 0x70, 0x77, 0xBF, 0x51, 0xD4, 0xDE, 0x49, 0xFF, 0x11, 0x4E, 0xCD, 0x2D, 0x79, 0x80, 0x2D, 0x96, 0x3B, 0xA8, 0x06, 0x83, 0x94, 0x6C, 0x54, 0x08, 0x99, 0x06, 0xC2, 0x1B, 0xE4, 0xA5, 0x0D, 0x60, 0xAA, 0x3D, 0xCC, 0x45, 0x50, 0x83, 0x39, 0x14, 0xDD, 0xC3, 0x5A, 0x07, 0x56, 0x27, 0x4F, 0xB8, 0x12, 0xEC, 0x7C, 0x2F, 0x86, 0xDC, 0xA6, 0xAB, 0xD8, 0x55, 0x4B, 0x96, 0x3C, 0x30, 0xBA, 0xFC, 0x6B, 0x8B, 0xF7, 0x3E, 0x72, 0xA6, 0xD2, 0xA3, 0x39, 0xD7, 0xC3, 0xB8, 0xFE, 0x42, 0x71, 0xCE, 0x25, 0x17, 0xBB, 0xEA, 0x57, 0xE8, 0x69, 0xB1, 0x70, 0xF6, 0x9B, 0x3B, 0x3A, 0x1A, 0xBC, 0x36, 0xD1, 0xD7, 0xB6, 0x1A, 0x22, 0x7C, 0x9E, 0xE7, 0x69, 0x05, 0xEB, 0xC2, 0x41, 0xAA, 0xAE, 0x9F, 0x20, 0x0B, 0x3F, 0x0D, 0xF7, 0x12, 0x8D, 0x9E, 0x35, 0x3B, 0xC1, 0xD7, 0xED, 0x78, 0x76, 0x85, 0x9C };
+const size_t AdtsSilence_1_Size = sizeof(AdtsSilence_1_Data);
+
+//---------------------------------------------------------------------------
+const int8u AdtsSilence_8_Data[] = { 0xFF, 0xF1, 0x50, 0x00, 0x42, 0x9F, 0xFC, 0xD8, 0x00, 0x00, 0xDE, 0x5E, 0x33, 0x58, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x01, 0x33, 0xFD, 0xAA, 0x30, 0x58, 0xC1, 0x66, 0x89, 0xCB, 0x5F, 0x8B, 0x4A, 0xAA, 0xAA, 0x0C, 0xFA, 0x49, 0x8A, 0xA6, 0x68, 0x95, 0xC8, 0xDE, 0xCE, 0x14, 0x63, 0x66, 0x61, 0x9A, 0xBF, 0x97, 0x21, 0x4D, 0xDD, 0x16, 0x69, 0x23, 0xCE, 0x26, 0xB5, 0xB1, 0x99, 0xDE, 0x20, 0x84, 0xB7, 0xD0, 0x2A, 0x14, 0xC2, 0x1C, 0xBF, 0x92, 0xAC, 0x97, 0x2A, 0x6B, 0x02, 0x05, 0x1C, 0x90, 0x61, 0xCF, 0x0D, 0xC6, 0xCE, 0x6D, 0xC2, 0x10, 0xC3, 0x1F, 0xC4, 0x5C, 0x25, 0x5B, 0x96, 0xF6, 0x02, 0xE8, 0xFE, 0x7C, 0xFD, 0x7B, 0xBF, 0x9E, 0x76, 0x57, 0x81, 0x50, 0x2F, 0x94, 0xFA, 0xAB, 0x68, 0x66, 0xCA, 0x8D, 0x35, 0xF9, 0x2A, 0xA4, 0xAA, 0xE2, 0x25, 0xC2, 0x07, 0x3E, 0x54, 0x67, 0x01, 0x10, 0xA2, 0xF6, 0xF3, 0x05, 0x28, 0x13, 0x70, 0x0A, 0x3C, 0xB7, 0xF5, 0x8C, 0x5E, 0xB7, 0x4F, 0x5D, 0x55, 0x4C, 0x1A, 0x71, 0xAA, 0xF8, 0x9F, 0x1D, 0xB8, 0xA4, 0xED, 0x8C, 0x95, 0x50, 0x72, 0x2E, 0x9C, 0x74, 0x8E, 0x61, 0x9D, 0xAA, 0xB9, 0xEE, 0x58, 0x08, 0x5E, 0x99, 0x29, 0x08, 0x5C, 0xE2, 0x4C, 0xD6, 0x5F, 0x6C, 0xC9, 0x2F, 0x9A, 0xBF, 0x6F, 0x5D, 0x24, 0x8E, 0x8E, 0x04, 0x88, 0x62, 0x64, 0x64, 0x6A, 0x08, 0xB1, 0x23, 0x3D, 0xF5, 0x80, 0x03, 0xF0, 0x38, 0x40, 0xFB, 0xA5, 0xD0, 0xF2, 0xB6, 0x85, 0x02, 0x63, 0x55, 0xBF, 0x70, 0x2B, 0x98, 0xD6, 0xAC, 0x86, 0x78, 0x45, 0xF3, 0x93, 0x7F, 0x13, 0xF3, 0x75, 0xC5, 0x02, 0x3B, 0x3B, 0x5D, 0x8E, 0x39, 0x10, 0xA9, 0x50, 0xC0, 0xB9, 0x61, 0xCD, 0x05, 0x2C, 0x4B, 0x3E, 0x7F, 0x33, 0x14, 0x93, 0x06, 0x55, 0x76, 0x22, 0xA2, 0x52, 0xBC, 0x53, 0xBF, 0x94, 0x5E, 0x32, 0x77, 0xA6, 0x53, 0x55, 0x3A, 0xF0, 0xAB, 0xAC, 0x2B, 0x01, 0x95, 0x55, 0x68, 0x95, 0x18, 0xED, 0xAE, 0x50, 0x42, 0x83, 0xFD, 0xB7, 0x51, 0x0F, 0x22, 0x8F, 0x35, 0x29, 0x4B, 0x94, 0x02, 0x8C, 0x75, 0xCB, 0x01, 0xFE, 0x43, 0xBE, 0xC4, 0xF6, 0xE8, 0x21, 0xF8, 0x2E, 0x28, 0xED, 0xD5, 0xE9, 0x37, 0x9D, 0x0B, 0x0E, 0xE8, 0x0F, 0x40, 0x02, 0x34, 0x1F, 0xED, 0xB6, 0x88, 0x72, 0xD8, 0xB5, 0x04, 0x74, 0x90, 0x75, 0x92, 0xB5, 0x80, 0xBA, 0x62, 0xCF, 0x08, 0xEF, 0xB1, 0x09, 0x68, 0x08, 0x25, 0x41, 0xFE, 0xDB, 0xA8, 0x86, 0xB2, 0x8F, 0x8C, 0x15, 0x55, 0x0F, 0x08, 0x1C, 0xF0, 0xED, 0x41, 0xC7, 0x84, 0x3F, 0x35, 0x45, 0x68, 0x08, 0x02, 0xDC, 0x99, 0xFE, 0x88, 0x36, 0x40, 0x98, 0x81, 0x62, 0xE5, 0x14, 0x83, 0x9A, 0x87, 0xA4, 0x11, 0x79, 0x73, 0xA4, 0xA3, 0x96, 0x07, 0xCD, 0x5C, 0x72, 0x10, 0xFE, 0x90, 0x60, 0x1B, 0x39, 0x16, 0xB7, 0x3B, 0x61, 0x6E, 0x50, 0xA5, 0x65, 0x7A, 0x10, 0x08, 0x31, 0xB1, 0x85, 0x4E, 0x22, 0xF7, 0x99, 0x08, 0x6A, 0x59, 0x39, 0x8B, 0x13, 0x5C, 0xCD, 0x76, 0x34, 0x99, 0x24, 0x6A, 0x90, 0xA4, 0x0A, 0x75, 0x2C, 0x28, 0x59, 0xB0, 0x42, 0xF6, 0x8F, 0x82, 0xD0, 0x06, 0xFE, 0x2B, 0x3B, 0x84, 0xDC, 0x1A, 0xCB, 0xCD, 0x9C, 0x91, 0xC5, 0xD6, 0x85, 0x25, 0x40, 0x10, 0x10, 0xC6, 0x67, 0x54, 0x68, 0xB8, 0xAF, 0xB1, 0x25, 0x01, 0xAA, 0x86, 0x26, 0xDF, 0x28, 0x30, 0xBB, 0x81, 0x4C, 0x84, 0xEB, 0x8A, 0x63, 0x86, 0xAE, 0xDD, 0xBA, 0x3E, 0xDB, 0x1D, 0x2C, 0xD7, 0xCB, 0xF3, 0x30, 0x8D, 0x3C, 0xA3, 0x8D, 0xCE, 0xBE, 0x4E, 0x39, 0x6E, 0xD8, 0x56, 0xB6, 0x3A, 0x59, 0x67, 0xB1, 0x15, 0xAA, 0xC3, 0x6F, 0x9D, 0x9E, 0x79, 0x6D, 0xD4, 0x6C, 0x27, 0x4F, 0x46, 0x79, 0xFD, 0xB7 };
+const size_t AdtsSilence_8_Size = sizeof(AdtsSilence_8_Data);
+
+//***************************************************************************
+// Huffman codebooks (ISO/IEC 14496-3, 4.A.1)
+//***************************************************************************
+
+static const int16u Aac_Codes_1[81] =
+{
+    0x07F8, 0x01F1, 0x07FD, 0x03F5, 0x0068, 0x03F0, 0x07F7, 0x01EC, 0x07F5, 0x03F1, 0x0072, 0x03F4,
+    0x0074, 0x0011, 0x0076, 0x01EB, 0x006C, 0x03F6, 0x07FC, 0x01E1, 0x07F1, 0x01F0, 0x0061, 0x01F6,
+    0x07F2, 0x01EA, 0x07FB, 0x01F2, 0x0069, 0x01ED, 0x0077, 0x0017, 0x006F, 0x01E6, 0x0064, 0x01E5,
+    0x0067, 0x0015, 0x0062, 0x0012, 0x0000, 0x0014, 0x0065, 0x0016, 0x006D, 0x01E9, 0x0063, 0x01E4,
+    0x006B, 0x0013, 0x0071, 0x01E3, 0x0070, 0x01F3, 0x07FE, 0x01E7, 0x07F3, 0x01EF, 0x0060, 0x01EE,
+    0x07F0, 0x01E2, 0x07FA, 0x03F3, 0x006A, 0x01E8, 0x0075, 0x0010, 0x0073, 0x01F4, 0x006E, 0x03F7,
+    0x07F6, 0x01E0, 0x07F9, 0x03F2, 0x0066, 0x01F5, 0x07FF, 0x01F7, 0x07F4,
+};
+
+static const int8u Aac_Bits_1[81] =
+{
+    11,  9, 11, 10,  7, 10, 11,  9, 11, 10,  7, 10,  7,  5,  7,  9,  7, 10, 11,  9,
+    11,  9,  7,  9, 11,  9, 11,  9,  7,  9,  7,  5,  7,  9,  7,  9,  7,  5,  7,  5,
+     1,  5,  7,  5,  7,  9,  7,  9,  7,  5,  7,  9,  7,  9, 11,  9, 11,  9,  7,  9,
+    11,  9, 11, 10,  7,  9,  7,  5,  7,  9,  7, 10, 11,  9, 11, 10,  7,  9, 11,  9,
+    11,
+};
+
+static const int16u Aac_Codes_2[81] =
+{
+    0x01F3, 0x006F, 0x01FD, 0x00EB, 0x0023, 0x00EA, 0x01F7, 0x00E8, 0x01FA, 0x00F2, 0x002D, 0x0070,
+    0x0020, 0x0006, 0x002B, 0x006E, 0x0028, 0x00E9, 0x01F9, 0x0066, 0x00F8, 0x00E7, 0x001B, 0x00F1,
+    0x01F4, 0x006B, 0x01F5, 0x00EC, 0x002A, 0x006C, 0x002C, 0x000A, 0x0027, 0x0067, 0x001A, 0x00F5,
+    0x0024, 0x0008, 0x001F, 0x0009, 0x0000, 0x0007, 0x001D, 0x000B, 0x0030, 0x00EF, 0x001C, 0x0064,
+    0x001E, 0x000C, 0x0029, 0x00F3, 0x002F, 0x00F0, 0x01FC, 0x0071, 0x01F2, 0x00F4, 0x0021, 0x00E6,
+    0x00F7, 0x0068, 0x01F8, 0x00EE, 0x0022, 0x0065, 0x0031, 0x0002, 0x0026, 0x00ED, 0x0025, 0x006A,
+    0x01FB, 0x0072, 0x01FE, 0x0069, 0x002E, 0x00F6, 0x01FF, 0x006D, 0x01F6,
+};
+
+static const int8u Aac_Bits_2[81] =
+{
+     9,  7,  9,  8,  6,  8,  9,  8,  9,  8,  6,  7,  6,  5,  6,  7,  6,  8,  9,  7,
+     8,  8,  6,  8,  9,  7,  9,  8,  6,  7,  6,  5,  6,  7,  6,  8,  6,  5,  6,  5,
+     3,  5,  6,  5,  6,  8,  6,  7,  6,  5,  6,  8,  6,  8,  9,  7,  9,  8,  6,  8,
+     8,  7,  9,  8,  6,  7,  6,  4,  6,  8,  6,  7,  9,  7,  9,  7,  6,  8,  9,  7,
+     9,
+};
+
+static const int16u Aac_Codes_3[81] =
+{
+    0x0000, 0x0009, 0x00EF, 0x000B, 0x0019, 0x00F0, 0x01EB, 0x01E6, 0x03F2, 0x000A, 0x0035, 0x01EF,
+    0x0034, 0x0037, 0x01E9, 0x01ED, 0x01E7, 0x03F3, 0x01EE, 0x03ED, 0x1FFA, 0x01EC, 0x01F2, 0x07F9,
+    0x07F8, 0x03F8, 0x0FF8, 0x0008, 0x0038, 0x03F6, 0x0036, 0x0075, 0x03F1, 0x03EB, 0x03EC, 0x0FF4,
+    0x0018, 0x0076, 0x07F4, 0x0039, 0x0074, 0x03EF, 0x01F3, 0x01F4, 0x07F6, 0x01E8, 0x03EA, 0x1FFC,
+    0x00F2, 0x01F1, 0x0FFB, 0x03F5, 0x07F3, 0x0FFC, 0x00EE, 0x03F7, 0x7FFE, 0x01F0, 0x07F5, 0x7FFD,
+    0x1FFB, 0x3FFA, 0xFFFF, 0x00F1, 0x03F0, 0x3FFC, 0x01EA, 0x03EE, 0x3FFB, 0x0FF6, 0x0FFA, 0x7FFC,
+    0x07F2, 0x0FF5, 0xFFFE, 0x03F4, 0x07F7, 0x7FFB, 0x0FF7, 0x0FF9, 0x7FFA,
+};
+
+static const int8u Aac_Bits_3[81] =
+{
+     1,  4,  8,  4,  5,  8,  9,  9, 10,  4,  6,  9,  6,  6,  9,  9,  9, 10,  9, 10,
+    13,  9,  9, 11, 11, 10, 12,  4,  6, 10,  6,  7, 10, 10, 10, 12,  5,  7, 11,  6,
+     7, 10,  9,  9, 11,  9, 10, 13,  8,  9, 12, 10, 11, 12,  8, 10, 15,  9, 11, 15,
+    13, 14, 16,  8, 10, 14,  9, 10, 14, 12, 12, 15, 11, 12, 16, 10, 11, 15, 12, 12,
+    15,
+};
+
+static const int16u Aac_Codes_4[81] =
+{
+    0x0007, 0x0016, 0x00F6, 0x0018, 0x0008, 0x00EF, 0x01EF, 0x00F3, 0x07F8, 0x0019, 0x0017, 0x00ED,
+    0x0015, 0x0001, 0x00E2, 0x00F0, 0x0070, 0x03F0, 0x01EE, 0x00F1, 0x07FA, 0x00EE, 0x00E4, 0x03F2,
+    0x07F6, 0x03EF, 0x07FD, 0x0005, 0x0014, 0x00F2, 0x0009, 0x0004, 0x00E5, 0x00F4, 0x00E8, 0x03F4,
+    0x0006, 0x0002, 0x00E7, 0x0003, 0x0000, 0x006B, 0x00E3, 0x0069, 0x01F3, 0x00EB, 0x00E6, 0x03F6,
+    0x006E, 0x006A, 0x01F4, 0x03EC, 0x01F0, 0x03F9, 0x00F5, 0x00EC, 0x07FB, 0x00EA, 0x006F, 0x03F7,
+    0x07F9, 0x03F3, 0x0FFF, 0x00E9, 0x006D, 0x03F8, 0x006C, 0x0068, 0x01F5, 0x03EE, 0x01F2, 0x07F4,
+    0x07F7, 0x03F1, 0x0FFE, 0x03ED, 0x01F1, 0x07F5, 0x07FE, 0x03F5, 0x07FC,
+};
+
+static const int8u Aac_Bits_4[81] =
+{
+     4,  5,  8,  5,  4,  8,  9,  8, 11,  5,  5,  8,  5,  4,  8,  8,  7, 10,  9,  8,
+    11,  8,  8, 10, 11, 10, 11,  4,  5,  8,  4,  4,  8,  8,  8, 10,  4,  4,  8,  4,
+     4,  7,  8,  7,  9,  8,  8, 10,  7,  7,  9, 10,  9, 10,  8,  8, 11,  8,  7, 10,
+    11, 10, 12,  8,  7, 10,  7,  7,  9, 10,  9, 11, 11, 10, 12, 10,  9, 11, 11, 10,
+    11,
+};
+
+static const int16u Aac_Codes_5[81] =
+{
+    0x1FFF, 0x0FF7, 0x07F4, 0x07E8, 0x03F1, 0x07EE, 0x07F9, 0x0FF8, 0x1FFD, 0x0FFD, 0x07F1, 0x03E8,
+    0x01E8, 0x00F0, 0x01EC, 0x03EE, 0x07F2, 0x0FFA, 0x0FF4, 0x03EF, 0x01F2, 0x00E8, 0x0070, 0x00EC,
+    0x01F0, 0x03EA, 0x07F3, 0x07EB, 0x01EB, 0x00EA, 0x001A, 0x0008, 0x0019, 0x00EE, 0x01EF, 0x07ED,
+    0x03F0, 0x00F2, 0x0073, 0x000B, 0x0000, 0x000A, 0x0071, 0x00F3, 0x07E9, 0x07EF, 0x01EE, 0x00EF,
+    0x0018, 0x0009, 0x001B, 0x00EB, 0x01E9, 0x07EC, 0x07F6, 0x03EB, 0x01F3, 0x00ED, 0x0072, 0x00E9,
+    0x01F1, 0x03ED, 0x07F7, 0x0FF6, 0x07F0, 0x03E9, 0x01ED, 0x00F1, 0x01EA, 0x03EC, 0x07F8, 0x0FF9,
+    0x1FFC, 0x0FFC, 0x0FF5, 0x07EA, 0x03F3, 0x03F2, 0x07F5, 0x0FFB, 0x1FFE,
+};
+
+static const int8u Aac_Bits_5[81] =
+{
+    13, 12, 11, 11, 10, 11, 11, 12, 13, 12, 11, 10,  9,  8,  9, 10, 11, 12, 12, 10,
+     9,  8,  7,  8,  9, 10, 11, 11,  9,  8,  5,  4,  5,  8,  9, 11, 10,  8,  7,  4,
+     1,  4,  7,  8, 11, 11,  9,  8,  5,  4,  5,  8,  9, 11, 11, 10,  9,  8,  7,  8,
+     9, 10, 11, 12, 11, 10,  9,  8,  9, 10, 11, 12, 13, 12, 12, 11, 10, 10, 11, 12,
+    13,
+};
+
+static const int16u Aac_Codes_6[81] =
+{
+    0x07FE, 0x03FD, 0x01F1, 0x01EB, 0x01F4, 0x01EA, 0x01F0, 0x03FC, 0x07FD, 0x03F6, 0x01E5, 0x00EA,
+    0x006C, 0x0071, 0x0068, 0x00F0, 0x01E6, 0x03F7, 0x01F3, 0x00EF, 0x0032, 0x0027, 0x0028, 0x0026,
+    0x0031, 0x00EB, 0x01F7, 0x01E8, 0x006F, 0x002E, 0x0008, 0x0004, 0x0006, 0x0029, 0x006B, 0x01EE,
+    0x01EF, 0x0072, 0x002D, 0x0002, 0x0000, 0x0003, 0x002F, 0x0073, 0x01FA, 0x01E7, 0x006E, 0x002B,
+    0x0007, 0x0001, 0x0005, 0x002C, 0x006D, 0x01EC, 0x01F9, 0x00EE, 0x0030, 0x0024, 0x002A, 0x0025,
+    0x0033, 0x00EC, 0x01F2, 0x03F8, 0x01E4, 0x00ED, 0x006A, 0x0070, 0x0069, 0x0074, 0x00F1, 0x03FA,
+    0x07FF, 0x03F9, 0x01F6, 0x01ED, 0x01F8, 0x01E9, 0x01F5, 0x03FB, 0x07FC,
+};
+
+static const int8u Aac_Bits_6[81] =
+{
+    11, 10,  9,  9,  9,  9,  9, 10, 11, 10,  9,  8,  7,  7,  7,  8,  9, 10,  9,  8,
+     6,  6,  6,  6,  6,  8,  9,  9,  7,  6,  4,  4,  4,  6,  7,  9,  9,  7,  6,  4,
+     4,  4,  6,  7,  9,  9,  7,  6,  4,  4,  4,  6,  7,  9,  9,  8,  6,  6,  6,  6,
+     6,  8,  9, 10,  9,  8,  7,  7,  7,  7,  8, 10, 11, 10,  9,  9,  9,  9,  9, 10,
+    11,
+};
+
+static const int16u Aac_Codes_7[64] =
+{
+    0x0000, 0x0005, 0x0037, 0x0074, 0x00F2, 0x01EB, 0x03ED, 0x07F7, 0x0004, 0x000C, 0x0035, 0x0071,
+    0x00EC, 0x00EE, 0x01EE, 0x01F5, 0x0036, 0x0034, 0x0072, 0x00EA, 0x00F1, 0x01E9, 0x01F3, 0x03F5,
+    0x0073, 0x0070, 0x00EB, 0x00F0, 0x01F1, 0x01F0, 0x03EC, 0x03FA, 0x00F3, 0x00ED, 0x01E8, 0x01EF,
+    0x03EF, 0x03F1, 0x03F9, 0x07FB, 0x01ED, 0x00EF, 0x01EA, 0x01F2, 0x03F3, 0x03F8, 0x07F9, 0x07FC,
+    0x03EE, 0x01EC, 0x01F4, 0x03F4, 0x03F7, 0x07F8, 0x0FFD, 0x0FFE, 0x07F6, 0x03F0, 0x03F2, 0x03F6,
+    0x07FA, 0x07FD, 0x0FFC, 0x0FFF,
+};
+
+static const int8u Aac_Bits_7[64] =
+{
+     1,  3,  6,  7,  8,  9, 10, 11,  3,  4,  6,  7,  8,  8,  9,  9,  6,  6,  7,  8,
+     8,  9,  9, 10,  7,  7,  8,  8,  9,  9, 10, 10,  8,  8,  9,  9, 10, 10, 10, 11,
+     9,  8,  9,  9, 10, 10, 11, 11, 10,  9,  9, 10, 10, 11, 12, 12, 11, 10, 10, 10,
+    11, 11, 12, 12,
+};
+
+static const int16u Aac_Codes_8[64] =
+{
+    0x000E, 0x0005, 0x0010, 0x0030, 0x006F, 0x00F1, 0x01FA, 0x03FE, 0x0003, 0x0000, 0x0004, 0x0012,
+    0x002C, 0x006A, 0x0075, 0x00F8, 0x000F, 0x0002, 0x0006, 0x0014, 0x002E, 0x0069, 0x0072, 0x00F5,
+    0x002F, 0x0011, 0x0013, 0x002A, 0x0032, 0x006C, 0x00EC, 0x00FA, 0x0071, 0x002B, 0x002D, 0x0031,
+    0x006D, 0x0070, 0x00F2, 0x01F9, 0x00EF, 0x0068, 0x0033, 0x006B, 0x006E, 0x00EE, 0x00F9, 0x03FC,
+    0x01F8, 0x0074, 0x0073, 0x00ED, 0x00F0, 0x00F6, 0x01F6, 0x01FD, 0x03FD, 0x00F3, 0x00F4, 0x00F7,
+    0x01F7, 0x01FB, 0x01FC, 0x03FF,
+};
+
+static const int8u Aac_Bits_8[64] =
+{
+     5,  4,  5,  6,  7,  8,  9, 10,  4,  3,  4,  5,  6,  7,  7,  8,  5,  4,  4,  5,
+     6,  7,  7,  8,  6,  5,  5,  6,  6,  7,  8,  8,  7,  6,  6,  6,  7,  7,  8,  9,
+     8,  7,  6,  7,  7,  8,  8, 10,  9,  7,  7,  8,  8,  8,  9,  9, 10,  8,  8,  8,
+     9,  9,  9, 10,
+};
+
+static const int16u Aac_Codes_9[169] =
+{
+    0x0000, 0x0005, 0x0037, 0x00E7, 0x01DE, 0x03CE, 0x03D9, 0x07C8, 0x07CD, 0x0FC8, 0x0FDD, 0x1FE4,
+    0x1FEC, 0x0004, 0x000C, 0x0035, 0x0072, 0x00EA, 0x00ED, 0x01E2, 0x03D1, 0x03D3, 0x03E0, 0x07D8,
+    0x0FCF, 0x0FD5, 0x0036, 0x0034, 0x0071, 0x00E8, 0x00EC, 0x01E1, 0x03CF, 0x03DD, 0x03DB, 0x07D0,
+    0x0FC7, 0x0FD4, 0x0FE4, 0x00E6, 0x0070, 0x00E9, 0x01DD, 0x01E3, 0x03D2, 0x03DC, 0x07CC, 0x07CA,
+    0x07DE, 0x0FD8, 0x0FEA, 0x1FDB, 0x01DF, 0x00EB, 0x01DC, 0x01E6, 0x03D5, 0x03DE, 0x07CB, 0x07DD,
+    0x07DC, 0x0FCD, 0x0FE2, 0x0FE7, 0x1FE1, 0x03D0, 0x01E0, 0x01E4, 0x03D6, 0x07C5, 0x07D1, 0x07DB,
+    0x0FD2, 0x07E0, 0x0FD9, 0x0FEB, 0x1FE3, 0x1FE9, 0x07C4, 0x01E5, 0x03D7, 0x07C6, 0x07CF, 0x07DA,
+    0x0FCB, 0x0FDA, 0x0FE3, 0x0FE9, 0x1FE6, 0x1FF3, 0x1FF7, 0x07D3, 0x03D8, 0x03E1, 0x07D4, 0x07D9,
+    0x0FD3, 0x0FDE, 0x1FDD, 0x1FD9, 0x1FE2, 0x1FEA, 0x1FF1, 0x1FF6, 0x07D2, 0x03D4, 0x03DA, 0x07C7,
+    0x07D7, 0x07E2, 0x0FCE, 0x0FDB, 0x1FD8, 0x1FEE, 0x3FF0, 0x1FF4, 0x3FF2, 0x07E1, 0x03DF, 0x07C9,
+    0x07D6, 0x0FCA, 0x0FD0, 0x0FE5, 0x0FE6, 0x1FEB, 0x1FEF, 0x3FF3, 0x3FF4, 0x3FF5, 0x0FE0, 0x07CE,
+    0x07D5, 0x0FC6, 0x0FD1, 0x0FE1, 0x1FE0, 0x1FE8, 0x1FF0, 0x3FF1, 0x3FF8, 0x3FF6, 0x7FFC, 0x0FE8,
+    0x07DF, 0x0FC9, 0x0FD7, 0x0FDC, 0x1FDC, 0x1FDF, 0x1FED, 0x1FF5, 0x3FF9, 0x3FFB, 0x7FFD, 0x7FFE,
+    0x1FE7, 0x0FCC, 0x0FD6, 0x0FDF, 0x1FDE, 0x1FDA, 0x1FE5, 0x1FF2, 0x3FFA, 0x3FF7, 0x3FFC, 0x3FFD,
+    0x7FFF,
+};
+
+static const int8u Aac_Bits_9[169] =
+{
+     1,  3,  6,  8,  9, 10, 10, 11, 11, 12, 12, 13, 13,  3,  4,  6,  7,  8,  8,  9,
+    10, 10, 10, 11, 12, 12,  6,  6,  7,  8,  8,  9, 10, 10, 10, 11, 12, 12, 12,  8,
+     7,  8,  9,  9, 10, 10, 11, 11, 11, 12, 12, 13,  9,  8,  9,  9, 10, 10, 11, 11,
+    11, 12, 12, 12, 13, 10,  9,  9, 10, 11, 11, 11, 12, 11, 12, 12, 13, 13, 11,  9,
+    10, 11, 11, 11, 12, 12, 12, 12, 13, 13, 13, 11, 10, 10, 11, 11, 12, 12, 13, 13,
+    13, 13, 13, 13, 11, 10, 10, 11, 11, 11, 12, 12, 13, 13, 14, 13, 14, 11, 10, 11,
+    11, 12, 12, 12, 12, 13, 13, 14, 14, 14, 12, 11, 11, 12, 12, 12, 13, 13, 13, 14,
+    14, 14, 15, 12, 11, 12, 12, 12, 13, 13, 13, 13, 14, 14, 15, 15, 13, 12, 12, 12,
+    13, 13, 13, 13, 14, 14, 14, 14, 15,
+};
+
+static const int16u Aac_Codes_10[169] =
+{
+    0x0022, 0x0008, 0x001D, 0x0026, 0x005F, 0x00D3, 0x01CF, 0x03D0, 0x03D7, 0x03ED, 0x07F0, 0x07F6,
+    0x0FFD, 0x0007, 0x0000, 0x0001, 0x0009, 0x0020, 0x0054, 0x0060, 0x00D5, 0x00DC, 0x01D4, 0x03CD,
+    0x03DE, 0x07E7, 0x001C, 0x0002, 0x0006, 0x000C, 0x001E, 0x0028, 0x005B, 0x00CD, 0x00D9, 0x01CE,
+    0x01DC, 0x03D9, 0x03F1, 0x0025, 0x000B, 0x000A, 0x000D, 0x0024, 0x0057, 0x0061, 0x00CC, 0x00DD,
+    0x01CC, 0x01DE, 0x03D3, 0x03E7, 0x005D, 0x0021, 0x001F, 0x0023, 0x0027, 0x0059, 0x0064, 0x00D8,
+    0x00DF, 0x01D2, 0x01E2, 0x03DD, 0x03EE, 0x00D1, 0x0055, 0x0029, 0x0056, 0x0058, 0x0062, 0x00CE,
+    0x00E0, 0x00E2, 0x01DA, 0x03D4, 0x03E3, 0x07EB, 0x01C9, 0x005E, 0x005A, 0x005C, 0x0063, 0x00CA,
+    0x00DA, 0x01C7, 0x01CA, 0x01E0, 0x03DB, 0x03E8, 0x07EC, 0x01E3, 0x00D2, 0x00CB, 0x00D0, 0x00D7,
+    0x00DB, 0x01C6, 0x01D5, 0x01D8, 0x03CA, 0x03DA, 0x07EA, 0x07F1, 0x01E1, 0x00D4, 0x00CF, 0x00D6,
+    0x00DE, 0x00E1, 0x01D0, 0x01D6, 0x03D1, 0x03D5, 0x03F2, 0x07EE, 0x07FB, 0x03E9, 0x01CD, 0x01C8,
+    0x01CB, 0x01D1, 0x01D7, 0x01DF, 0x03CF, 0x03E0, 0x03EF, 0x07E6, 0x07F8, 0x0FFA, 0x03EB, 0x01DD,
+    0x01D3, 0x01D9, 0x01DB, 0x03D2, 0x03CC, 0x03DC, 0x03EA, 0x07ED, 0x07F3, 0x07F9, 0x0FF9, 0x07F2,
+    0x03CE, 0x01E4, 0x03CB, 0x03D8, 0x03D6, 0x03E2, 0x03E5, 0x07E8, 0x07F4, 0x07F5, 0x07F7, 0x0FFB,
+    0x07FA, 0x03EC, 0x03DF, 0x03E1, 0x03E4, 0x03E6, 0x03F0, 0x07E9, 0x07EF, 0x0FF8, 0x0FFE, 0x0FFC,
+    0x0FFF,
+};
+
+static const int8u Aac_Bits_10[169] =
+{
+     6,  5,  6,  6,  7,  8,  9, 10, 10, 10, 11, 11, 12,  5,  4,  4,  5,  6,  7,  7,
+     8,  8,  9, 10, 10, 11,  6,  4,  5,  5,  6,  6,  7,  8,  8,  9,  9, 10, 10,  6,
+     5,  5,  5,  6,  7,  7,  8,  8,  9,  9, 10, 10,  7,  6,  6,  6,  6,  7,  7,  8,
+     8,  9,  9, 10, 10,  8,  7,  6,  7,  7,  7,  8,  8,  8,  9, 10, 10, 11,  9,  7,
+     7,  7,  7,  8,  8,  9,  9,  9, 10, 10, 11,  9,  8,  8,  8,  8,  8,  9,  9,  9,
+    10, 10, 11, 11,  9,  8,  8,  8,  8,  8,  9,  9, 10, 10, 10, 11, 11, 10,  9,  9,
+     9,  9,  9,  9, 10, 10, 10, 11, 11, 12, 10,  9,  9,  9,  9, 10, 10, 10, 10, 11,
+    11, 11, 12, 11, 10,  9, 10, 10, 10, 10, 10, 11, 11, 11, 11, 12, 11, 10, 10, 10,
+    10, 10, 10, 11, 11, 12, 12, 12, 12,
+};
+
+static const int16u Aac_Codes_11[289] =
+{
+    0x0000, 0x0006, 0x0019, 0x003D, 0x009C, 0x00C6, 0x01A7, 0x0390, 0x03C2, 0x03DF, 0x07E6, 0x07F3,
+    0x0FFB, 0x07EC, 0x0FFA, 0x0FFE, 0x038E, 0x0005, 0x0001, 0x0008, 0x0014, 0x0037, 0x0042, 0x0092,
+    0x00AF, 0x0191, 0x01A5, 0x01B5, 0x039E, 0x03C0, 0x03A2, 0x03CD, 0x07D6, 0x00AE, 0x0017, 0x0007,
+    0x0009, 0x0018, 0x0039, 0x0040, 0x008E, 0x00A3, 0x00B8, 0x0199, 0x01AC, 0x01C1, 0x03B1, 0x0396,
+    0x03BE, 0x03CA, 0x009D, 0x003C, 0x0015, 0x0016, 0x001A, 0x003B, 0x0044, 0x0091, 0x00A5, 0x00BE,
+    0x0196, 0x01AE, 0x01B9, 0x03A1, 0x0391, 0x03A5, 0x03D5, 0x0094, 0x009A, 0x0036, 0x0038, 0x003A,
+    0x0041, 0x008C, 0x009B, 0x00B0, 0x00C3, 0x019E, 0x01AB, 0x01BC, 0x039F, 0x038F, 0x03A9, 0x03CF,
+    0x0093, 0x00BF, 0x003E, 0x003F, 0x0043, 0x0045, 0x009E, 0x00A7, 0x00B9, 0x0194, 0x01A2, 0x01BA,
+    0x01C3, 0x03A6, 0x03A7, 0x03BB, 0x03D4, 0x009F, 0x01A0, 0x008F, 0x008D, 0x0090, 0x0098, 0x00A6,
+    0x00B6, 0x00C4, 0x019F, 0x01AF, 0x01BF, 0x0399, 0x03BF, 0x03B4, 0x03C9, 0x03E7, 0x00A8, 0x01B6,
+    0x00AB, 0x00A4, 0x00AA, 0x00B2, 0x00C2, 0x00C5, 0x0198, 0x01A4, 0x01B8, 0x038C, 0x03A4, 0x03C4,
+    0x03C6, 0x03DD, 0x03E8, 0x00AD, 0x03AF, 0x0192, 0x00BD, 0x00BC, 0x018E, 0x0197, 0x019A, 0x01A3,
+    0x01B1, 0x038D, 0x0398, 0x03B7, 0x03D3, 0x03D1, 0x03DB, 0x07DD, 0x00B4, 0x03DE, 0x01A9, 0x019B,
+    0x019C, 0x01A1, 0x01AA, 0x01AD, 0x01B3, 0x038B, 0x03B2, 0x03B8, 0x03CE, 0x03E1, 0x03E0, 0x07D2,
+    0x07E5, 0x00B7, 0x07E3, 0x01BB, 0x01A8, 0x01A6, 0x01B0, 0x01B2, 0x01B7, 0x039B, 0x039A, 0x03BA,
+    0x03B5, 0x03D6, 0x07D7, 0x03E4, 0x07D8, 0x07EA, 0x00BA, 0x07E8, 0x03A0, 0x01BD, 0x01B4, 0x038A,
+    0x01C4, 0x0392, 0x03AA, 0x03B0, 0x03BC, 0x03D7, 0x07D4, 0x07DC, 0x07DB, 0x07D5, 0x07F0, 0x00C1,
+    0x07FB, 0x03C8, 0x03A3, 0x0395, 0x039D, 0x03AC, 0x03AE, 0x03C5, 0x03D8, 0x03E2, 0x03E6, 0x07E4,
+    0x07E7, 0x07E0, 0x07E9, 0x07F7, 0x0190, 0x07F2, 0x0393, 0x01BE, 0x01C0, 0x0394, 0x0397, 0x03AD,
+    0x03C3, 0x03C1, 0x03D2, 0x07DA, 0x07D9, 0x07DF, 0x07EB, 0x07F4, 0x07FA, 0x0195, 0x07F8, 0x03BD,
+    0x039C, 0x03AB, 0x03A8, 0x03B3, 0x03B9, 0x03D0, 0x03E3, 0x03E5, 0x07E2, 0x07DE, 0x07ED, 0x07F1,
+    0x07F9, 0x07FC, 0x0193, 0x0FFD, 0x03DC, 0x03B6, 0x03C7, 0x03CC, 0x03CB, 0x03D9, 0x03DA, 0x07D3,
+    0x07E1, 0x07EE, 0x07EF, 0x07F5, 0x07F6, 0x0FFC, 0x0FFF, 0x019D, 0x01C2, 0x00B5, 0x00A1, 0x0096,
+    0x0097, 0x0095, 0x0099, 0x00A0, 0x00A2, 0x00AC, 0x00A9, 0x00B1, 0x00B3, 0x00BB, 0x00C0, 0x018F,
+    0x0004,
+};
+
+static const int8u Aac_Bits_11[289] =
+{
+     4,  5,  6,  7,  8,  8,  9, 10, 10, 10, 11, 11, 12, 11, 12, 12, 10,  5,  4,  5,
+     6,  7,  7,  8,  8,  9,  9,  9, 10, 10, 10, 10, 11,  8,  6,  5,  5,  6,  7,  7,
+     8,  8,  8,  9,  9,  9, 10, 10, 10, 10,  8,  7,  6,  6,  6,  7,  7,  8,  8,  8,
+     9,  9,  9, 10, 10, 10, 10,  8,  8,  7,  7,  7,  7,  8,  8,  8,  8,  9,  9,  9,
+    10, 10, 10, 10,  8,  8,  7,  7,  7,  7,  8,  8,  8,  9,  9,  9,  9, 10, 10, 10,
+    10,  8,  9,  8,  8,  8,  8,  8,  8,  8,  9,  9,  9, 10, 10, 10, 10, 10,  8,  9,
+     8,  8,  8,  8,  8,  8,  9,  9,  9, 10, 10, 10, 10, 10, 10,  8, 10,  9,  8,  8,
+     9,  9,  9,  9,  9, 10, 10, 10, 10, 10, 10, 11,  8, 10,  9,  9,  9,  9,  9,  9,
+     9, 10, 10, 10, 10, 10, 10, 11, 11,  8, 11,  9,  9,  9,  9,  9,  9, 10, 10, 10,
+    10, 10, 11, 10, 11, 11,  8, 11, 10,  9,  9, 10,  9, 10, 10, 10, 10, 10, 11, 11,
+    11, 11, 11,  8, 11, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 11, 11, 11, 11, 11,
+     9, 11, 10,  9,  9, 10, 10, 10, 10, 10, 10, 11, 11, 11, 11, 11, 11,  9, 11, 10,
+    10, 10, 10, 10, 10, 10, 10, 10, 11, 11, 11, 11, 11, 11,  9, 12, 10, 10, 10, 10,
+    10, 10, 10, 11, 11, 11, 11, 11, 11, 12, 12,  9,  9,  8,  8,  8,  8,  8,  8,  8,
+     8,  8,  8,  8,  8,  8,  8,  9,  5,
+};
+
+static const int32u Aac_ScaleFactor_Codes[121] =
+{
+    0x3FFE8, 0x3FFE6, 0x3FFE7, 0x3FFE5, 0x7FFF5, 0x7FFF1, 0x7FFED, 0x7FFF6, 0x7FFEE, 0x7FFEF,
+    0x7FFF0, 0x7FFFC, 0x7FFFD, 0x7FFFF, 0x7FFFE, 0x7FFF7, 0x7FFF8, 0x7FFFB, 0x7FFF9, 0x3FFE4,
+    0x7FFFA, 0x3FFE3, 0x1FFEF, 0x1FFF0, 0x0FFF5, 0x1FFEE, 0x0FFF2, 0x0FFF3, 0x0FFF4, 0x0FFF1,
+    0x07FF6, 0x07FF7, 0x03FF9, 0x03FF5, 0x03FF7, 0x03FF3, 0x03FF6, 0x03FF2, 0x01FF7, 0x01FF5,
+    0x00FF9, 0x00FF7, 0x00FF6, 0x007F9, 0x00FF4, 0x007F8, 0x003F9, 0x003F7, 0x003F5, 0x001F8,
+    0x001F7, 0x000FA, 0x000F8, 0x000F6, 0x00079, 0x0003A, 0x00038, 0x0001A, 0x0000B, 0x00004,
+    0x00000, 0x0000A, 0x0000C, 0x0001B, 0x00039, 0x0003B, 0x00078, 0x0007A, 0x000F7, 0x000F9,
+    0x001F6, 0x001F9, 0x003F4, 0x003F6, 0x003F8, 0x007F5, 0x007F4, 0x007F6, 0x007F7, 0x00FF5,
+    0x00FF8, 0x01FF4, 0x01FF6, 0x01FF8, 0x03FF8, 0x03FF4, 0x0FFF0, 0x07FF4, 0x0FFF6, 0x07FF5,
+    0x3FFE2, 0x7FFD9, 0x7FFDA, 0x7FFDB, 0x7FFDC, 0x7FFDD, 0x7FFDE, 0x7FFD8, 0x7FFD2, 0x7FFD3,
+    0x7FFD4, 0x7FFD5, 0x7FFD6, 0x7FFF2, 0x7FFDF, 0x7FFE7, 0x7FFE8, 0x7FFE9, 0x7FFEA, 0x7FFEB,
+    0x7FFE6, 0x7FFE0, 0x7FFE1, 0x7FFE2, 0x7FFE3, 0x7FFE4, 0x7FFE5, 0x7FFD7, 0x7FFEC, 0x7FFF4,
+    0x7FFF3,
+};
+
+static const int8u Aac_ScaleFactor_Bits[121] =
+{
+    18, 18, 18, 18, 19, 19, 19, 19, 19, 19, 19, 19, 19, 19, 19, 19, 19, 19, 19, 18,
+    19, 18, 17, 17, 16, 17, 16, 16, 16, 16, 15, 15, 14, 14, 14, 14, 14, 14, 13, 13,
+    12, 12, 12, 11, 12, 11, 10, 10, 10,  9,  9,  8,  8,  8,  7,  6,  6,  5,  4,  3,
+     1,  4,  4,  5,  6,  6,  7,  7,  8,  8,  9,  9, 10, 10, 10, 11, 11, 11, 11, 12,
+    12, 13, 13, 13, 14, 14, 16, 15, 16, 15, 18, 19, 19, 19, 19, 19, 19, 19, 19, 19,
+    19, 19, 19, 19, 19, 19, 19, 19, 19, 19, 19, 19, 19, 19, 19, 19, 19, 19, 19, 19,
+    19,
+};
+
+//***************************************************************************
+// Scale factor bands at 44.1 kHz
+//***************************************************************************
+
+static const int16u Aac_Swb_Offsets_Long[] = { 0, 4, 8, 12, 16, 20, 24, 28, 32, 36, 40, 48, 56, 64, 72, 80, 88, 96, 108, 120, 132, 144, 160, 176, 196, 216, 240, 264, 292, 320, 352, 384, 416, 448, 480, 512, 544, 576, 608, 640, 672, 704, 736, 768, 800, 832, 864, 896, 928, 1024 };
+static const int16u Aac_Swb_Offsets_Short[] = { 0, 4, 8, 12, 16, 20, 28, 36, 44, 56, 68, 80, 96, 112, 128 };
+static const size_t Aac_Swb_Count_Long = sizeof(Aac_Swb_Offsets_Long) / sizeof(*Aac_Swb_Offsets_Long) - 1;
+static const size_t Aac_Swb_Count_Short = sizeof(Aac_Swb_Offsets_Short) / sizeof(*Aac_Swb_Offsets_Short) - 1;
+
+//***************************************************************************
+// Syntax elements
+//***************************************************************************
+
+enum aac_element
+{
+    Aac_Element_SCE,
+    Aac_Element_CPE,
+    Aac_Element_CCE,
+    Aac_Element_LFE,
+    Aac_Element_DSE,
+    Aac_Element_PCE,
+    Aac_Element_FIL,
+    Aac_Element_END,
+};
+
+enum aac_codebook
+{
+    Aac_Codebook_Zero = 0,
+    Aac_Codebook_FirstPair = 5,                     // 2 values per codeword from this one, else 4
+    Aac_Codebook_Escape = 11,
+    Aac_Codebook_Reserved = 12,
+    Aac_Codebook_Noise = 13,
+    Aac_Codebook_Intensity2 = 14,
+    Aac_Codebook_Intensity = 15,
+};
+
+static const int8u Aac_Tns_Order_Max_Long = 12;  // Low Complexity profile
+static const int8u Aac_Tns_Order_Max_Short = 7;
+static const size_t Aac_Escape_Prefix_Max = 8;   // Values are up to 8191
+
+//***************************************************************************
+// Class aac_bits
+//***************************************************************************
+
+// Big endian bit reader, reads after the end return zeros and the overrun is checked by the caller
+class aac_bits
+{
+public:
+    aac_bits(const int8u* Buffer_, size_t Buffer_Size_) : Buffer(Buffer_), Buffer_Size(Buffer_Size_) {}
+
+    int32u Peek(size_t Count) const // Up to 25 bits
+    {
+        if (!Count)
+            return 0;
+        auto Byte = Pos >> 3;
+        int32u Value;
+        if (Byte + 4 <= Buffer_Size)
+            Value = (((int32u)Buffer[Byte]) << 24) | (((int32u)Buffer[Byte + 1]) << 16) | (((int32u)Buffer[Byte + 2]) << 8) | Buffer[Byte + 3];
+        else
+        {
+            Value = 0;
+            for (size_t i = 0; i < 4; i++)
+                Value = (Value << 8) | (Byte + i < Buffer_Size ? Buffer[Byte + i] : 0);
+        }
+        return (Value << (Pos & 7)) >> (32 - Count);
+    }
+    int32u Get(size_t Count)
+    {
+        auto Value = Peek(Count);
+        Pos += Count;
+        return Value;
+    }
+    void Skip(size_t Count) { Pos += Count; }
+    void Align() { Pos = (Pos + 7) & ~(size_t)7; }
+    bool Overrun() const { return Pos > Buffer_Size * 8; }
+    bool End() const { return Pos == Buffer_Size * 8; }
+
+private:
+    const int8u*    Buffer;
+    size_t          Buffer_Size;
+    size_t          Pos = 0;                        // In bits
+};
+
+//***************************************************************************
+// Class aac_huffman
+//***************************************************************************
+
+// A first table indexed by the next Root_Bits bits, then a second table per prefix of longer codes
+class aac_huffman
+{
+public:
+    template<typename T> aac_huffman(const T* Codes, const int8u* Bits, size_t Count)
+    {
+        Entries.resize(1 << Root_Bits);
+        int8u Sub_Bits[1 << Root_Bits] = {};
+        for (size_t i = 0; i < Count; i++)
+            if (Bits[i] > Root_Bits)
+            {
+                auto& Item = Sub_Bits[Codes[i] >> (Bits[i] - Root_Bits)];
+                Item = max(Item, (int8u)(Bits[i] - Root_Bits));
+            }
+        for (size_t i = 0; i < (1 << Root_Bits); i++)
+            if (Sub_Bits[i])
+            {
+                Entries[i] = { (int16u)Entries.size(), 0, Sub_Bits[i] };
+                Entries.resize(Entries.size() + ((size_t)1 << Sub_Bits[i]));
+            }
+        for (size_t i = 0; i < Count; i++)
+        {
+            size_t Begin, End;
+            if (Bits[i] <= Root_Bits)
+            {
+                Begin = (size_t)Codes[i] << (Root_Bits - Bits[i]);
+                End = Begin + ((size_t)1 << (Root_Bits - Bits[i]));
+            }
+            else
+            {
+                const auto& Root = Entries[Codes[i] >> (Bits[i] - Root_Bits)];
+                auto Sub_Size = Bits[i] - Root_Bits;
+                Begin = Root.Value + (((size_t)Codes[i] & (((size_t)1 << Sub_Size) - 1)) << (Root.Sub_Bits - Sub_Size));
+                End = Begin + ((size_t)1 << (Root.Sub_Bits - Sub_Size));
+            }
+            for (auto j = Begin; j < End; j++)
+                Entries[j] = { (int16u)i, Bits[i], 0 };
+        }
+    }
+
+    // Position in the codebook, -1 if not a codeword
+    int Decode(aac_bits& Bits) const
+    {
+        auto Entry = &Entries[Bits.Peek(Root_Bits)];
+        if (Entry->Sub_Bits)
+            Entry = &Entries[Entry->Value + (Bits.Peek(Root_Bits + Entry->Sub_Bits) & ((1 << Entry->Sub_Bits) - 1))];
+        if (!Entry->Length)
+            return -1;
+        Bits.Skip(Entry->Length);
+        return Entry->Value;
+    }
+
+private:
+    static const size_t Root_Bits = 8;
+    struct entry
+    {
+        int16u      Value;                          // Position in the codebook, or of the second table
+        int8u       Length;                         // 0 for a second table
+        int8u       Sub_Bits;                       // Size of the index of the second table
+    };
+    vector<entry>   Entries;
+};
+
+// Built once, the scale factor codebook then the spectral codebooks
+static const aac_huffman Aac_Huffman[12] =
+{
+    { Aac_ScaleFactor_Codes, Aac_ScaleFactor_Bits, 121 },
+    { Aac_Codes_1, Aac_Bits_1, 81 },
+    { Aac_Codes_2, Aac_Bits_2, 81 },
+    { Aac_Codes_3, Aac_Bits_3, 81 },
+    { Aac_Codes_4, Aac_Bits_4, 81 },
+    { Aac_Codes_5, Aac_Bits_5, 81 },
+    { Aac_Codes_6, Aac_Bits_6, 81 },
+    { Aac_Codes_7, Aac_Bits_7, 64 },
+    { Aac_Codes_8, Aac_Bits_8, 64 },
+    { Aac_Codes_9, Aac_Bits_9, 169 },
+    { Aac_Codes_10, Aac_Bits_10, 169 },
+    { Aac_Codes_11, Aac_Bits_11, 289 },
+};
+
+// Values per codeword are digits of the codebook position in this base
+static const int8u Aac_Codebook_Base[12] = { 0, 3, 3, 3, 3, 9, 9, 8, 8, 13, 13, 17 };
+static const bool Aac_Codebook_IsUnsigned[12] = { false, false, false, true, true, false, false, true, true, true, true, true };
+
+//***************************************************************************
+// Class raw_data_block
+//***************************************************************************
+
+// Count of each kind of channel element
+struct aac_channels
+{
+    size_t          Sce = 0;
+    size_t          Cpe = 0;
+    size_t          Lfe = 0;
+
+    size_t          Count() const { return Sce + Cpe * 2 + Lfe; }
+    bool            operator!=(const aac_channels& Other) const { return Sce != Other.Sce || Cpe != Other.Cpe || Lfe != Other.Lfe; }
+};
+
+// Elements of each channel_configuration, with 0 they are in a program_config_element()
+static const aac_channels Aac_Configuration_Channels[8] =
+{
+    { 0, 0, 0 },
+    { 1, 0, 0 },
+    { 0, 1, 0 },
+    { 1, 1, 0 },
+    { 2, 1, 0 },
+    { 1, 2, 0 },
+    { 1, 2, 1 },
+    { 1, 3, 1 },
+};
+
+// individual_channel_stream() state needed by the next parts of the element
+struct aac_ics
+{
+    bool            IsShort = false;
+    int8u           Max_Sfb = 0;
+    int8u           Window_Groups = 1;
+    int8u           Window_Group_Length[8] = { 1 };
+    int8u           Sfb_Cb[8][64];                  // Codebook per group and band
+};
+
+// Syntax of a raw_data_block() of an AAC LC frame at 44.1 kHz, nothing is decoded
+class raw_data_block
+{
+public:
+    raw_data_block(const int8u* Buffer, size_t Buffer_Size) : Bits(Buffer, Buffer_Size) {}
+
+    // Channels of the elements, checked against the header or the program_config_element() if any
+    adts_result Parse(int8u Channel_Configuration, size_t& Channels);
+
+private:
+    aac_bits        Bits;
+
+    adts_result     Element_Ics(aac_ics& Ics, bool Common_Window);
+    adts_result     Element_Cpe();
+    adts_result     Element_Cce();
+    void            Element_Dse();
+    void            Element_Pce(aac_channels& Channels);
+    void            Element_Fil();
+    adts_result     Ics_Info(aac_ics& Ics);
+    adts_result     Section_Data(aac_ics& Ics);
+    adts_result     Scale_Factor_Data(const aac_ics& Ics, int Global_Gain);
+    adts_result     Pulse_Data(const aac_ics& Ics);
+    adts_result     Tns_Data(const aac_ics& Ics);
+    adts_result     Spectral_Data(const aac_ics& Ics);
+};
+
+//---------------------------------------------------------------------------
+adts_result raw_data_block::Parse(int8u Channel_Configuration, size_t& Channels)
+{
+    aac_channels Elements;
+    aac_channels Pce;
+    auto HasPce = false;
+    for (;;)
+    {
+        auto Element = (aac_element)Bits.Get(3);
+        if (Element == Aac_Element_END)
+            break;
+        adts_result Result = Adts_Valid;
+        switch (Element)
+        {
+            case Aac_Element_SCE:
+            case Aac_Element_LFE:
+            {
+                Bits.Skip(4); // element_instance_tag
+                aac_ics Ics;
+                Result = Element_Ics(Ics, false);
+                (Element == Aac_Element_SCE ? Elements.Sce : Elements.Lfe)++;
+                break;
+            }
+            case Aac_Element_CPE:
+                Result = Element_Cpe();
+                Elements.Cpe++;
+                break;
+            case Aac_Element_CCE:
+                Result = Element_Cce();
+                break;
+            case Aac_Element_DSE:
+                Element_Dse();
+                break;
+            case Aac_Element_PCE:
+                Element_Pce(Pce);
+                HasPce = true;
+                break;
+            default:
+                Element_Fil();
+        }
+        if (Result)
+            return Result;
+        if (Bits.Overrun())
+            return Adts_Errors;
+    }
+    Bits.Align();
+    if (!Bits.End())
+        return Adts_Errors; // frame_length is the size of the raw_data_block, encoders pad with fill elements
+
+    // Elements must be the ones of the channel_configuration, or of the program_config_element with channel_configuration 0
+    // Without both, frames following the one with the program_config_element, the elements are the channels
+    if (Channel_Configuration)
+    {
+        if (Elements != Aac_Configuration_Channels[Channel_Configuration & 7])
+            return Adts_Errors;
+    }
+    else if (HasPce && Elements != Pce)
+        return Adts_Errors;
+    Channels = Elements.Count();
+    return Adts_Valid;
+}
+
+//---------------------------------------------------------------------------
+adts_result raw_data_block::Element_Ics(aac_ics& Ics, bool Common_Window)
+{
+    auto Global_Gain = (int)Bits.Get(8);
+    if (!Common_Window)
+        if (auto Result = Ics_Info(Ics))
+            return Result;
+    if (auto Result = Section_Data(Ics))
+        return Result;
+    if (auto Result = Scale_Factor_Data(Ics, Global_Gain))
+        return Result;
+    if (Bits.Get(1)) // pulse_data_present
+        if (auto Result = Pulse_Data(Ics))
+            return Result;
+    if (Bits.Get(1)) // tns_data_present
+        if (auto Result = Tns_Data(Ics))
+            return Result;
+    if (Bits.Get(1)) // gain_control_data_present, not in AAC LC
+        return Adts_GainControl;
+    return Spectral_Data(Ics);
+}
+
+//---------------------------------------------------------------------------
+adts_result raw_data_block::Element_Cpe()
+{
+    Bits.Skip(4); // element_instance_tag
+    aac_ics Ics[2];
+    auto Common_Window = Bits.Get(1) != 0;
+    if (Common_Window)
+    {
+        if (auto Result = Ics_Info(Ics[0]))
+            return Result;
+        auto Ms_Mask_Present = Bits.Get(2);
+        if (Ms_Mask_Present == 3)
+            return Adts_Errors; // Reserved
+        if (Ms_Mask_Present == 1)
+            Bits.Skip(Ics[0].Window_Groups * Ics[0].Max_Sfb); // ms_used
+        Ics[1] = Ics[0];
+    }
+    for (auto& Item : Ics)
+        if (auto Result = Element_Ics(Item, Common_Window))
+            return Result;
+    return Adts_Valid;
+}
+
+//---------------------------------------------------------------------------
+adts_result raw_data_block::Element_Cce()
+{
+    Bits.Skip(4); // element_instance_tag
+    auto Ind_Sw_Cce = Bits.Get(1) != 0;
+    auto Num_Coupled_Elements = Bits.Get(3);
+    size_t Num_Gain_Element_Lists = 0;
+    for (size_t i = 0; i <= Num_Coupled_Elements; i++)
+    {
+        Num_Gain_Element_Lists++;
+        auto Target_IsCpe = Bits.Get(1) != 0;
+        Bits.Skip(4); // cc_target_tag_select
+        if (Target_IsCpe && Bits.Get(2) == 3) // cc_l and cc_r
+            Num_Gain_Element_Lists++;
+    }
+    Bits.Skip(4); // cc_domain, gain_element_sign, gain_element_scale
+    aac_ics Ics;
+    if (auto Result = Element_Ics(Ics, false))
+        return Result;
+    for (size_t i = 1; i < Num_Gain_Element_Lists; i++)
+    {
+        if (Ind_Sw_Cce || Bits.Get(1)) // common_gain_element_present
+        {
+            if (Aac_Huffman[0].Decode(Bits) < 0)
+                return Adts_Errors;
+            continue;
+        }
+        for (size_t g = 0; g < Ics.Window_Groups; g++)
+            for (size_t Sfb = 0; Sfb < Ics.Max_Sfb; Sfb++)
+                if (Ics.Sfb_Cb[g][Sfb] != Aac_Codebook_Zero && Aac_Huffman[0].Decode(Bits) < 0)
+                    return Adts_Errors;
+    }
+    return Adts_Valid;
+}
+
+//---------------------------------------------------------------------------
+void raw_data_block::Element_Dse()
+{
+    Bits.Skip(4); // element_instance_tag
+    auto Data_Byte_Align = Bits.Get(1) != 0;
+    auto Count = Bits.Get(8);
+    if (Count == 255)
+        Count += Bits.Get(8);
+    if (Data_Byte_Align)
+        Bits.Align();
+    Bits.Skip(Count * 8);
+}
+
+//---------------------------------------------------------------------------
+void raw_data_block::Element_Pce(aac_channels& Channels)
+{
+    Bits.Skip(4 + 2 + 4); // element_instance_tag, object_type, sampling_frequency_index
+    auto Num_Front = Bits.Get(4);
+    auto Num_Side = Bits.Get(4);
+    auto Num_Back = Bits.Get(4);
+    auto Num_Lfe = Bits.Get(2);
+    auto Num_Assoc_Data = Bits.Get(3);
+    auto Num_Valid_Cc = Bits.Get(4);
+    if (Bits.Get(1)) // mono_mixdown_present
+        Bits.Skip(4);
+    if (Bits.Get(1)) // stereo_mixdown_present
+        Bits.Skip(4);
+    if (Bits.Get(1)) // matrix_mixdown_idx_present
+        Bits.Skip(3);
+    Channels = aac_channels();
+    Channels.Lfe = Num_Lfe;
+    for (size_t i = 0; i < Num_Front + Num_Side + Num_Back; i++)
+    {
+        (Bits.Get(1) ? Channels.Cpe : Channels.Sce)++; // is_cpe
+        Bits.Skip(4);
+    }
+    Bits.Skip(Num_Lfe * 4 + Num_Assoc_Data * 4 + Num_Valid_Cc * 5);
+    Bits.Align();
+    Bits.Skip(Bits.Get(8) * 8); // comment_field_data
+}
+
+//---------------------------------------------------------------------------
+void raw_data_block::Element_Fil()
+{
+    auto Count = Bits.Get(4);
+    if (Count == 15)
+        Count += Bits.Get(8) - 1;
+    Bits.Skip(Count * 8);
+}
+
+//---------------------------------------------------------------------------
+adts_result raw_data_block::Ics_Info(aac_ics& Ics)
+{
+    if (Bits.Get(1)) // ics_reserved_bit
+        return Adts_Errors;
+    auto Window_Sequence = Bits.Get(2);
+    Bits.Skip(1); // window_shape
+    Ics.IsShort = Window_Sequence == 2; // EIGHT_SHORT_SEQUENCE
+    if (Ics.IsShort)
+    {
+        Ics.Max_Sfb = (int8u)Bits.Get(4);
+        auto Scale_Factor_Grouping = Bits.Get(7);
+        Ics.Window_Groups = 1;
+        Ics.Window_Group_Length[0] = 1;
+        for (int i = 6; i >= 0; i--)
+        {
+            if (Scale_Factor_Grouping & (1 << i))
+                Ics.Window_Group_Length[Ics.Window_Groups - 1]++;
+            else
+                Ics.Window_Group_Length[Ics.Window_Groups++] = 1;
+        }
+        if (Ics.Max_Sfb > Aac_Swb_Count_Short)
+            return Adts_Errors;
+    }
+    else
+    {
+        Ics.Max_Sfb = (int8u)Bits.Get(6);
+        Ics.Window_Groups = 1;
+        Ics.Window_Group_Length[0] = 1;
+        if (Bits.Get(1)) // predictor_data_present, not in AAC LC
+            return Adts_Errors;
+        if (Ics.Max_Sfb > Aac_Swb_Count_Long)
+            return Adts_Errors;
+    }
+    return Adts_Valid;
+}
+
+//---------------------------------------------------------------------------
+adts_result raw_data_block::Section_Data(aac_ics& Ics)
+{
+    auto Sect_Bits = Ics.IsShort ? 3 : 5;
+    auto Sect_Esc_Val = (int32u)((1 << Sect_Bits) - 1);
+    for (size_t g = 0; g < Ics.Window_Groups; g++)
+    {
+        size_t Sfb = 0;
+        while (Sfb < Ics.Max_Sfb)
+        {
+            auto Sect_Cb = (int8u)Bits.Get(4);
+            if (Sect_Cb == Aac_Codebook_Reserved)
+                return Adts_Errors;
+            size_t Sect_Len = 0;
+            int32u Sect_Len_Incr;
+            do
+            {
+                Sect_Len_Incr = Bits.Get(Sect_Bits);
+                Sect_Len += Sect_Len_Incr;
+                if (Bits.Overrun())
+                    return Adts_Errors;
+            }
+            while (Sect_Len_Incr == Sect_Esc_Val);
+            if (Sfb + Sect_Len > Ics.Max_Sfb)
+                return Adts_Errors;
+            for (auto End = Sfb + Sect_Len; Sfb < End; Sfb++)
+                Ics.Sfb_Cb[g][Sfb] = Sect_Cb;
+            if (Bits.Overrun())
+                return Adts_Errors;
+        }
+    }
+    return Adts_Valid;
+}
+
+//---------------------------------------------------------------------------
+adts_result raw_data_block::Scale_Factor_Data(const aac_ics& Ics, int Global_Gain)
+{
+    auto Noise_Energy = Global_Gain - 90;
+    auto Noise_IsFirst = true;
+    for (size_t g = 0; g < Ics.Window_Groups; g++)
+        for (size_t Sfb = 0; Sfb < Ics.Max_Sfb; Sfb++)
+        {
+            auto Sect_Cb = Ics.Sfb_Cb[g][Sfb];
+            if (Sect_Cb == Aac_Codebook_Zero)
+                continue;
+            if (Sect_Cb == Aac_Codebook_Noise && Noise_IsFirst)
+            {
+                Noise_Energy += (int)Bits.Get(9) - 256; // dpcm_noise_nrg
+                Noise_IsFirst = false;
+                continue;
+            }
+            auto Value = Aac_Huffman[0].Decode(Bits);
+            if (Value < 0)
+                return Adts_Errors;
+            if (Sect_Cb < Aac_Codebook_Noise)
+            {
+                Global_Gain += Value - 60;
+                if (Global_Gain < 0 || Global_Gain > 255)
+                    return Adts_Errors;
+            }
+        }
+    return Bits.Overrun() ? Adts_Errors : Adts_Valid;
+}
+
+//---------------------------------------------------------------------------
+adts_result raw_data_block::Pulse_Data(const aac_ics& Ics)
+{
+    if (Ics.IsShort)
+        return Adts_Errors; // Only with long windows
+    auto Number_Pulse = Bits.Get(2) + 1;
+    auto Pulse_Start_Sfb = Bits.Get(6);
+    if (Pulse_Start_Sfb >= Aac_Swb_Count_Long)
+        return Adts_Errors;
+    size_t Pos = Aac_Swb_Offsets_Long[Pulse_Start_Sfb];
+    for (size_t i = 0; i < Number_Pulse; i++)
+    {
+        Pos += Bits.Get(5); // pulse_offset
+        if (Pos >= Aac_Swb_Offsets_Long[Aac_Swb_Count_Long])
+            return Adts_Errors;
+        Bits.Skip(4); // pulse_amp
+    }
+    return Adts_Valid;
+}
+
+//---------------------------------------------------------------------------
+adts_result raw_data_block::Tns_Data(const aac_ics& Ics)
+{
+    auto Order_Max = Ics.IsShort ? Aac_Tns_Order_Max_Short : Aac_Tns_Order_Max_Long;
+    for (size_t w = 0; w < (Ics.IsShort ? 8 : 1); w++)
+    {
+        auto N_Filt = Bits.Get(Ics.IsShort ? 1 : 2);
+        if (!N_Filt)
+            continue;
+        auto Coef_Res = Bits.Get(1);
+        for (size_t i = 0; i < N_Filt; i++)
+        {
+            Bits.Skip(Ics.IsShort ? 4 : 6); // length
+            auto Order = Bits.Get(Ics.IsShort ? 3 : 5);
+            if (Order > Order_Max)
+                return Adts_Errors;
+            if (!Order)
+                continue;
+            Bits.Skip(1); // direction
+            auto Coef_Compress = Bits.Get(1);
+            Bits.Skip(Order * (3 + Coef_Res - Coef_Compress));
+        }
+    }
+    return Adts_Valid;
+}
+
+//---------------------------------------------------------------------------
+adts_result raw_data_block::Spectral_Data(const aac_ics& Ics)
+{
+    auto Offsets = Ics.IsShort ? Aac_Swb_Offsets_Short : Aac_Swb_Offsets_Long;
+    for (size_t g = 0; g < Ics.Window_Groups; g++)
+        for (size_t Sfb = 0; Sfb < Ics.Max_Sfb; Sfb++)
+        {
+            auto Sect_Cb = Ics.Sfb_Cb[g][Sfb];
+            if (Sect_Cb == Aac_Codebook_Zero || Sect_Cb >= Aac_Codebook_Noise)
+                continue;
+            const auto& Huffman = Aac_Huffman[Sect_Cb];
+            auto Base = Aac_Codebook_Base[Sect_Cb];
+            auto Dimension = Sect_Cb < Aac_Codebook_FirstPair ? 4 : 2;
+            auto IsUnsigned = Aac_Codebook_IsUnsigned[Sect_Cb];
+            size_t Count = Ics.Window_Group_Length[g] * (Offsets[Sfb + 1] - Offsets[Sfb]) / Dimension;
+            for (size_t i = 0; i < Count; i++)
+            {
+                auto Value = Huffman.Decode(Bits);
+                if (Value < 0)
+                    return Adts_Errors;
+                if (!IsUnsigned)
+                    continue;
+
+                // Sign bits of non zero values, then escape sequences
+                int Escapes = 0;
+                for (auto j = 0; j < Dimension; j++)
+                {
+                    auto Digit = Value % Base;
+                    Value /= Base;
+                    if (Digit)
+                        Bits.Skip(1);
+                    if (Digit == 16)
+                        Escapes++;
+                }
+                for (; Escapes; Escapes--)
+                {
+                    size_t Prefix = 0;
+                    while (Bits.Get(1))
+                        if (++Prefix > Aac_Escape_Prefix_Max || Bits.Overrun())
+                            return Adts_Errors;
+                    Bits.Skip(Prefix + 4);
+                }
+            }
+            if (Bits.Overrun())
+                return Adts_Errors;
+        }
+    return Adts_Valid;
+}
+
+//***************************************************************************
+// Constructor/Destructor
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+adts_validator::adts_validator()
+{
+}
+
+//---------------------------------------------------------------------------
+adts_validator::adts_validator(const adts_validator&)
+{
+}
+
+//---------------------------------------------------------------------------
+adts_validator& adts_validator::operator=(const adts_validator&)
+{
+    return *this; // The parser is a cache, not a state, so it is kept
+}
+
+//---------------------------------------------------------------------------
+adts_validator::~adts_validator()
+{
+    delete MI;
+}
+
+//***************************************************************************
+// Check
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+adts_result adts_validator::Header(const int8u* Buffer, size_t Buffer_Size, size_t& Frame_Size)
+{
+    Frame_Size = 0;
+    if (Buffer_Size < 7)
+        return Adts_Sync;
+
+    // syncword to home, then copyright bits (30 bits), frame_length (13 bits), buffer_fullness and number_of_raw_data_blocks_in_frame (13 bits)
+    int32u Sync1 = (((int32u)Buffer[0]) << 22) | (((int32u)Buffer[1]) << 14) | (((int32u)Buffer[2]) << 6) | (Buffer[3] >> 2);
+    int16u Size = (((int16u)(Buffer[3] & 0x03)) << 11) | (((int16u)Buffer[4]) << 3) | (Buffer[5] >> 5);
+    int16u Sync2 = (((int16u)(Buffer[5] & 0x1F)) << 8) | Buffer[6];
+    if ((Sync1 & 0xFFFFFFE3) != 0x3ffc5400 || Sync2 != 0x1ffc)
+        return Adts_Sync;
+    if (!Size)
+        return Adts_Size;
+
+    Frame_Size = Size;
+    return Adts_Valid;
+}
+
+//---------------------------------------------------------------------------
+adts_result adts_validator::Frame(const int8u* Buffer, size_t Buffer_Size, size_t Frame_Size, const String& ChannelCount)
+{
+    if (Frame_Size <= 7 || Buffer_Size <= 7)
+        return Adts_Format; // No raw_data_block
+
+    size_t Channels;
+    raw_data_block Block(Buffer + 7, (Frame_Size < Buffer_Size ? Frame_Size : Buffer_Size) - 7);
+    if (auto Result = Block.Parse((int8u)(((Buffer[2] & 0x01) << 2) | (Buffer[3] >> 6)), Channels))
+        return Result;
+
+    size_t Channels_Expected = 0;
+    for (auto Item : ChannelCount)
+    {
+        if (Item < __T('0') || Item > __T('9'))
+            return Adts_ChannelCount;
+        Channels_Expected = Channels_Expected * 10 + (Item - __T('0'));
+    }
+    if (Channels != Channels_Expected || ChannelCount.empty())
+        return Adts_ChannelCount;
+    return Adts_Valid;
+}
+
+//---------------------------------------------------------------------------
+adts_result adts_validator::Frame_MediaInfo(const int8u* Buffer, size_t Buffer_Size, size_t Frame_Size, const String& ChannelCount)
+{
+    if (!MI)
+    {
+        MI = new MediaInfo;
+        MI->Option(__T("File_ForceParser"), __T("Adts"));
+        MI->Option(__T("File_Macroblocks_Parse"), __T("1")); // Used for parsing AAC frame, -1 means no check at all, 1 full check
+    }
+    else
+        MI->Close();
+
+    MI->Open_Buffer_Init(Frame_Size, 0);
+    MI->Open_Buffer_Continue((MediaInfo_int8u*)Buffer, Frame_Size < Buffer_Size ? Frame_Size : Buffer_Size);
+    MI->Open_Buffer_Finalize();
+
+    if (MI->Get(Stream_Audio, 0, __T("Format")) != __T("AAC"))
+        return Adts_Format;
+    if (!MI->Get(Stream_Audio, 0, __T("GainControl_Present")).empty())
+        return Adts_GainControl;
+    if (!MI->Get(Stream_Audio, 0, __T("Errors")).empty())
+        return Adts_Errors;
+    if (MI->Get(Stream_Audio, 0, __T("Channel(s)")) != ChannelCount)
+        return Adts_ChannelCount;
+    return Adts_Valid;
+}
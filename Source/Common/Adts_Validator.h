@@ -0,0 +1,69 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#pragma once
+#include "Common/Core.h"
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Result
+//***************************************************************************
+
+enum adts_result
+{
+    Adts_Valid,
+    Adts_Sync,              // Fixed header part not the expected one
+    Adts_Size,              // frame_length is 0
+    Adts_Format,            // raw_data_block not detected as AAC
+    Adts_GainControl,       // gain_control_data_present is set
+    Adts_Errors,            // Syntax errors in raw_data_block
+    Adts_ChannelCount,      // Channel count not the expected one
+};
+
+//***************************************************************************
+// Timing
+//***************************************************************************
+
+// Fixed by the header check: AAC LC at 44.1 kHz, 1024 samples per frame
+const int32u Adts_SamplingRate = 44100;
+const int32u Adts_FrameSamples = 1024;
+
+//***************************************************************************
+// Silent frames
+//***************************************************************************
+
+// Replacements of invalid frames, 1 channel and 8 channels (channel_configuration 0 without program_config_element)
+extern const int8u  AdtsSilence_1_Data[];
+extern const size_t AdtsSilence_1_Size;
+extern const int8u  AdtsSilence_8_Data[];
+extern const size_t AdtsSilence_8_Size;
+
+//***************************************************************************
+// Class adts_validator
+//***************************************************************************
+
+class adts_validator
+{
+public:
+    // Constructor/Destructor
+    adts_validator();
+    adts_validator(const adts_validator&);
+    adts_validator& operator=(const adts_validator&);
+    ~adts_validator();
+
+    // Header check, Frame_Size is set to frame_length (may be more than Buffer_Size)
+    adts_result Header(const int8u* Buffer, size_t Buffer_Size, size_t& Frame_Size);
+
+    // raw_data_block check, syntax only without decoding
+    adts_result Frame(const int8u* Buffer, size_t Buffer_Size, size_t Frame_Size, const String& ChannelCount);
+
+    // Same check by a MediaInfo parser kept between frames, slow, the reference for the native one
+    adts_result Frame_MediaInfo(const int8u* Buffer, size_t Buffer_Size, size_t Frame_Size, const String& ChannelCount);
+
+private:
+    MediaInfo* MI = nullptr;
+};
@@ -6,6 +6,24 @@
 
 //---------------------------------------------------------------------------
 #include "Common/Core.h"
+#include "Common/Adts_Validator.h"
+#include "Common/Damage_Map.h"
+#include "Common/Es_Writer.h"
+#include "Common/File_Publish.h"
+#include "Common/Job_Journal.h"
+#include "Common/Mapped_File.h"
+#include "Common/Metrics.h"
+#include "Common/Matroska_Writer.h"
+#include "Common/Pattern_Scanner.h"
+#include "Common/Platform.h"
+#include "Common/Probe_Index.h"
+#include "Common/Progress.h"
+#include "Common/Process_Runner.h"
+#include "Common/Scheduler.h"
+#include "Common/Temp_Staging.h"
+#include "Common/Template_Engine.h"
+#include "Common/Trace.h"
+#include "Common/Work_Coordinator.h"
 #include "ZenLib/Ztring.h"
 #include "ZenLib/Dir.h"
 #include "ZenLib/FileName.h"
@@ -13,71 +31,304 @@ using namespace ZenLib;
 using namespace std;
 #include "ZenLib/ZtringListList.h"
 #include "ZenLib/File.h"
-#include "ZenLib/BitStream.h"
-#include "Windows.h"
 #include "cstdlib"
+#include <algorithm>
+#include <bitset>
+#include <chrono>
 #include <map>
+#include <condition_variable>
+#include <deque>
+#include <memory>
 #include <mutex>
 #include <future>
+#include <atomic>
+#include <sstream>
+#ifndef _WIN32
+    #define __stdcall // Calling convention of MediaInfo callbacks, Windows only
+#endif
 //---------------------------------------------------------------------------
 
 //***************************************************************************
 // Convert
 //***************************************************************************
 
-struct data_per_thread
+// Everything about one file, it goes from a stage to the next one
+struct data_per_job
 {
-    size_t ID = 0;
     Core* C = nullptr;
-    File F[2];
+    all* Data = nullptr; // Session of the job
+    progress_slot* Slot = nullptr; // Thread of the current stage
+    size_t FilePos = 0;
+    String Input;
+    String Dest;
+    String ExePath;
+    String TempNamePrefix; // Including the file position
+    String Demuxed_TempNamePrefix; // Streams demuxed by the first pass, if second pass
+    es_writer F[2];
     bool IsChecking = false;
-    String TempNamePrefix;
     String ChannelCount;
-    vector<size_t> Stats_InvalidAudioPackets;
-    vector<size_t> Stats_InvalidAacPackets;
+    damage_map Stats_InvalidAudioPackets;
+    damage_map Stats_InvalidAacPackets;
     size_t Stats_AacPacketPos = 0;
     size_t Stats_JunkBytes = 0;
     size_t Stats_AudioPacketInvalidSize = 0;
     bool FullCheck = false;
+    adts_validator AdtsValidator;
+    mkv_video Video;
+    shared_ptr<MediaInfo> MI;
+    vector<size_t> AudioSizes; // Demuxed audio packets, in the raw audio file
+    job_state State = JobState_Max; // Last state written in the journal
+    bool Resumed = false; // Output of an interrupted run, it is only verified
+    int64u Staging_Size = 0; // Reserved in the memory budget for temporary files
+    int64u Temp_Size = 0; // Estimated size of temporary files
+    chrono::steady_clock::duration Trace_FrameTime{}; // Time spent in demux callbacks, only if traced
+    int64u Demux_Packets[2] = {}; // Per stream, added to the metrics once the file is demuxed
+    int64u Demux_Bytes[2] = {};
+
+    // Results of a stage used by next stages
+    int64u Input_Size = 0;
+    probe_result Probe;
+    bool HasVideo = false;
+    bool HasAudio = false;
+    vector<string> WarningMessages;
+    template_values Values;
+    bool Mux_HasCounts = false; // Counts reported by the mux stage, the output is parsed again if not available
+    int64u Mux_Duration = 0;
+    int64u Mux_FrameCounts[2] = {};
+
+    // Demux results are kept, only audio is checked again
+    void Reset_FullCheck()
+    {
+        auto Previous = std::move(*this);
+        *this = data_per_job();
+        C = Previous.C;
+        Data = Previous.Data;
+        FilePos = Previous.FilePos;
+        Input = std::move(Previous.Input);
+        Dest = std::move(Previous.Dest);
+        ExePath = std::move(Previous.ExePath);
+        TempNamePrefix = Previous.TempNamePrefix + __T('f');
+        Demuxed_TempNamePrefix = std::move(Previous.TempNamePrefix);
+        FullCheck = true;
+        ChannelCount = std::move(Previous.ChannelCount); // Replayed frames are checked before Convert_Check() sets it again
+        MI = std::move(Previous.MI);
+        AudioSizes = std::move(Previous.AudioSizes);
+        Video = std::move(Previous.Video);
+        Stats_JunkBytes = Previous.Stats_JunkBytes;
+        Input_Size = Previous.Input_Size;
+        State = Previous.State;
+        Staging_Size = Previous.Staging_Size;
+        Temp_Size = Previous.Temp_Size;
+    }
+
+    // The input is demuxed again, e.g. in another temporary path
+    void Reset_Demux()
+    {
+        MI.reset();
+        Video = mkv_video();
+        AudioSizes.clear();
+        Stats_InvalidAudioPackets = damage_map();
+        Stats_InvalidAacPackets = damage_map();
+        Stats_AacPacketPos = 0;
+        Stats_AudioPacketInvalidSize = 0;
+        Stats_JunkBytes = 0;
+        Trace_FrameTime = {};
+        Demux_Packets[0] = Demux_Packets[1] = 0;
+        Demux_Bytes[0] = Demux_Bytes[1] = 0;
+    }
+
+    // Helpers
+    process CreateProcess_FromTemplate(const text_template& Template, vector<string> const& ErrorPatterns);
+    bool CheckForErrors(process const& Process, String const& LogFileSuffix);
+    void DeleteDemuxed();
+    void DeleteEncoded();
+};
+
+//---------------------------------------------------------------------------
+// Interval between two requests to the coordinator when other workers have the remaining files
+static const chrono::milliseconds Worker_Wait(1000);
+
+//---------------------------------------------------------------------------
+// Jobs waiting for a stage, producers wait if it is full
+class job_queue
+{
+public:
+    void SetMax(size_t NewMax)
+    {
+        Max = NewMax;
+    }
+    void Push(unique_ptr<data_per_job> Job, bool Force = false) // Force is for jobs going back to a previous stage, avoiding a dead lock
+    {
+        unique_lock<mutex> Lock(Mutex);
+        CanPush.wait(Lock, [&] { return Force || IsClosed || Items.size() < Max; });
+        Items.push_back(std::move(Job));
+        CanPop.notify_one();
+    }
+    unique_ptr<data_per_job> Pop(bool Wait = true) // nullptr if closed, or if empty and no wait
+    {
+        unique_lock<mutex> Lock(Mutex);
+        if (Wait)
+            CanPop.wait(Lock, [&] { return IsClosed || !Items.empty(); });
+        return Pop_Locked();
+    }
+    unique_ptr<data_per_job> Pop(chrono::milliseconds Timeout) // nullptr if closed, or if still empty after the timeout
+    {
+        unique_lock<mutex> Lock(Mutex);
+        CanPop.wait_for(Lock, Timeout, [&] { return IsClosed || !Items.empty(); });
+        return Pop_Locked();
+    }
+    void Close()
+    {
+        const lock_guard<mutex> Lock(Mutex);
+        IsClosed = true;
+        CanPush.notify_all();
+        CanPop.notify_all();
+    }
 
-    void Reset(size_t NewID, Core* NewC, String NewTempNamePrefix, String NewChannelCount = String())
+private:
+    unique_ptr<data_per_job> Pop_Locked()
     {
-        *this = data_per_thread();
-        ID = NewID;
-        C = NewC;
-        TempNamePrefix = NewTempNamePrefix;
-        ChannelCount = NewChannelCount;
+        if (Items.empty())
+            return nullptr;
+        auto Job = std::move(Items.front());
+        Items.pop_front();
+        CanPush.notify_one();
+        return Job;
     }
+
+    deque<unique_ptr<data_per_job>> Items;
+    size_t Max = 1;
+    bool IsClosed = false;
+    mutex Mutex;
+    condition_variable CanPush;
+    condition_variable CanPop;
 };
 
 struct all
 {
-    vector<data_per_thread> ThreadDatas;
+    all()
+    {
+        Progress.FileName = [this](size_t Pos) { return FileName(Pos); };
+    }
+
+    job_queue Queues[Stage_Max];
     Core* C = nullptr;
+    scheduler Scheduler;
+    probe_index Index;
+    job_journal Journal;
+    temp_staging Staging;
+    trace Trace;
+    metrics Metrics;
+    progress Progress;
+    work_client Worker; // Files are given by a coordinator if connected
+    String TempNamePrefix;
+    String TempNamePrefix_Memory;
+
+    // Templates, compiled once
+    text_template Template_Decode;
+    text_template Template_Decode_Stream;
+    text_template Template_Encode;
+    text_template Template_Encode_Stream;
+    text_template Template_Mux_Tags;
+    mkvmerge_command Template_Mux_Command;
+
+    vector<future<int>> Threads;
 
     void AddFileName(const String& FileName)
     {
         NsvFileNames.push_back(FileName);
     }
-    String& FileName(size_t Pos)
+    String FileName(size_t Pos) // Files may be added by another thread
     {
-        if (i >= NsvFileNames.size())
+        const lock_guard<mutex> lock(Mutex);
+        if (NsvFileNames.empty())
+            return String();
+        if (Pos >= NsvFileNames.size())
             Pos = NsvFileNames.size() - 1;
         return NsvFileNames[Pos];
     }
-    String& CurrentFileName()
+    const vector<size_t>& Schedule()
     {
-        return FileName(i);
+        Order = Scheduler.Order(vector<Ztring>(NsvFileNames.begin(), NsvFileNames.end()));
+        return Order;
     }
-    size_t NextFileNamePos()
+    unique_ptr<data_per_job> NextJob()
+    {
+        // Second passes first, their demux results are already in memory
+        if (auto Job = Queues[Stage_Demux].Pop(false))
+            return Job;
+
+        size_t FilePos;
+        for (;;)
+        {
+            auto Answer = NextFilePos(FilePos);
+            if (Answer == WorkAnswer_File)
+            {
+                auto Job = unique_ptr<data_per_job>(new data_per_job);
+                Job->Data = this;
+                Job->FilePos = FilePos;
+                return Job;
+            }
+            if (Answer == WorkAnswer_End)
+                break;
+
+            // Files of other workers may come back, jobs of this process may need a second pass meanwhile
+            if (auto Job = Queues[Stage_Demux].Pop(Worker_Wait))
+                return Job;
+        }
+        {
+            const lock_guard<mutex> lock(Mutex);
+            if (!InFlight && IsExhausted())
+            {
+                Close();
+                return nullptr;
+            }
+        }
+
+        // Other jobs may need a second pass, or files may be added
+        return Queues[Stage_Demux].Pop();
+    }
+    void Add(const String& FileName) // Files given while processing, in the order they come
+    {
+        auto Job = unique_ptr<data_per_job>(new data_per_job);
+        Job->Data = this;
+        {
+            const lock_guard<mutex> lock(Mutex);
+            Job->FilePos = NsvFileNames.size();
+            NsvFileNames.push_back(FileName);
+            InFlight++;
+        }
+        auto Size = File::Size_Get(FileName);
+        Progress.Files_Add(1, Size != (int64u)-1 ? Size : 0);
+        Metrics.Add(Metric_Files);
+        Queues[Stage_Demux].Push(std::move(Job));
+    }
+    void Input_Begin()
+    {
+        const lock_guard<mutex> lock(Mutex);
+        Input_Open = true;
+    }
+    void Input_End()
     {
-        if (i_Next >= NsvFileNames.size())
-            return (size_t)-1;
         const lock_guard<mutex> lock(Mutex);
-        return i_Next++;
+        Input_Open = false;
+        if (!InFlight && IsExhausted())
+            Close();
     }
-    void Finished(const String& Dest, vector<string> ErrorMessages, vector<string> WarningMessages, bool Skipped = false)
+    void JobFinished()
     {
+        const lock_guard<mutex> lock(Mutex);
+        InFlight--;
+        if (!InFlight && IsExhausted())
+            Close();
+    }
+    void Finished(const data_per_job& Job, vector<string> ErrorMessages, vector<string> WarningMessages, bool Skipped = false)
+    {
+        work_result Result;
+        Result.Pos = Job.FilePos;
+        Result.Error = !ErrorMessages.empty();
+        Result.Warning = !WarningMessages.empty();
+        Result.Skipped = Skipped;
         if (!ErrorMessages.empty() || !WarningMessages.empty())
         {
             auto Flatten = [](const string& Intro, const vector<string> Vec)
@@ -91,110 +342,133 @@ struct all
                 return ToReturn;
             };
 
-            Out(Ztring(Dest).To_UTF8() + ';' + Flatten("Error", ErrorMessages) + ';' + Flatten("Warning", WarningMessages));
+            Result.Message = Ztring(Job.Dest).To_UTF8() + ';' + Flatten("Error", ErrorMessages) + ';' + Flatten("Warning", WarningMessages);
         }
 
-        Mutex.lock();
-        i++;
-        if (!ErrorMessages.empty())
-            i_Error++;
-        if (!WarningMessages.empty())
-            i_Warning++;
-        if (Skipped)
-            i_Skipped++;
-        Mutex.unlock();
-        DisplayStatus();
-    }
-    size_t Pos()
-    {
-        return i;
-    }
-    size_t Count()
-    {
-        return NsvFileNames.size();
+        if (Worker.IsConnected())
+            Worker.Finished(Result);
+        Finished(Result, Job.Input_Size != (int64u)-1 ? Job.Input_Size : 0);
+
+        if (C->Finished_CallBack)
+        {
+            file_result File_Result;
+            File_Result.Input = Job.Input;
+            File_Result.Output = Job.Dest;
+            File_Result.ErrorMessages = std::move(ErrorMessages);
+            File_Result.WarningMessages = std::move(WarningMessages);
+            File_Result.Skipped = Skipped;
+            C->Finished_CallBack(File_Result);
+        }
     }
-    size_t ErrorCount()
+    void Finished(const work_result& Result, int64u Bytes) // Also results of workers, if coordinator
     {
-        return i_Error;
+        if (!Result.Message.empty())
+            Progress.Message(Result.Message);
+
+        Progress.Finished(Result.Error, Result.Warning, Result.Skipped, Bytes);
+        Metrics.Add(Metric_Files_Finished);
+        if (Result.Error)
+            Metrics.Add(Metric_Files_Error);
+        if (Result.Warning)
+            Metrics.Add(Metric_Files_Warning);
+        if (Result.Skipped)
+            Metrics.Add(Metric_Files_Skipped);
     }
-    size_t WarningCount()
+    void Progress_Start(bool HasBytes) // Files of the list, with their size for the ETA if they are processed here
     {
-        return i_Warning;
+        Progress.Out = C->Out;
+        Progress.Err = C->Err;
+        int64u Bytes = 0;
+        if (HasBytes)
+        {
+            for (const auto& Name : NsvFileNames)
+            {
+                auto Size = File::Size_Get(Name);
+                if (Size != (int64u)-1)
+                    Bytes += Size;
+            }
+        }
+        Progress.Files_Add(NsvFileNames.size(), Bytes);
+        Progress.Start();
     }
-    size_t SkippedCount()
+    size_t Count()
     {
-        return i_Skipped;
+        const lock_guard<mutex> lock(Mutex);
+        return NsvFileNames.size();
     }
-    void Err(const string& Message, bool CarriageReturn = false)
+    void Delete(const String& Name)
     {
-        if (!C->Err)
+        if (C->KeepTemp)
             return;
-
-        auto ToDisplay = '\r' + Message;
-        ToDisplay.resize(77, ' ');
-        const lock_guard<mutex> lock(ErrMutex);
-        *C->Err << ToDisplay;
-        if (CarriageReturn)
-            *C->Err << '\n';
+        File::Delete(Name);
     }
-    void Out(const string& Message)
-    {
-        if (!C->Out)
-            return;
 
-        string ErrMessage(1, '\r');
-        ErrMessage.resize(77, ' ');
-        ErrMessage += '\r';
+private:
+    vector<String> NsvFileNames;
+    vector<size_t> Order;
 
-        auto ToDisplay = Message + '\n';
-        ErrMutex.lock();
-        *C->Err << ErrMessage;
-        *C->Out << ToDisplay;
-        ErrMutex.unlock();
-        DisplayStatus();
+    void Close()
+    {
+        for (auto& Queue : Queues)
+            Queue.Close();
     }
-    void DisplayStatus()
+    work_answer NextFilePos(size_t& FilePos)
     {
-        auto ShortenedFileName = ZenLib::FileName(CurrentFileName()).Name_Get().To_Local();
-        if (ShortenedFileName.empty())
-            return;
-        if (ShortenedFileName.size() > 35)
+        if (!Worker.IsConnected())
         {
-            ShortenedFileName.erase(15, ShortenedFileName.size() - 30);
-            ShortenedFileName.insert(15, "[...]");
+            const lock_guard<mutex> lock(Mutex);
+            if (i_Next >= Order.size())
+                return WorkAnswer_End;
+            FilePos = Order[i_Next++];
+            InFlight++;
+            return WorkAnswer_File;
         }
 
-        Err("Transcoding " + ShortenedFileName + " (" + to_string(Pos() + 1) + '/' + to_string(Count()) + ")...");
+        auto Answer = Worker.Next(FilePos);
+        const lock_guard<mutex> lock(Mutex);
+        if (Answer == WorkAnswer_File && FilePos >= NsvFileNames.size())
+            Answer = WorkAnswer_End;
+        if (Answer == WorkAnswer_File)
+            InFlight++;
+        if (Answer == WorkAnswer_End)
+            Worker_Exhausted = true;
+        return Answer;
     }
-    void Delete(const String& Name)
+    bool IsExhausted()
     {
-        if (C->KeepTemp)
-            return;
-        File::Delete(Name);
+        if (Input_Open)
+            return false;
+        return Worker.IsConnected() ? Worker_Exhausted : (i_Next >= Order.size());
     }
 
-private:
-    vector<String> NsvFileNames;
-
-    mutex ErrMutex;
     mutex Mutex;
-    size_t i = 0;
     size_t i_Next = 0;
-    size_t i_Error = 0;
-    size_t i_Warning = 0;
-    size_t i_Skipped = 0;
+    size_t InFlight = 0; // Jobs started and not finished
+    bool Worker_Exhausted = false;
+    bool Input_Open = false; // Files may be added
 };
-all Data;
 
 
 //***************************************************************************
 // Callback
 //***************************************************************************
 
+static void Event_Demux(data_per_job& Job, const MediaInfo_Event_Global_Demux_4* FrameData)
+{
+    if (!Job.Data->Trace.Enabled())
+    {
+        Job.C->Frame(Job, FrameData);
+        return;
+    }
+    auto Frame_Start = chrono::steady_clock::now();
+    Job.C->Frame(Job, FrameData);
+    Job.Trace_FrameTime += chrono::steady_clock::now() - Frame_Start;
+}
+
 void __stdcall Event_CallBackFunction(unsigned char* Data_Content, size_t Data_Size, void* UserHandler_Void)
 {
     //Retrieving UserHandler
-    data_per_thread* UserHandler = (data_per_thread*)UserHandler_Void;
+    data_per_job* UserHandler = (data_per_job*)UserHandler_Void;
     struct MediaInfo_Event_Generic* Event_Generic = (struct MediaInfo_Event_Generic*)Data_Content;
     unsigned char                       ParserID;
     unsigned short                      EventID;
@@ -219,433 +493,960 @@ void __stdcall Event_CallBackFunction(unsigned char* Data_Content, size_t Data_S
     case MediaInfo_Parser_Nsv:
         switch (EventID)
         {
-        case MediaInfo_Event_Global_Demux: if (EventVersion == 4 && Data_Size >= sizeof(struct MediaInfo_Event_Global_Demux_4)) UserHandler->C->Frame(UserHandler->ID, (MediaInfo_Event_Global_Demux_4*)Event_Generic); break;
+        case MediaInfo_Event_Global_Demux: if (EventVersion == 4 && Data_Size >= sizeof(struct MediaInfo_Event_Global_Demux_4)) Event_Demux(*UserHandler, (MediaInfo_Event_Global_Demux_4*)Event_Generic); break;
         }
         break;
     }
 }
 
 //***************************************************************************
-// Convert
+// Mux
 //***************************************************************************
 
-void Core::Convert(size_t ID, size_t FilePos, bool FullCheck)
+struct audio_track
+{
+    const char* Language;
+    const char* Name;
+};
+static const audio_track Audio_Tracks[] =
 {
-    Data.DisplayStatus();
+    { "mul", "Multiple" },
+    { "ara", "\xD8\xB9\xD8\xB1\xD8\xA8\xD9\x8A" },
+    { "chi", "\xE4\xB8\xAD\xE5\x9B\xBD\xE8\xAF\xAD\xE8\xA8\xB3" },
+    { "eng", "English" },
+    { "fre", "Fran\xC3\xA7" "ais" },
+    { "rus", "\xD1\x80\xD1\x83\xD1\x81\xD1\x81\xD0\xBA\xD0\xB8\xD0\xB9" },
+    { "spa", "Espa\xC3\xB1" "ol" },
+    { "und", "Spare" },
+};
+static const size_t Audio_Tracks_Size = sizeof(Audio_Tracks) / sizeof(*Audio_Tracks);
 
-    auto& ThreadData = Data.ThreadDatas[ID];
-    ThreadData.Reset(ThreadData.ID, ThreadData.C, ThreadData.TempNamePrefix, ThreadData.ChannelCount);
-    if (FullCheck)
-        ThreadData.FullCheck = true;
-    auto TempNamePrefix = ThreadData.TempNamePrefix + Ztring().From_Number(FilePos);
-    if (ThreadData.FullCheck)
-        TempNamePrefix += 'f';
-    const auto& Input = Data.FileName(FilePos);
+static const pair<template_field, const char*> Tags_Names[] =
+{
+    { Field_DateEncoded,        "DATE_ENCODED" },
+    { Field_Commission,         "Commission" },
+    { Field_Meeting,            "Meeting" },
+    { Field_Room,               "Room" },
+};
 
-    String Dest;
-    if (!MainInDir.empty())
+//---------------------------------------------------------------------------
+// HH:MM:SS.mmm to milliseconds
+static int64u TimeStamp_ms(const Ztring& TimeStamp)
+{
+    int64u ToReturn = 0;
+    int64u Value = 0;
+    int64u Fraction_Scale = 0;
+    for (auto Item : TimeStamp)
     {
-        Dest = OutputDir;
-        ZtringList Temp;
-        Temp.Separator_Set(0, __T("\\"));
-        Temp.Write(Input);
-        for (size_t i = MainInDir.size(); i < Temp.size(); i++)
+        if (Item >= __T('0') && Item <= __T('9'))
+        {
+            Value = Value * 10 + (Item - __T('0'));
+            if (Fraction_Scale)
+                Fraction_Scale *= 10;
+        }
+        else if (Item == __T(':'))
+        {
+            ToReturn = (ToReturn + Value) * 60;
+            Value = 0;
+        }
+        else if (Item == __T('.') && !Fraction_Scale)
         {
-            Dest += __T('\\');
-            Dest += Temp[i];
+            ToReturn = (ToReturn + Value) * 1000;
+            Value = 0;
+            Fraction_Scale = 1;
         }
     }
-    else if (ImputIsDir)
+    if (Fraction_Scale)
+        return ToReturn + Value * 1000 / Fraction_Scale;
+    return (ToReturn + Value) * 1000;
+}
+
+//---------------------------------------------------------------------------
+// JSON values read in place, members and items not needed are skipped
+class json_reader
+{
+public:
+    json_reader(const string& NewJson) : Json(NewJson) {}
+
+    // Member(Key) or Item() reads or skips the value, false on error
+    template<typename T> bool Object(T Member)
     {
-        Dest = Input;
-        Dest.erase(0, Inputs[0].size());
-        auto Dest_Slash = Dest.find_last_of(__T("/\\"));
-        if (Dest_Slash != string::npos)
+        if (!Char('{'))
+            return false;
+        if (Char('}'))
+            return true;
+        do
         {
-            Dest.erase(0, Dest_Slash + 1);
+            string Key;
+            if (!String(Key) || !Char(':') || !Member(Key))
+                return false;
         }
-        Dest.insert(0, OutputDir);
+        while (Char(','));
+        return Char('}');
     }
-    else
+    template<typename T> bool Array(T Item)
     {
-        Dest = Input;
-        auto Dest_Slash = Dest.find_last_of(__T("/\\"));
-        if (Dest_Slash != string::npos)
+        if (!Char('['))
+            return false;
+        if (Char(']'))
+            return true;
+        do
         {
-            Dest.erase(0, Dest_Slash + 1);
+            if (!Item())
+                return false;
         }
-        Dest.insert(0, OutputDir);
+        while (Char(','));
+        return Char(']');
     }
-    Ztring OutSubDir(Dest);
-    OutSubDir.erase(OutSubDir.find_last_of(__T('\\')));
-    Dir::Create(OutSubDir);
-    Dest.resize(Dest.size() - 3);
-    Dest += __T("mkv");
-    if (!Data.C->ForceExistingFiles && File::Exists(Dest))
+    bool String(string& Value)
     {
-        Data.Finished(Dest, {}, {}, true);
-        return;
+        if (!Char('"'))
+            return false;
+        Value.clear();
+        while (Pos < Json.size() && Json[Pos] != '"')
+        {
+            if (Json[Pos] == '\\' && ++Pos == Json.size())
+                return false;
+            Value += Json[Pos++]; // Escaped characters are not decoded, they are not in the keys or values which are read
+        }
+        return Char('"');
+    }
+    bool Number(int64u& Value) // (int64u)-1 if the value is not an integer, an integer in a string is accepted
+    {
+        Space();
+        Value = (int64u)-1;
+        string Digits;
+        if (Pos < Json.size() && Json[Pos] == '"')
+        {
+            if (!String(Digits))
+                return false;
+        }
+        else
+        {
+            auto Begin = Pos;
+            if (!Skip())
+                return false;
+            Digits = Json.substr(Begin, Pos - Begin);
+        }
+        if (!Digits.empty() && Digits.find_first_not_of("0123456789") == string::npos)
+            Value = (int64u)strtoull(Digits.c_str(), nullptr, 10);
+        return true;
+    }
+    bool Skip()
+    {
+        Space();
+        if (Pos >= Json.size())
+            return false;
+        switch (Json[Pos])
+        {
+            case '{': return Object([&](const string&) { return Skip(); });
+            case '[': return Array([&]() { return Skip(); });
+            case '"': { string Value; return String(Value); }
+            default:
+                {
+                    auto End = Json.find_first_of(",:]} \t\r\n", Pos);
+                    if (End == string::npos)
+                        End = Json.size();
+                    if (End == Pos)
+                        return false;
+                    Pos = End; // Number, true, false or null
+                    return true;
+                }
+        }
     }
 
+private:
+    const string& Json;
+    size_t Pos = 0;
 
-    vector<string> WarningMessages;
-    vector<pair<String, String>> EraseBeginEnd;
-    vector<pair<String, String>> Replace;
-
-    auto CreateQuotedTempNamePrefix = [&](string const& CommandPrefix, string const& CommandSuffix)
-    {
-        string Command = "\"\"" + CommandPrefix;
-        auto CommandSuffix_SpacePos = CommandSuffix.find(' ');
-        if (CommandSuffix_SpacePos == string::npos)
-            CommandSuffix_SpacePos = CommandSuffix.size();
-        Command.append(CommandSuffix.c_str(), CommandSuffix_SpacePos);
-        Command += '"';
-        Command.append(CommandSuffix.c_str() + CommandSuffix_SpacePos, CommandSuffix.size() - CommandSuffix_SpacePos);
-        Command += '"';
-        return Command;
+    void Space()
+    {
+        while (Pos < Json.size() && (Json[Pos] == ' ' || Json[Pos] == '\t' || Json[Pos] == '\r' || Json[Pos] == '\n'))
+            Pos++;
+    }
+    bool Char(char Value)
+    {
+        Space();
+        if (Pos >= Json.size() || Json[Pos] != Value)
+            return false;
+        Pos++;
+        return true;
+    }
+};
+
+//---------------------------------------------------------------------------
+// Duration (in ms) and frame counts of video and first audio tracks from mkvmerge identification JSON
+// Duration is in container properties, frame counts come from the track statistics tags
+static bool Mkvmerge_Counts(const string& Json, int64u& Duration, int64u FrameCounts[2])
+{
+    json_reader Reader(Json);
+    Duration = (int64u)-1;
+    bool IsPresent[2] = {};
+    FrameCounts[0] = (int64u)-1;
+    FrameCounts[1] = (int64u)-1;
+
+    auto Container = [&](const string& Key)
+    {
+        if (Key != "properties")
+            return Reader.Skip();
+        return Reader.Object([&](const string& Key)
+        {
+            if (Key == "duration")
+                return Reader.Number(Duration);
+            return Reader.Skip();
+        });
     };
+    auto Track = [&]()
+    {
+        string Type;
+        auto FrameCount = (int64u)-1;
+        auto IsValid = Reader.Object([&](const string& Key)
+        {
+            if (Key == "type")
+                return Reader.String(Type);
+            if (Key != "properties")
+                return Reader.Skip();
+            return Reader.Object([&](const string& Key)
+            {
+                if (Key == "tag_number_of_frames")
+                    return Reader.Number(FrameCount);
+                return Reader.Skip();
+            });
+        });
+        size_t Kind = Type == "video" ? 0 : Type == "audio" ? 1 : 2;
+        if (IsValid && Kind < 2 && !IsPresent[Kind])
+        {
+            IsPresent[Kind] = true;
+            FrameCounts[Kind] = FrameCount;
+        }
+        return IsValid;
+    };
+    auto IsValid = Reader.Object([&](const string& Key)
+    {
+        if (Key == "container")
+            return Reader.Object(Container);
+        if (Key == "tracks")
+            return Reader.Array(Track);
+        return Reader.Skip();
+    });
+    if (!IsValid || Duration == (int64u)-1)
+        return false;
+    Duration /= 1000000;
+
+    for (size_t i = 0; i < 2; i++)
+    {
+        if (!IsPresent[i])
+            FrameCounts[i] = 0;
+        else if (FrameCounts[i] == (int64u)-1)
+            return false;
+    }
+    return true;
+}
+
+//***************************************************************************
+// Processes
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+// Command line to arguments, double quotes group spaces
+static vector<Ztring> Command_Split(const Ztring& Command)
+{
+    vector<Ztring> ToReturn;
+    Ztring Arg;
+    bool IsArg = false;
+    bool IsQuoted = false;
+    for (auto Item : Command)
+    {
+        if (Item == __T('"'))
+        {
+            IsQuoted = !IsQuoted;
+            IsArg = true;
+        }
+        else if (!IsQuoted && (Item == __T(' ') || Item == __T('\t') || Item == __T('\r') || Item == __T('\n')))
+        {
+            if (IsArg)
+                ToReturn.push_back(Arg);
+            Arg.clear();
+            IsArg = false;
+        }
+        else
+        {
+            Arg += Item;
+            IsArg = true;
+        }
+    }
+    if (IsArg)
+        ToReturn.push_back(Arg);
+    return ToReturn;
+}
+
+//***************************************************************************
+// Convert helpers
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+static void File_Write(const Ztring& FileName, const Ztring& Content)
+{
+    File F;
+    F.Open(FileName, File::Access_Write);
+    F.Write(Content);
+    F.Truncate();
+    F.Close();
+}
 
-    map<String, String> TagTemplate;
+//---------------------------------------------------------------------------
+process data_per_job::CreateProcess_FromTemplate(const text_template& Template, vector<string> const& ErrorPatterns)
+{
+    process Process;
+    Process.Args = Command_Split(Template.Render(Values));
+    if (!Process.Args.empty())
+        Process.Args[0] = Platform_ToolPath(ExePath, Process.Args[0]); // Tools are in the same directory as LeaveSD
+    Process.ErrorPatterns = ErrorPatterns;
+    return Process;
+}
 
+//---------------------------------------------------------------------------
+bool data_per_job::CheckForErrors(process const& Process, String const& LogFileSuffix)
+{
+    if (C->KeepTemp)
+    {
+        File Log_F;
+        Log_F.Open(TempNamePrefix + LogFileSuffix, File::Access_Write);
+        Log_F.Write((const int8u*)Process.Log.data(), Process.Log.size());
+        Log_F.Truncate();
+        Log_F.Close();
+    }
+    return !Process.Started || Process.HasError;
+}
 
+//---------------------------------------------------------------------------
+// Demuxed streams are kept until the output is checked, they are reused if a second pass is needed
+void data_per_job::DeleteDemuxed()
+{
+    Data->Delete(TempNamePrefix + __T(".avc"));
+    Data->Delete(TempNamePrefix + __T(".aac"));
+}
 
-    ThreadData.F[0].Open(TempNamePrefix + __T(".avc"), File::Access_Write);
-    ThreadData.F[1].Open(TempNamePrefix + __T(".aac"), File::Access_Write);
+//---------------------------------------------------------------------------
+void data_per_job::DeleteEncoded()
+{
+    for (size_t i = 0; i < Audio_Tracks_Size; i++)
+        Data->Delete(TempNamePrefix + __T('_') + Ztring::ToZtring(i) + __T(".aac"));
+}
 
-    // Demux
-    MediaInfo MI;
-    MI.Option(__T("File_Demux_Unpacketize"), __T("1"));
-    MI.Option(__T("File_Macroblocks_Parse"), __T("-1")); // Used for parsing AAC frame, -1 means no check at all, 1 full check
-    MI.Option(__T("File_Event_CallBackFunction"), __T("CallBack=memory://") + Ztring::ToZtring((size_t)&Event_CallBackFunction) + __T(";UserHandler=memory://") + Ztring::ToZtring((size_t)&ThreadData));
-    MI.Open(Input);
-    ThreadData.F[0].Truncate();
-    ThreadData.F[1].Truncate();
-    ThreadData.F[0].Close();
-    ThreadData.F[1].Close();
-    if (MI.Get(Stream_General, 0, __T("Format")) != __T("NSV"))
+//---------------------------------------------------------------------------
+// Open_Buffer_Continue() returns a bitset with MediaInfoLib and a size_t with MediaInfoDLL, bit 3 is "finalized"
+static bool Buffer_IsFinalized(size_t Status)
+{
+    return (Status & 0x08) != 0;
+}
+template<size_t Size> static bool Buffer_IsFinalized(const bitset<Size>& Status)
+{
+    return Status[3];
+}
+
+//---------------------------------------------------------------------------
+// If mapped, the parser gets large chunks of the file from memory instead of doing its own small reads
+static const size_t Mapped_Chunk_Size = 4 * 1024 * 1024;
+static void MediaInfo_Open(MediaInfo& MI, const String& FileName, bool Mapped)
+{
+    mapped_file Mapped_File;
+    if (!Mapped || !Mapped_File.Open(FileName))
     {
-        Data.Finished(Dest, { "No NSV detected" }, {});
+        MI.Open(FileName);
         return;
     }
-    bool HasVideo;
-    if (!MI.Count_Get(Stream_Video) || MI.Get(Stream_Video, 0, __T("Format_Profile")).empty())
+
+    MI.Option(__T("File_FileName"), FileName);
+    MI.Open_Buffer_Init(Mapped_File.Size, 0);
+    int64u Pos = 0;
+    while (Pos < Mapped_File.Size)
     {
-        WarningMessages.push_back("no video detected");
-        HasVideo = false;
+        auto Chunk_Size = (size_t)min<int64u>(Mapped_Chunk_Size, Mapped_File.Size - Pos);
+        if (Buffer_IsFinalized(MI.Open_Buffer_Continue(Mapped_File.Data + Pos, Chunk_Size)))
+            break;
+        Pos += Chunk_Size;
+
+        // Seek requested by the parser
+        auto GoTo = MI.Open_Buffer_Continue_GoTo_Get();
+        if (GoTo != (int64u)-1)
+        {
+            Pos = GoTo;
+            MI.Open_Buffer_Init(Mapped_File.Size, Pos);
+        }
+    }
+    MI.Open_Buffer_Finalize();
+}
+
+//---------------------------------------------------------------------------
+static probe_result Probe_Get(MediaInfo& MI)
+{
+    probe_result Probe;
+    Probe.Format = MI.Get(Stream_General, 0, __T("Format"));
+    Probe.Video_IsPresent = MI.Count_Get(Stream_Video) != 0;
+    Probe.Video_HasProfile = !MI.Get(Stream_Video, 0, __T("Format_Profile")).empty();
+    Probe.Audio_IsPresent = MI.Count_Get(Stream_Audio) != 0;
+    Probe.Audio_HasVersion = !MI.Get(Stream_Audio, 0, __T("Format_Version")).empty();
+    Probe.Audio_Format = MI.Get(Stream_Audio, 0, __T("Format"));
+    Probe.Audio_Channels = MI.Get(Stream_Audio, 0, __T("Channel(s)"));
+    Probe.Duration = Ztring(MI.Get(Stream_General, 0, __T("Duration"))).To_int64u();
+    Probe.Video_FrameCount = Ztring(MI.Get(Stream_Video, 0, __T("FrameCount"))).To_int64u();
+    Probe.Audio_FrameCount = Ztring(MI.Get(Stream_Audio, 0, __T("FrameCount"))).To_int64u();
+    Probe.Debug_Speakers = MI.Get(Stream_General, 0, __T("Debug_Speakers"));
+    return Probe;
+}
+
+//---------------------------------------------------------------------------
+// Error message if the file is not supported, else stream presence and warnings of the job are set
+static const char* Convert_Check(data_per_job& Job, const probe_result& Probe)
+{
+    if (Probe.Format != __T("NSV"))
+        return "No NSV detected";
+    if (!Probe.Video_IsPresent || !Probe.Video_HasProfile)
+    {
+        Job.WarningMessages.push_back("no video detected");
+        Job.HasVideo = false;
     }
     else
-        HasVideo = true;
-    bool HasAudio;
-    ThreadData.ChannelCount = MI.Get(Stream_Audio, 0, __T("Channel(s)"));
-    if (!MI.Count_Get(Stream_Audio) || MI.Get(Stream_Audio, 0, __T("Format_Version")).empty())
+        Job.HasVideo = true;
+    Job.ChannelCount = Probe.Audio_Channels;
+    if (!Probe.Audio_IsPresent || !Probe.Audio_HasVersion)
     {
-        EraseBeginEnd.push_back({ __T(",\r\n\"--default-track-flag\","), __T("_7.aac\"") });
-        WarningMessages.push_back("no audio detected");
-        HasAudio = false;
+        Job.WarningMessages.push_back("no audio detected");
+        Job.HasAudio = false;
     }
-    else if (ThreadData.ChannelCount == __T("1"))
+    else if (Job.ChannelCount == __T("1"))
     {
-        WarningMessages.push_back("1-ch audio detected");
-        HasAudio = true;
+        Job.WarningMessages.push_back("1-ch audio detected");
+        Job.HasAudio = true;
     }
-    else if (ThreadData.ChannelCount.empty() || ThreadData.ChannelCount == __T("8"))
+    else if (Job.ChannelCount.empty() || Job.ChannelCount == __T("8"))
     {
-        if (ThreadData.ChannelCount.empty())
-            ThreadData.ChannelCount = __T("8"); // In practice files we got have a channel_configuration of 0 and in practice they have 8 channels
-        HasAudio = true;
+        if (Job.ChannelCount.empty())
+            Job.ChannelCount = __T("8"); // In practice files we got have a channel_configuration of 0 and in practice they have 8 channels
+        Job.HasAudio = true;
     }
     else
-    {
-        Data.Finished(Dest, { "Audio channel count not supported" }, {});
+        return "Audio channel count not supported";
+    if (Job.HasAudio && Probe.Audio_Format != __T("AAC"))
+        return "Only AAC audio is supported";
+    return nullptr;
+}
+
+//---------------------------------------------------------------------------
+// Maximum size of temporary files of a job: demuxed streams, output, encoded audio and decoded audio if not streamed
+int64u Core::Temp_Estimate(int64u Input_Size, int64u Duration)
+{
+    auto Estimate = Input_Size * 2 + Duration * 64; // 8 encoded tracks at 64 kb/s
+    if (!Streaming)
+        Estimate += Duration * 48 * 2 * 8; // 48 kHz, 16-bit, 8 channels
+    return Estimate;
+}
+
+//---------------------------------------------------------------------------
+static void Journal_Set(data_per_job& Job, job_state State)
+{
+    Job.Data->Journal.Set(Job.Input, State);
+    Job.State = State;
+}
+
+//---------------------------------------------------------------------------
+// Audio packets damaged in the input, next to the output file, written only if there is a damage
+static void Damage_Report_Write(const data_per_job& Job)
+{
+    auto FileName = Job.Dest.substr(0, Job.Dest.size() - 4) + __T("_damage.txt");
+    File::Delete(FileName); // From a previous run
+    if (!Job.Stats_InvalidAudioPackets.Count() && !Job.Stats_InvalidAacPackets.Count())
         return;
-    }
-    if (HasAudio && MI.Get(Stream_Audio, 0, __T("Format")) != __T("AAC"))
-    {
-        Data.Finished(Dest, { "Only AAC audio is supported" }, {});
+
+    string Content("Damage\tFirst packet\tLast packet\tCount\tBegin\tEnd\n");
+    Job.Stats_InvalidAudioPackets.Report(Content, "Skipped", (int64u)Adts_FrameSamples * 1000, Adts_SamplingRate);
+    Job.Stats_InvalidAacPackets.Report(Content, "Replaced", (int64u)Adts_FrameSamples * 1000, Adts_SamplingRate);
+    File F;
+    if (!F.Create(FileName))
         return;
-    }
+    F.Write((const int8u*)Content.data(), Content.size());
+}
 
-    // Prepare tags
-    TagTemplate = {
-        {__T("%MEETING%"),      MI.Get(Stream_General, 0, __T("Meeting"))},
-        {__T("%COMMISSION%"),   MI.Get(Stream_General, 0, __T("Commission"))},
-        {__T("%ROOM%"),         MI.Get(Stream_General, 0, __T("Room"))},
-        {__T("%DATE_ENCODED%"), MI.Get(Stream_General, 0, __T("Recorded_Date"))},
-        {__T("%TEMPPATH%"), TempNamePrefix},
-    };
-    auto AdaptTemplate = [&](String const& InFileName, String const& OutFileName = String(), const vector<pair<String, String>>& EraseBeginEnd = {}, const vector<pair<String, String>>& Replace = {})
+//---------------------------------------------------------------------------
+static void Measured(scheduler& Scheduler, stage Stage, int64u Units, chrono::steady_clock::time_point Start)
+{
+    Scheduler.Measured(Stage, Units, chrono::duration<double>(chrono::steady_clock::now() - Start).count());
+}
+
+//***************************************************************************
+// Convert
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+stage_result Core::Convert_Demux(data_per_job& Job)
+{
+    auto& Input = Job.Input;
+    auto& Dest = Job.Dest;
+    if (!Job.FullCheck)
     {
-        File MergeTemplate_Buffer_F;
-        MergeTemplate_Buffer_F.Open(ExePath + InFileName);
-        int8u MergeTemplate_Buffer[10000];
-        auto MergeTemplate_Buffer_Size = MergeTemplate_Buffer_F.Read(MergeTemplate_Buffer, 10000);
-        MergeTemplate_Buffer_F.Close();
-        Ztring MergeTemplate;
-        MergeTemplate.From_UTF8((const char*)MergeTemplate_Buffer, MergeTemplate_Buffer_Size);
+        Job.C = this;
+        Job.ExePath = ExePath;
+        Job.TempNamePrefix = Data->TempNamePrefix + Ztring().From_Number(Job.FilePos);
+        Input = Data->FileName(Job.FilePos);
 
-        for (const auto& Item : EraseBeginEnd)
+        if (!MainInDir.empty())
         {
-            auto EraseBegin_Pos = MergeTemplate.find(Item.first);
-            if (EraseBegin_Pos != string::npos)
+            Dest = OutputDir;
+            ZtringList Temp;
+            Temp.Separator_Set(0, Ztring(1, PathSeparator));
+            Temp.Write(Input);
+            for (size_t i = MainInDir.size(); i < Temp.size(); i++)
             {
-                auto EraseEnd_Pos = MergeTemplate.find(Item.second, EraseBegin_Pos);
-                if (EraseEnd_Pos != string::npos)
-                    MergeTemplate.erase(EraseBegin_Pos, EraseEnd_Pos + Item.second.size() - EraseBegin_Pos);
+                Dest += PathSeparator;
+                Dest += Temp[i];
             }
         }
-
-        for (const auto& Item : Replace)
+        else if (ImputIsDir)
         {
-            auto EraseBegin_Pos = MergeTemplate.find(Item.first);
-            if (EraseBegin_Pos != string::npos)
+            Dest = Input;
+            Dest.erase(0, Inputs[0].size());
+            auto Dest_Slash = Dest.find_last_of(__T("/\\"));
+            if (Dest_Slash != string::npos)
             {
-                MergeTemplate.erase(EraseBegin_Pos, Item.first.size());
-                MergeTemplate.insert(EraseBegin_Pos, Item.second);
+                Dest.erase(0, Dest_Slash + 1);
             }
+            Dest.insert(0, OutputDir + PathSeparator);
         }
-
-        for (const auto& Item : TagTemplate)
-            MergeTemplate.FindAndReplace(Item.first, Item.second, 0, Ztring_Recursive);
-
-        if (OutFileName.size() > 5 && !OutFileName.compare(OutFileName.size() - 5, 5, __T(".json"), 5))
-            MergeTemplate.FindAndReplace(__T("\\"), __T("\\\\"), 0, Ztring_Recursive);
-
-        if (OutFileName.empty())
-            return CreateQuotedTempNamePrefix(ExePathS, MergeTemplate.To_Local());
-        File MergeTemplate_Buffer_F2;
-        MergeTemplate_Buffer_F2.Open(TempNamePrefix + OutFileName, File::Access_Write);
-        MergeTemplate_Buffer_F2.Write(MergeTemplate);
-        MergeTemplate_Buffer_F2.Truncate();
-        MergeTemplate_Buffer_F2.Close();
-        return string();
-    };
-
-    auto CheckForErrors = [&](String const& LogFileSuffix, vector<string> const& MessagesToSearch)
-    {
-        File Decode_Result_Buffer_F;
-        Decode_Result_Buffer_F.Open(TempNamePrefix + LogFileSuffix);
-        int8u Decode_Result_Buffer[100000];
-        auto Decode_Result_Buffer_Size = Decode_Result_Buffer_F.Read(Decode_Result_Buffer, 100000);
-        Decode_Result_Buffer_F.Close();
-        Data.Delete(TempNamePrefix + LogFileSuffix);
-        string Decode_Result((const char*)Decode_Result_Buffer, Decode_Result_Buffer_Size);
-        bool HasErr = false;
-        for (const auto& MessageToSearch : MessagesToSearch)
-        {
-            if (Decode_Result.rfind(MessageToSearch) != string::npos)
-                HasErr = true;
-        }
-        return HasErr;
-    };
-
-    // Decode audio
-    if (HasAudio)
-    {
-        system(AdaptTemplate(__T("LeaveSD_Decode.txt")).c_str());
-        Data.Delete(TempNamePrefix + __T(".aac"));
-        if (CheckForErrors(__T("_log_decode.txt"), { "Error: ", "\nError reading file." }))
+        else
         {
-            Data.Delete(TempNamePrefix + __T(".avc"));
-            Data.Delete(TempNamePrefix + __T(".aif"));
-
-            if (!ThreadData.FullCheck)
+            Dest = Input;
+            auto Dest_Slash = Dest.find_last_of(__T("/\\"));
+            if (Dest_Slash != string::npos)
             {
-                Convert(ID, FilePos, true);
-                return;
+                Dest.erase(0, Dest_Slash + 1);
             }
-
-            Data.Finished(Dest, { "problem during AAC decoding" }, {});
-            return;
+            Dest.insert(0, OutputDir + PathSeparator);
         }
-    }
-
-    // Encode audio
-    if (HasAudio)
-    {
-        EraseBeginEnd.clear();
-        Replace.clear();
-        if (MI.Get(Stream_Audio, 0, __T("Channel(s)")) == __T("1"))
+        Ztring OutSubDir(Dest);
+        OutSubDir.erase(OutSubDir.find_last_of(__T("/\\")));
+        Dir::Create(OutSubDir);
+        Dest.resize(Dest.size() - 3);
+        Dest += __T("mkv");
+        Job.Input_Size = File::Size_Get(Input);
+        Data->Trace.File_Set(Job.FilePos, Input);
+
+        // Interrupted run
+        auto Previous_State = ForceExistingFiles ? JobState_Max : Data->Journal.State_Get(Input);
+        auto Dest_Exists = File::Exists(Dest);
+        if (Previous_State == JobState_Verified && Dest_Exists)
         {
-            EraseBeginEnd.push_back({ __T(" -map_channel 0.0.1"), __T("7.aac\"") });
-            Replace.push_back({ __T("-ac 8"), __T("-ac 2") });
+            Data->Finished(Job, {}, {}, true);
+            return StageResult_Finished;
         }
-        if (LegacyAac)
+        if (Previous_State == JobState_Moved && Dest_Exists && Data->Index.Get(Input, Job.Probe) && !Convert_Check(Job, Job.Probe))
         {
-            Replace.push_back({ __T(" -profile:a aac_he"), String() });
+            Job.Resumed = true;
+            Job.State = JobState_Moved;
+            return StageResult_Next;
         }
-        system(AdaptTemplate(__T("LeaveSD_Encode.txt"), {}, EraseBeginEnd, Replace).c_str());
-        Data.Delete(TempNamePrefix + __T(".aif"));
-        if (CheckForErrors(__T("_log_encode.txt"), { "Conversion failed!" }))
+        if (Previous_State != JobState_Max)
         {
-            Data.Delete(TempNamePrefix + __T(".avc"));
-            Data.Delete(TempNamePrefix + __T("_0.aac"));
-            Data.Delete(TempNamePrefix + __T("_1.aac"));
-            Data.Delete(TempNamePrefix + __T("_2.aac"));
-            Data.Delete(TempNamePrefix + __T("_3.aac"));
-            Data.Delete(TempNamePrefix + __T("_4.aac"));
-            Data.Delete(TempNamePrefix + __T("_5.aac"));
-            Data.Delete(TempNamePrefix + __T("_6.aac"));
-            Data.Delete(TempNamePrefix + __T("_7.aac"));
-
-            Data.Finished(Dest, { "problem during AAC encoding" }, {});
-            return;
+            if (Dest_Exists)
+                File::Delete(Dest); // Not verified
+            File::Delete(File_Publish_TempName(Dest));
         }
+        else if (!ForceExistingFiles && Dest_Exists)
+        {
+            Data->Finished(Job, {}, {}, true);
+            return StageResult_Finished;
+        }
+        Journal_Set(Job, JobState_Queued);
+
+        // Files already known as not supported are not demuxed again
+        probe_result Probe;
+        if (Data->Index.Get(Input, Probe))
+        {
+            if (auto Error = Convert_Check(Job, Probe))
+            {
+                Data->Finished(Job, { Error }, {});
+                return StageResult_Finished;
+            }
+            Job.WarningMessages.clear();
+        }
+
+        // Temporary files in memory if they fit in the budget
+        Job.Temp_Size = Temp_Estimate(Job.Input_Size, Duration_Estimate(Input));
+        if (Data->Staging.Reserve(Job.Temp_Size))
+        {
+            Job.Staging_Size = Job.Temp_Size;
+            Job.TempNamePrefix = Data->TempNamePrefix_Memory + Ztring().From_Number(Job.FilePos);
+        }
+        Data->Metrics.Add(Job.Staging_Size ? Metric_TempBytes_Memory : Metric_TempBytes_Disk, Job.Temp_Size);
     }
+    auto& TempNamePrefix = Job.TempNamePrefix;
 
-    // Prepare chapters
-    EraseBeginEnd.clear();
-    Replace.clear();
-    Ztring Chapters;
-    auto Chapters_Begin = Ztring(MI.Get(Stream_Menu, 0, __T("Chapters_Pos_Begin"))).To_int32u();
-    auto Chapters_End = Ztring(MI.Get(Stream_Menu, 0, __T("Chapters_Pos_End"))).To_int32u();
-    if (Chapters_Begin < Chapters_End)
+    for (;;)
     {
-        Chapters += __T("<?xml version=\"1.0\"?>\r\n<Chapters>\r\n  <EditionEntry>\r\n");
-        bool ChapterIsOpen = false;
-        for (auto i = Chapters_Begin; i < Chapters_End; i++)
+        auto Written = Job.F[1].Open(TempNamePrefix + __T(".aac"), WriteBufferSize, WriteBackground);
+
+        // Demux
+        if (Job.MI)
         {
-            Ztring TimeStamp = MI.Get(Stream_Menu, 0, i, Info_Name);
-            Ztring Value = MI.Get(Stream_Menu, 0, i);
-            bool IsSub = Value.size() > 2 && Value[0] == __T('+') && Value[0] == __T(' ');
-            if (IsSub)
+            // Second pass, the video stream and the demux results of the first pass are reused, raw audio packets are checked again
+            trace_scope Scope(Data->Trace, "Replay", Job.FilePos);
+            auto& Demuxed_TempNamePrefix = Job.Demuxed_TempNamePrefix;
+            auto Replayed = File::Move(Demuxed_TempNamePrefix + __T(".avc"), TempNamePrefix + __T(".avc"));
+            File Demuxed_F;
+            if (Replayed && !Demuxed_F.Open(Demuxed_TempNamePrefix + __T(".aac")))
+                Replayed = false;
+            MediaInfo_Event_Global_Demux_4 FrameData = {};
+            FrameData.StreamIDs[0] = 1;
+            vector<int8u> Content;
+            for (auto Content_Size : Job.AudioSizes)
             {
-                if (!ChapterIsOpen)
+                if (!Replayed)
+                    break;
+                Content.resize(Content_Size);
+                if (Content_Size && Demuxed_F.Read(Content.data(), Content_Size) != Content_Size)
                 {
-                    Chapters += __T("    <ChapterAtom>\r\n");
-                    ChapterIsOpen = true;
+                    Replayed = false;
+                    break;
                 }
-                Chapters += __T("      <ChapterAtom>\r\n");
-                Chapters += __T("        <ChapterTimeStart>") + TimeStamp + __T("</ChapterTimeStart>\r\n");
-                Chapters += __T("        <ChapterDisplay>\r\n");
-                Chapters += __T("          <ChapterString>") + Value.substr(2) + __T("</ChapterString>\r\n");
-                Chapters += __T("          <ChapterLanguage>eng</ChapterLanguage>\r\n");
-                Chapters += __T("        </ChapterDisplay>\r\n");
-                Chapters += __T("      </ChapterAtom>\r\n");
+                FrameData.Content = Content.data();
+                FrameData.Content_Size = Content_Size;
+                Frame(Job, &FrameData);
             }
-            else
+            Demuxed_F.Close();
+            Data->Delete(Demuxed_TempNamePrefix + __T(".aac"));
+
+            // Demux results of the first pass are not usable, the input is fully demuxed again
+            if (!Replayed)
             {
-                if (ChapterIsOpen)
-                    Chapters += __T("    </ChapterAtom>\r\n");
-                else
-                    ChapterIsOpen = true;
-                Chapters += __T("    <ChapterAtom>\r\n");
-                Chapters += __T("      <ChapterTimeStart>") + TimeStamp + __T("</ChapterTimeStart>\r\n");
-                Chapters += __T("      <ChapterDisplay>\r\n");
-                Chapters += __T("        <ChapterString>") + Value + __T("</ChapterString>\r\n");
-                Chapters += __T("        <ChapterLanguage>eng</ChapterLanguage>\r\n");
-                Chapters += __T("      </ChapterDisplay>\r\n");
+                Job.F[1].Close();
+                Job.DeleteDemuxed();
+                Data->Delete(Demuxed_TempNamePrefix + __T(".avc"));
+                Job.Reset_Demux();
+                continue;
             }
         }
-        if (ChapterIsOpen)
+        else
         {
-            Chapters += __T("    </ChapterAtom>\r\n");
+            if (!Job.F[0].Open(TempNamePrefix + __T(".avc"), WriteBufferSize, WriteBackground))
+                Written = false;
+            Job.MI = make_shared<MediaInfo>();
+            Job.MI->Option(__T("File_Demux_Unpacketize"), __T("1"));
+            Job.MI->Option(__T("File_Macroblocks_Parse"), __T("-1")); // Used for parsing AAC frame, -1 means no check at all, 1 full check
+            Job.MI->Option(__T("File_Event_CallBackFunction"), __T("CallBack=memory://") + Ztring::ToZtring((size_t)&Event_CallBackFunction) + __T(";UserHandler=memory://") + Ztring::ToZtring((size_t)&Job));
+            auto Demux_Start = chrono::steady_clock::now();
+            MediaInfo_Open(*Job.MI, Input, MappedInput);
+            Measured(Data->Scheduler, Stage_Demux, Job.Input_Size, Demux_Start);
+            Data->Trace.Add("Parse", Job.FilePos, Demux_Start, "callbacks_us", chrono::duration_cast<chrono::microseconds>(Job.Trace_FrameTime).count());
         }
-        Chapters += __T("  </EditionEntry>\r\n</Chapters>\r\n");
+        if (!Job.F[0].Close())
+            Written = false;
+        if (!Job.F[1].Close())
+            Written = false;
+
+        // Demuxed streams in memory are more than the reserved budget
+        if (Written && Job.Staging_Size && (int64u)File::Size_Get(TempNamePrefix + __T(".avc")) + (int64u)File::Size_Get(TempNamePrefix + __T(".aac")) > Job.Staging_Size)
+            Written = false;
+
+        if (Written)
+            break;
+        Job.DeleteDemuxed();
+        if (!Job.Staging_Size)
+        {
+            Data->Finished(Job, { "can not write demuxed streams in temporary files" }, {});
+            return StageResult_Finished;
+        }
+
+        // Memory staging is full, the demux is done again in the disk temporary path
+        Data->Staging.Release(Job.Staging_Size);
+        Data->Metrics.Sub(Metric_TempBytes_Memory, Job.Temp_Size);
+        Data->Metrics.Add(Metric_TempBytes_Disk, Job.Temp_Size);
+        Job.Staging_Size = 0;
+        TempNamePrefix = Data->TempNamePrefix + Ztring().From_Number(Job.FilePos);
+        if (Job.FullCheck)
+            TempNamePrefix += __T('f');
+        Job.Reset_Demux();
+    }
+    Data->Metrics.Add(Metric_Packets_Video, Job.Demux_Packets[0]);
+    Data->Metrics.Add(Metric_Packets_Audio, Job.Demux_Packets[1]);
+    Data->Metrics.Add(Metric_Bytes_Video, Job.Demux_Bytes[0]);
+    Data->Metrics.Add(Metric_Bytes_Audio, Job.Demux_Bytes[1]);
+    auto& MI = *Job.MI;
+    Job.Probe = Probe_Get(MI);
+    if (!Job.FullCheck)
+        Data->Index.Set(Input, Job.Probe);
+    if (auto Error = Convert_Check(Job, Job.Probe))
+    {
+        Data->Finished(Job, { Error }, {});
+        return StageResult_Finished;
+    }
+
+    // Prepare tags
+    auto& Values = Job.Values;
+    Values = template_values();
+    Values.Fields[Field_Meeting] = MI.Get(Stream_General, 0, __T("Meeting"));
+    Values.Fields[Field_Commission] = MI.Get(Stream_General, 0, __T("Commission"));
+    Values.Fields[Field_Room] = MI.Get(Stream_General, 0, __T("Room"));
+    Values.Fields[Field_DateEncoded] = MI.Get(Stream_General, 0, __T("Recorded_Date"));
+    Values.Fields[Field_TempPath] = TempNamePrefix;
+
+    Journal_Set(Job, JobState_Demuxed);
+    return StageResult_Next;
+}
+
+//---------------------------------------------------------------------------
+stage_result Core::Convert_Audio(data_per_job& Job)
+{
+    if (!Job.HasAudio || Job.Resumed)
+        return StageResult_Next;
+
+    auto& MI = *Job.MI;
+    auto& TempNamePrefix = Job.TempNamePrefix;
+    auto& Values = Job.Values;
+    auto IsMono = MI.Get(Stream_Audio, 0, __T("Channel(s)")) == __T("1");
+    Values.Fields[Field_Channels] = IsMono ? __T("2") : __T("8");
+    Values.Fields[Field_AacProfile] = LegacyAac ? __T("aac_low") : __T("aac_he");
+    Values.Blocks[Block_Languages] = !IsMono;
+
+    // Decode and encode audio
+    auto Audio_Start = chrono::steady_clock::now();
+    vector<process> Processes;
+    if (Streaming)
+    {
+        // Decoder output is piped to the encoder, decoded PCM never goes to disk
+        Processes.push_back(Job.CreateProcess_FromTemplate(Data->Template_Decode_Stream, { "Error: ", "\nError reading file." }));
+        Processes.push_back(Job.CreateProcess_FromTemplate(Data->Template_Encode_Stream, { "Conversion failed!" }));
     }
     else
-        EraseBeginEnd.push_back({ __T(",\r\n\"--chapters\","), __T(".xml\"") });
-    File FI;
-    FI.Open(TempNamePrefix + __T("_mux_chapters.xml"), File::Access_Write);
-    FI.Write(Chapters);
-    FI.Truncate();
-    FI.Close();
+        Processes.push_back(Job.CreateProcess_FromTemplate(Data->Template_Decode, { "Error: ", "\nError reading file." }));
+    {
+        trace_scope Scope(Data->Trace, Streaming ? "Decode+Encode" : "Decode", Job.FilePos);
+        Process_Run(Processes);
+    }
+    if (Job.CheckForErrors(Processes[0], __T("_log_decode.txt")))
+    {
+        if (Job.FullCheck)
+            Job.DeleteDemuxed();
+        if (Streaming)
+            Job.DeleteEncoded();
+        else
+            Data->Delete(TempNamePrefix + __T(".aif"));
 
-    // Mux
-    if (!HasVideo)
+        if (!Job.FullCheck)
+            return StageResult_FullCheck;
+
+        Data->Finished(Job, { "problem during AAC decoding" }, {});
+        return StageResult_Finished;
+    }
+
+    if (!Streaming)
     {
-        EraseBeginEnd.push_back({ __T(",\r\n\"--sync\","), __T(".avc\"") });
+        Processes[0] = Job.CreateProcess_FromTemplate(Data->Template_Encode, { "Conversion failed!" });
+        trace_scope Scope(Data->Trace, "Encode", Job.FilePos);
+        Process_Run(Processes);
+        Data->Delete(TempNamePrefix + __T(".aif"));
     }
-    if (!HasAudio)
+    if (Job.CheckForErrors(Processes.back(), __T("_log_encode.txt")) || Processes.back().ExitCode)
     {
-        EraseBeginEnd.push_back({ __T(",\r\n\"--sync\",\r\n\"0:%DELAY_A%\",\r\n\"--language\",\r\n\"0:mul"), __T("_7.aac\"") });
+        Job.DeleteDemuxed();
+        Job.DeleteEncoded();
+
+        Data->Finished(Job, { "problem during AAC encoding" }, {});
+        return StageResult_Finished;
     }
-    if (MI.Get(Stream_Audio, 0, __T("Channel(s)")) == __T("1"))
+    Measured(Data->Scheduler, Stage_Audio, Ztring(MI.Get(Stream_General, 0, __T("Duration"))).To_int64u(), Audio_Start);
+
+    Journal_Set(Job, JobState_Encoded);
+    return StageResult_Next;
+}
+
+//---------------------------------------------------------------------------
+stage_result Core::Convert_Mux(data_per_job& Job)
+{
+    if (Job.Resumed)
+        return StageResult_Next;
+
+    auto& MI = *Job.MI;
+    auto& TempNamePrefix = Job.TempNamePrefix;
+
+    // Prepare chapters
+    auto& Values = Job.Values;
+    vector<mkv_chapter> ChapterItems;
+    auto Chapters_Begin = Ztring(MI.Get(Stream_Menu, 0, __T("Chapters_Pos_Begin"))).To_int32u();
+    auto Chapters_End = Ztring(MI.Get(Stream_Menu, 0, __T("Chapters_Pos_End"))).To_int32u();
+    for (auto i = Chapters_Begin; i < Chapters_End; i++)
     {
-        EraseBeginEnd.push_back({ __T(",\r\n\"--sync\",\r\n\"0:%DELAY_A%\",\r\n\"--language\",\r\n\"0:ara"), __T("_7.aac\"") });
+        Ztring TimeStamp = MI.Get(Stream_Menu, 0, i, Info_Name);
+        Ztring Value = MI.Get(Stream_Menu, 0, i);
+        bool IsSub = Value.size() > 2 && Value[0] == __T('+') && Value[0] == __T(' ');
+        ChapterItems.push_back({ TimeStamp_ms(TimeStamp), Ztring(IsSub ? Value.substr(2) : Value).To_UTF8(), "eng", IsSub });
     }
-    map<String, String> MuxTemplate;
-    auto Delay = MI.Get(Stream_Audio, 0, __T("Video_Delay"));
+    Values.Blocks[Block_Chapters] = !ChapterItems.empty();
+
+    // Mux
+    Ztring Delay = MI.Get(Stream_Audio, 0, __T("Video_Delay"));
     if (Delay.empty())
         Delay = __T("0"); // TEMP continue;
     if (Delay[0] == __T('-'))
-        MuxTemplate = { {__T("%DELAY_V%"), Delay.substr(1)},  {__T("%DELAY_A%"),  __T("0")} };
+    {
+        Values.Fields[Field_DelayV] = Delay.substr(1);
+        Values.Fields[Field_DelayA] = __T("0");
+    }
     else
-        MuxTemplate = { {__T("%DELAY_V%"),  __T("0")},  {__T("%DELAY_A%"), Delay} };
-    TagTemplate.insert(MuxTemplate.begin(), MuxTemplate.end());
-    AdaptTemplate(__T("LeaveSD_Mux_Command_Template.json"), __T("_mux_command.json"), EraseBeginEnd, Replace);
-    AdaptTemplate(__T("LeaveSD_Mux_Tags_Template.xml"), __T("_mux_tags.xml"));
-
-    Ztring TempNamePrefixSlashes(TempNamePrefix);
-    TempNamePrefixSlashes.FindAndReplace(__T("\\"), __T("/"), 0, Ztring_Recursive);
-    system(Ztring().From_Local(CreateQuotedTempNamePrefix(ExePathS, "mkvmerge \"@" + TempNamePrefixSlashes.To_Local() + "_mux_command.json\" >" + TempNamePrefixSlashes.To_Local() + "_log_mux2.txt")).To_Local().c_str());
-    Data.Delete(TempNamePrefix + __T(".avc"));
-    Data.Delete(TempNamePrefix + __T("_0.aac"));
-    Data.Delete(TempNamePrefix + __T("_1.aac"));
-    Data.Delete(TempNamePrefix + __T("_2.aac"));
-    Data.Delete(TempNamePrefix + __T("_3.aac"));
-    Data.Delete(TempNamePrefix + __T("_4.aac"));
-    Data.Delete(TempNamePrefix + __T("_5.aac"));
-    Data.Delete(TempNamePrefix + __T("_6.aac"));
-    Data.Delete(TempNamePrefix + __T("_7.aac"));
-    Data.Delete(TempNamePrefix + __T("_0.aac"));
-    Data.Delete(TempNamePrefix + __T("_mux_chapters.xml"));
-    Data.Delete(TempNamePrefix + __T("_mux_command.json"));
-    Data.Delete(TempNamePrefix + __T("_mux_tags.xml"));
-    bool Err0 = CheckForErrors(__T("_log_mux.txt"), { "Error: " });
-    bool Err2 = CheckForErrors(__T("_log_mux2.txt"), { "Error: " });
-    if (Err0 || Err2)
-    {
-        Data.Finished(Dest, { "problem during muxing" }, {});
-        return;
+    {
+        Values.Fields[Field_DelayV] = __T("0");
+        Values.Fields[Field_DelayA] = Delay;
     }
+    bool MuxError;
+    auto Mux_Start = chrono::steady_clock::now();
+    if (Mkvmerge)
+    {
+        File_Write(TempNamePrefix + __T("_mux_chapters.xml"), Chapters_Xml(ChapterItems));
 
-    // Move to target
-    auto TempFileName = TempNamePrefix + __T(".mkv");
-    if (!File::Move(TempFileName, Dest))
+        Values.Blocks[Block_Video] = Job.HasVideo;
+        Values.Blocks[Block_Audio] = Job.HasAudio;
+        Values.Blocks[Block_Languages] = MI.Get(Stream_Audio, 0, __T("Channel(s)")) != __T("1");
+        File_Write(TempNamePrefix + __T("_mux_command.json"), Data->Template_Mux_Command.Json(Values));
+        File_Write(TempNamePrefix + __T("_mux_tags.xml"), Data->Template_Mux_Tags.Render(Values));
+
+        vector<process> Processes(1);
+        Processes[0].Args = { Platform_ToolPath(ExePath, __T("mkvmerge")), __T('@') + TempNamePrefix + __T("_mux_command.json") };
+        Processes[0].ErrorPatterns = { "Error: " };
+        {
+            trace_scope Scope(Data->Trace, "mkvmerge", Job.FilePos);
+            Process_Run(Processes);
+        }
+        Data->Delete(TempNamePrefix + __T("_mux_chapters.xml"));
+        Data->Delete(TempNamePrefix + __T("_mux_command.json"));
+        Data->Delete(TempNamePrefix + __T("_mux_tags.xml"));
+        MuxError = Job.CheckForErrors(Processes[0], __T("_log_mux.txt")) || Processes[0].ExitCode >= 2; // 1 is for warnings
+        if (!MuxError && !VerifyFull)
+        {
+            Processes[0].Args = { Platform_ToolPath(ExePath, __T("mkvmerge")), __T("-J"), TempNamePrefix + __T(".mkv") };
+            Processes[0].ErrorPatterns.clear();
+            Processes[0].KeepOutput = true; // JSON is parsed entirely
+            trace_scope Scope(Data->Trace, "mkvmerge -J", Job.FilePos);
+            Process_Run(Processes);
+            if (Processes[0].Started && !Processes[0].ExitCode)
+                Job.Mux_HasCounts = Mkvmerge_Counts(Processes[0].Output, Job.Mux_Duration, Job.Mux_FrameCounts);
+        }
+    }
+    else
     {
-        if (!File::Copy(TempFileName, Dest))
+        matroska_writer Writer;
+        Writer.App = "LeaveSD v." Program_Version;
+        if (Job.HasVideo)
+        {
+            auto& Video = Job.Video;
+            Video.FileName = TempNamePrefix + __T(".avc");
+            Video.Delay = Values.Fields[Field_DelayV].To_int64s();
+            Video.Width = Ztring(MI.Get(Stream_Video, 0, __T("Width"))).To_int32u();
+            Video.Height = Ztring(MI.Get(Stream_Video, 0, __T("Height"))).To_int32u();
+            auto FrameRate = Ztring(MI.Get(Stream_Video, 0, __T("FrameRate"))).To_float64();
+            if (FrameRate)
+                Video.FrameDuration = (int64u)(1000000000 / FrameRate);
+            Video.Language = "und";
+            Writer.Video = &Video;
+        }
+        if (Job.HasAudio)
         {
-            if (!Data.C->ForceExistingFiles)
+            size_t Audio_Count = MI.Get(Stream_Audio, 0, __T("Channel(s)")) == __T("1") ? 1 : Audio_Tracks_Size;
+            for (size_t i = 0; i < Audio_Count; i++)
             {
-                Data.Delete(TempFileName);
-                Data.Finished(Dest, { "can not move temp file to output location" }, {});
-                return;
-            }
-            if (!File::Delete(Dest))
-            {
-                if (File::Exists(Dest))
-                {
-                    Data.Delete(TempFileName);
-                    Data.Finished(Dest, { "can not delete already existing output file" }, {});
-                    return;
-                }
-            }
-            if (!File::Move(TempFileName, Dest))
-            {
-                if (!File::Copy(TempFileName, Dest))
-                {
-                    Data.Delete(TempFileName);
-                    Data.Finished(Dest, { "can not move temp file to output location" }, {});
-                    return;
-                }
+                mkv_audio Audio;
+                Audio.FileName = TempNamePrefix + __T('_') + Ztring::ToZtring(i) + __T(".aac");
+                Audio.Delay = Values.Fields[Field_DelayA].To_int64s();
+                Audio.Sbr = !LegacyAac;
+                Audio.Default = !i;
+                Audio.Original = !i;
+                Audio.Language = Audio_Tracks[i].Language;
+                Audio.Name = Audio_Tracks[i].Name;
+                Writer.Audios.push_back(Audio);
             }
         }
-        else
-            Data.Delete(TempFileName);
+        Writer.Chapters = ChapterItems;
+        for (const auto& Item : Tags_Names)
+            Writer.Tags.push_back({ Item.second, Values.Fields[Item.first].To_UTF8() });
+        MuxError = !Writer.Write(TempNamePrefix + __T(".mkv"));
+        Job.Mux_HasCounts = true;
+        Job.Mux_Duration = Writer.Duration;
+        Job.Mux_FrameCounts[0] = Writer.Video_FrameCount;
+        Job.Mux_FrameCounts[1] = Writer.Audio_FrameCounts.empty() ? 0 : Writer.Audio_FrameCounts[0];
+    }
+    if (!MuxError)
+        Measured(Data->Scheduler, Stage_Mux, Job.Input_Size, Mux_Start);
+    if (Job.FullCheck)
+        Job.DeleteDemuxed();
+    Job.DeleteEncoded();
+    if (MuxError)
+    {
+        Job.DeleteDemuxed();
+        Data->Delete(TempNamePrefix + __T(".mkv"));
+        Data->Finished(Job, { "problem during muxing" }, {});
+        return StageResult_Finished;
+    }
+
+    Journal_Set(Job, JobState_Muxed);
+    return StageResult_Next;
+}
+
+//---------------------------------------------------------------------------
+stage_result Core::Convert_Publish(data_per_job& Job)
+{
+    if (Job.Resumed)
+        return StageResult_Next;
+
+    // Move to target
+    auto& Dest = Job.Dest;
+    auto TempFileName = Job.TempNamePrefix + __T(".mkv");
+    auto Publish_Start = chrono::steady_clock::now();
+    if (!File_Publish(TempFileName, Dest, ForceExistingFiles))
+    {
+        Data->Delete(TempFileName);
+        Job.DeleteDemuxed();
+        Data->Finished(Job, { "can not move temp file to output location" }, {});
+        return StageResult_Finished;
     }
+    Measured(Data->Scheduler, Stage_Publish, Job.Input_Size, Publish_Start);
+
+    Journal_Set(Job, JobState_Moved);
+    return StageResult_Next;
+}
+
+//---------------------------------------------------------------------------
+stage_result Core::Convert_Verify(data_per_job& Job)
+{
+    auto& Dest = Job.Dest;
+    auto TempFileName = Job.TempNamePrefix + __T(".mkv");
 
     // Check
-    ThreadData.IsChecking = true;
     uint64_t PacketCount[2];
     uint64_t PacketCheckingCount[2];
     uint64_t Duration, CheckingDuration;
-    Duration = Ztring(MI.Get(Stream_General, 0, __T("Duration"))).To_int64u();
-    PacketCount[0] = Ztring(MI.Get(Stream_Video, 0, __T("FrameCount"))).To_int64u();
-    PacketCount[1] = Ztring(MI.Get(Stream_Audio, 0, __T("FrameCount"))).To_int64u();
-    MI.Open(Dest);
-    CheckingDuration = Ztring(MI.Get(Stream_General, 0, __T("Duration"))).To_int64u();
-    PacketCheckingCount[0] = Ztring(MI.Get(Stream_Video, 0, __T("FrameCount"))).To_int64u();
-    PacketCheckingCount[1] = Ztring(MI.Get(Stream_Audio, 0, __T("FrameCount"))).To_int64u();
+    Duration = Job.Probe.Duration;
+    PacketCount[0] = Job.Probe.Video_FrameCount;
+    PacketCount[1] = Job.Probe.Audio_FrameCount;
+    if (Job.Mux_HasCounts && !VerifyFull && !(VerifySample && !(Job.FilePos % VerifySample)))
+    {
+        CheckingDuration = Job.Mux_Duration;
+        PacketCheckingCount[0] = Job.Mux_FrameCounts[0];
+        PacketCheckingCount[1] = Job.Mux_FrameCounts[1];
+    }
+    else
+    {
+        // Full parsing of the output, with its own parser so demux results of the input are kept for a possible second pass
+        Job.IsChecking = true;
+        MediaInfo MI_Check;
+        MI_Check.Option(__T("File_Demux_Unpacketize"), __T("1"));
+        MI_Check.Option(__T("File_Macroblocks_Parse"), __T("-1"));
+        MI_Check.Option(__T("File_Event_CallBackFunction"), __T("CallBack=memory://") + Ztring::ToZtring((size_t)&Event_CallBackFunction) + __T(";UserHandler=memory://") + Ztring::ToZtring((size_t)&Job));
+        auto Check_Start = chrono::steady_clock::now();
+        MI_Check.Open(Dest);
+        Measured(Data->Scheduler, Stage_Check, Job.Input_Size, Check_Start);
+        Data->Trace.Add("Parse output", Job.FilePos, Check_Start);
+        CheckingDuration = Ztring(MI_Check.Get(Stream_General, 0, __T("Duration"))).To_int64u();
+        PacketCheckingCount[0] = Ztring(MI_Check.Get(Stream_Video, 0, __T("FrameCount"))).To_int64u();
+        PacketCheckingCount[1] = Ztring(MI_Check.Get(Stream_Audio, 0, __T("FrameCount"))).To_int64u();
+    }
     if (Duration && CheckingDuration)
     {
         uint64_t Ratio = Duration < 20000 ? 10 : 1;
@@ -662,7 +1463,7 @@ void Core::Convert(size_t ID, size_t FilePos, bool FullCheck)
             std::ostringstream out;
             out.precision(Duration < 10000 ? 1 : 0);
             out << std::fixed << ((float)CheckingDuration) / 1000;
-            WarningMessages.push_back("NSV duration not coherent with actual demuxed data (" + in.str() + "s vs " + out.str() + "s)");
+            Job.WarningMessages.push_back("NSV duration not coherent with actual demuxed data (" + in.str() + "s vs " + out.str() + "s)");
         }
     }
     auto WithPercent = [](int64_t Count, size_t Total)
@@ -675,8 +1476,9 @@ void Core::Convert(size_t ID, size_t FilePos, bool FullCheck)
     bool LaunchFullCheck = false;
     if (CheckingDuration == 0 || PacketCheckingCount[0] + PacketCheckingCount[1] == 0)
     {
-        Data.Finished(Dest, { "can not read output file" }, {});
-        return;
+        Job.DeleteDemuxed();
+        Data->Finished(Job, { "can not read output file" }, {});
+        return StageResult_Finished;
     }
     vector<string> ErrorMessages;
     if (PacketCount[0] != PacketCheckingCount[0])
@@ -686,89 +1488,430 @@ void Core::Convert(size_t ID, size_t FilePos, bool FullCheck)
         ErrorMessages.push_back(WithPercent((int64_t)(PacketCount[1] - PacketCheckingCount[1]), PacketCount[1]) + " missing audio packets");
         LaunchFullCheck = true;
     }
-    if (HasAudio)
+    if (Job.HasAudio)
     {
-        if (!ThreadData.Stats_InvalidAudioPackets.empty())
-            WarningMessages.push_back(WithPercent(ThreadData.Stats_InvalidAudioPackets.size(), PacketCount[1]) + " invalid AAC syncs in audio packet (skipped)");
-        if (!ThreadData.Stats_InvalidAacPackets.empty())
-            WarningMessages.push_back(WithPercent(ThreadData.Stats_InvalidAacPackets.size(), PacketCount[1]) + " invalid AAC packets (replaced by silent)");
-        if (ThreadData.Stats_AudioPacketInvalidSize)
-            WarningMessages.push_back(WithPercent(ThreadData.Stats_AudioPacketInvalidSize, PacketCount[1]) + " invalid audio packets (skipped)");
+        if (Job.Stats_InvalidAudioPackets.Count())
+            Job.WarningMessages.push_back(WithPercent(Job.Stats_InvalidAudioPackets.Count(), PacketCount[1]) + " invalid AAC syncs in audio packet (skipped)");
+        if (Job.Stats_InvalidAacPackets.Count())
+            Job.WarningMessages.push_back(WithPercent(Job.Stats_InvalidAacPackets.Count(), PacketCount[1]) + " invalid AAC packets (replaced by silent)");
+        if (Job.Stats_AudioPacketInvalidSize)
+            Job.WarningMessages.push_back(WithPercent(Job.Stats_AudioPacketInvalidSize, PacketCount[1]) + " invalid audio packets (skipped)");
     }
-    if (ThreadData.Stats_JunkBytes)
-        WarningMessages.push_back(to_string(ThreadData.Stats_JunkBytes) + " junk bytes");
+    if (Job.Stats_JunkBytes)
+        Job.WarningMessages.push_back(to_string(Job.Stats_JunkBytes) + " junk bytes");
 
     // Check for second pass and stats
-    if (LaunchFullCheck && !ThreadData.FullCheck)
+    if (LaunchFullCheck && !Job.FullCheck && Job.MI)
     {
-        Data.Delete(Dest);
-        Convert(ID, FilePos , true);
-        return;
+        Data->Delete(Dest);
+        return StageResult_FullCheck;
     }
+    Job.DeleteDemuxed();
 
     if (!ErrorMessages.empty())
     {
-        if (Data.C->KeepTemp)
+        if (KeepTemp)
         {
-            if (!File::Move(Dest, TempFileName))
+            if (!File_Publish(Dest, TempFileName, true))
             {
-                if (!File::Copy(Dest, TempFileName))
-                {
-                    Data.Delete(Dest);
-                    Data.Finished(Dest, { "can not revert move of temp file to output location" }, {});
-                    return;
-                }
+                Data->Delete(Dest);
+                Data->Finished(Job, { "can not revert move of temp file to output location" }, {});
+                return StageResult_Finished;
             }
         }
         else
         {
-            Data.Delete(Dest);
+            Data->Delete(Dest);
         }
     }
 
-    Data.Finished(Dest, ErrorMessages, WarningMessages);
+    if (ErrorMessages.empty())
+    {
+        Journal_Set(Job, JobState_Verified);
+        if (DamageReport)
+            Damage_Report_Write(Job);
+    }
+    Data->Finished(Job, ErrorMessages, Job.WarningMessages);
+    return StageResult_Finished;
 }
 
+
 //***************************************************************************
 // Threads
 //***************************************************************************
 
-int Launch_Thread(size_t ID)
+//---------------------------------------------------------------------------
+// Temporary files of an interrupted run: prefix, file position, 'f' if second pass, then a known suffix
+static void Journal_Cleanup(all& Data)
+{
+    static const Char* Suffixes[] =
+    {
+        __T(".avc"),
+        __T(".aac"),
+        __T(".aif"),
+        __T(".mkv"),
+        __T("_0.aac"),
+        __T("_1.aac"),
+        __T("_2.aac"),
+        __T("_3.aac"),
+        __T("_4.aac"),
+        __T("_5.aac"),
+        __T("_6.aac"),
+        __T("_7.aac"),
+        __T("_mux_chapters.xml"),
+        __T("_mux_command.json"),
+        __T("_mux_tags.xml"),
+        __T("_log_decode.txt"),
+        __T("_log_encode.txt"),
+        __T("_log_mux.txt"),
+    };
+
+    for (const auto& Prefix : Data.Journal.TempNamePrefixes())
+    {
+        auto Prefix_Slash = Prefix.find_last_of(__T("/\\"));
+        if (Prefix_Slash == string::npos)
+            continue;
+        ZtringList TempFiles = Dir::GetAllFileNames(Prefix.substr(0, Prefix_Slash + 1), Dir::Include_Files);
+        for (const auto& TempFile : TempFiles)
+        {
+            if (TempFile.compare(0, Prefix.size(), Prefix))
+                continue;
+            auto Pos = Prefix.size();
+            auto Pos_Begin = Pos;
+            while (Pos < TempFile.size() && TempFile[Pos] >= __T('0') && TempFile[Pos] <= __T('9'))
+                Pos++;
+            if (Pos == Pos_Begin)
+                continue;
+            if (Pos < TempFile.size() && TempFile[Pos] == __T('f'))
+                Pos++;
+            for (const auto& Suffix : Suffixes)
+                if (!TempFile.compare(Pos, string::npos, Suffix))
+                    Data.Delete(TempFile);
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+// A pool of threads per stage, a job goes to the queue of the next stage when a stage is done
+static int Launch_Thread(all& Data, stage Stage, size_t Slot_Pos)
 {
+    auto& Slot = Data.Progress.Slot(Slot_Pos);
+    Slot.Stage.store(Stage, memory_order_relaxed);
+    Data.Trace.Thread_Set(Stage_Name(Stage));
     for (;;)
     {
-        auto const Pos = Data.NextFileNamePos();
-        if (Pos == (size_t)-1)
+        auto Job = Stage == Stage_Demux ? Data.NextJob() : Data.Queues[Stage].Pop();
+        if (!Job)
             return 0;
-        Data.C->Convert(ID, Pos);
+
+        if (Data.C->Stage_CallBack)
+            Data.C->Stage_CallBack(Data.FileName(Job->FilePos), Stage);
+        Slot.FilePos.store(Job->FilePos, memory_order_relaxed);
+        Job->Slot = &Slot;
+        auto Stage_Start = chrono::steady_clock::now();
+        Data.Metrics.Worker_Begin(Stage);
+        stage_result Result;
+        switch (Stage)
+        {
+            case Stage_Demux: Result = Data.C->Convert_Demux(*Job); break;
+            case Stage_Audio: Result = Data.C->Convert_Audio(*Job); break;
+            case Stage_Mux  : Result = Data.C->Convert_Mux(*Job); break;
+            case Stage_Publish: Result = Data.C->Convert_Publish(*Job); break;
+            default         : Result = Data.C->Convert_Verify(*Job);
+        }
+        Data.Trace.Add(Stage_Name(Stage), Job->FilePos, Stage_Start);
+        Data.Metrics.Worker_End(Stage);
+        Slot.FilePos.store((size_t)-1, memory_order_relaxed);
+        Job->Slot = nullptr;
+
+        switch (Result)
+        {
+            case StageResult_Next:
+                Data.Queues[Stage + 1].Push(std::move(Job));
+                break;
+            case StageResult_FullCheck:
+                Job->Reset_FullCheck();
+                Data.Queues[Stage_Demux].Push(std::move(Job), true);
+                break;
+            default:
+                if (Job->State != JobState_Max && Job->State != JobState_Verified)
+                    Data.Journal.Set(Job->Input, JobState_Failed);
+                Data.Staging.Release(Job->Staging_Size);
+                Data.Metrics.Sub(Job->Staging_Size ? Metric_TempBytes_Memory : Metric_TempBytes_Disk, Job->Temp_Size);
+                Data.Metrics.Add(Metric_Aac_InvalidSyncs, Job->Stats_InvalidAudioPackets.Count());
+                Data.Metrics.Add(Metric_Aac_Replaced, Job->Stats_InvalidAacPackets.Count());
+                Data.Metrics.Add(Metric_JunkBytes, Job->Stats_JunkBytes);
+                Job.reset();
+                Data.JobFinished();
+        }
     }
 }
 
 //***************************************************************************
-// Constructor/Destructor
+// Scan
+//***************************************************************************
+
+static const Char* Index_FileName = __T("LeaveSD_Index.txt");
+static const Char* Journal_FileName = __T("LeaveSD_Journal.txt");
+
+//---------------------------------------------------------------------------
+// Issues of a file in the output format, empty if none
+static string Scan_File(probe_index& Index, const String& Input, bool Mapped)
+{
+    probe_result Probe;
+    if (!Index.Get(Input, Probe))
+    {
+        MediaInfo MI;
+        bool Crash = false;
+        try
+        {
+            MediaInfo_Open(MI, Input, Mapped);
+        }
+        catch (...)
+        {
+            Crash = true;
+        }
+        Probe = Probe_Get(MI);
+        Probe.Crash = Crash;
+        Index.Set(Input, Probe);
+    }
+
+    string Issues;
+    if (Probe.Crash)
+    {
+        Issues += ";Crash";
+    }
+    if (Probe.Format != __T("NSV")
+        || (Probe.Video_IsPresent && !Probe.Video_HasProfile)
+        || (Probe.Audio_IsPresent && !Probe.Audio_HasVersion))
+    {
+        Issues += ";No NSV detected";
+    }
+    if (!Probe.Debug_Speakers.empty())
+    {
+        Issues += ";Issue with speakers;" + Probe.Debug_Speakers.To_UTF8();
+    }
+    if (Issues.empty())
+        return Issues;
+    return FileName(Input).Name_Get().To_UTF8() + Issues + '\n';
+}
+
+//---------------------------------------------------------------------------
+// Files are scanned in parallel, issues are displayed in the order of the file list
+size_t Core::Scan_Files(const vector<String>& NsvFileNames)
+{
+    struct scan_result
+    {
+        string Line;
+        bool IsDone = false;
+    };
+    vector<scan_result> Results(NsvFileNames.size());
+    size_t i = 0;
+    size_t i_Next = 0;
+    size_t i_Displayed = 0;
+    size_t i_Bad = 0;
+    i_Max = NsvFileNames.size();
+    mutex Mutex;
+
+    auto Launch_Thread = [&]()
+    {
+        Data->Trace.Thread_Set("Scan");
+        for (;;)
+        {
+            size_t Pos;
+            {
+                const lock_guard<mutex> Lock(Mutex);
+                if (i_Next >= NsvFileNames.size())
+                    return 0;
+                Pos = i_Next++;
+                if (Err)
+                {
+                    auto ShortenedFileName = FileName(NsvFileNames[Pos]).Name_Get().To_Local();
+                    if (ShortenedFileName.size() > 35)
+                    {
+                        ShortenedFileName.erase(15, ShortenedFileName.size()-30);
+                        ShortenedFileName.insert(15, "[...]");
+                    }
+                    i++;
+                    auto ToDisplay = "Scanning file " + ShortenedFileName + " (" + to_string(i) + '/' + to_string(i_Max) + ")...";
+                    ToDisplay.resize(77, ' ');
+                    *Err << '\r' << ToDisplay;
+                }
+            }
+
+            string Line;
+            Data->Trace.File_Set(Pos, NsvFileNames[Pos]);
+            try
+            {
+                trace_scope Scope(Data->Trace, "Probe", Pos);
+                Line = Scan_File(Data->Index, NsvFileNames[Pos], MappedInput);
+            }
+            catch (...)
+            {
+                Line = FileName(NsvFileNames[Pos]).Name_Get().To_UTF8() + ";Crash\n";
+            }
+
+            const lock_guard<mutex> Lock(Mutex);
+            Results[Pos].Line = std::move(Line);
+            Results[Pos].IsDone = true;
+            for (; i_Displayed < Results.size() && Results[i_Displayed].IsDone; i_Displayed++)
+            {
+                auto& Result = Results[i_Displayed];
+                if (Result.Line.empty())
+                    continue;
+                if (Err)
+                    *Err << "\r                                                                               \r";
+                if (Out)
+                    *Out << Result.Line;
+                Result.Line.clear();
+                i_Bad++;
+            }
+        }
+    };
+
+    vector<future<int>> Futures;
+    for (size_t j = 0; j < ThreadCount; j++)
+        Futures.push_back(std::async(std::launch::async, Launch_Thread));
+    for (auto& Future : Futures)
+        Future.get();
+
+    return i_Bad;
+}
+
 //***************************************************************************
+// Coordinator
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+// Path after the main input directory, with "/" as separator
+static string Relative_Path(const ZtringList& MainInDir, const String& FileName)
+{
+    ZtringList Temp;
+    Temp.Separator_Set(0, Ztring(1, PathSeparator));
+    Temp.Write(FileName);
+    string ToReturn;
+    for (size_t i = MainInDir.size(); i < Temp.size(); i++)
+    {
+        if (!ToReturn.empty())
+            ToReturn += '/';
+        ToReturn += Temp[i].To_UTF8();
+    }
+    return ToReturn;
+}
+
+//---------------------------------------------------------------------------
+// Files are given to workers in the order of the scheduler, results are displayed here
+return_value Core::Coordinate(int64u ListHash)
+{
+    Data->Scheduler.HistoryFileName = HistoryFile.empty() ? (Platform_TempPath() + __T("LeaveSD_History.txt")) : HistoryFile;
+    Data->Scheduler.PriorityFileName = PriorityFile;
+    Data->Metrics.FileName = MetricsFile;
+    Data->Metrics.Interval = MetricsInterval;
+    Data->Metrics.Set(Metric_Files, Data->Count());
+    if (!MetricsFile.empty() && !Data->Metrics.Start() && Err)
+        *Err << "Warning: can not create " << Ztring(MetricsFile).To_Local() << ", --metrics is ignored.\n";
+
+    work_coordinator Coordinator;
+    Coordinator.SocketName = CoordinatorSocket;
+    Coordinator.Finished = [this](const work_result& Result)
+    {
+        auto FileName = Data->FileName(Result.Pos);
+        auto Size = File::Size_Get(FileName);
+        if (Size == (int64u)-1)
+            Size = 0;
+        if (!Result.Lost)
+        {
+            Data->Finished(Result, Size);
+            return;
+        }
+        auto Lost = Result;
+        Lost.Message = Ztring(FileName).To_UTF8() + ";Error: workers stopped during its processing;";
+        Data->Finished(Lost, Size);
+    };
+    Coordinator.Warning = [this](const string& Message)
+    {
+        Data->Progress.Message("Warning: " + Message);
+    };
+    if (Err)
+        *Err << "Waiting for workers on " << Ztring(CoordinatorSocket).To_Local() << "...\n";
+    Data->Progress_Start(true);
+    auto IsOk = Coordinator.Run(Data->Schedule(), ListHash);
+    Data->Progress.Stop();
+    Data->Metrics.Stop();
+    if (!IsOk)
+    {
+        if (Err)
+            *Err << "\nError: " << Coordinator.ErrorMessage << ".\n";
+        return ReturnValue_ERROR;
+    }
 
+    Data->Progress.Err_Line(Data->Progress.Summary(), true);
+    return Data->Progress.ErrorCount() ? ReturnValue_ERROR : ReturnValue_OK;
+}
 
+//***************************************************************************
+// Constructor/Destructor
+//***************************************************************************
 
 //---------------------------------------------------------------------------
-Core::Core()
+Core::Core() :
+    Data(new all)
 {
+    Data->C = this;
 }
 
 Core::~Core()
 {
+    if (!Data->Threads.empty())
+        Finish(); // Session not finished by the caller
 }
 
 //***************************************************************************
 // Process
 //***************************************************************************
 
+//---------------------------------------------------------------------------
+// Options of all parsers of the process, whatever is the count of sessions
+static void MediaInfo_Init()
+{
+    static once_flag Init_Flag;
+    call_once(Init_Flag, []()
+    {
+        MediaInfo::Option_Static(__T("Demux"), __T("container"));
+        MediaInfo::Option_Static(__T("ParseSpeed"), __T("1"));
+        MediaInfo::Option_Static(__T("ReadByHuman"), __T("0"));
+    });
+}
+
+//---------------------------------------------------------------------------
+// Sessions running in the same process have their own temporary files
+static atomic<size_t> Session_Count(0);
+
+//---------------------------------------------------------------------------
+// Commands of the external tools would be empty without their template
+template<typename T> static bool Template_Load(T& Template, const Ztring& Path, const Char* Name, ostream* Err)
+{
+    if (Template.Load(Path + Name))
+        return true;
+    if (Err)
+        *Err << "\nError: can not read " << Ztring(Path + Name).To_Local() << ", it must be next to LeaveSD.\n";
+    return false;
+}
+
 //---------------------------------------------------------------------------
 return_value Core::Process()
 {
     if (Inputs.empty())
         return ReturnValue_OK;
 
+    if (!ThreadCount)
+    {
+        ThreadCount = Platform_ProcessorCount();
+    }
+
+    if (!TraceFile.empty() && !Data->Trace.Start(TraceFile) && Err)
+        *Err << "Warning: can not create " << Ztring(TraceFile).To_Local() << ", --trace is ignored.\n";
+
     if (Scan)
     {
         vector<String> NsvFileNames;
@@ -785,86 +1928,26 @@ return_value Core::Process()
             }
         }
 
-        size_t i = 0;
-        size_t i_Bad = 0;
-        for (const auto Input : NsvFileNames)
+        // Probe results are kept in the output directory, if any
+        if (IndexFile.empty() && !OutputDir.empty())
+        {
+            if (IsPathSeparator(OutputDir.back()))
+                OutputDir.pop_back();
+            Dir::Create(OutputDir);
+            IndexFile = OutputDir + PathSeparator + Index_FileName;
+        }
+        Data->Index.FileName = IndexFile;
+        auto Index_Unknown = Data->Index.Load();
+        if (!Index_Unknown.empty())
         {
             if (Err)
-            {
-                auto ShortenedFileName = FileName(Input).Name_Get().To_Local();
-                if (ShortenedFileName.size() > 35)
-                {
-                    ShortenedFileName.erase(15, ShortenedFileName.size()-30);
-                    ShortenedFileName.insert(15, "[...]");
-                }
-                auto DisplayInfo = [&](string const& Command)
-                {
-                    if (!Err)
-                        return;
-                    auto ToDisplay = Command + ' ' + ShortenedFileName + " (" + to_string(i) + '/' + to_string(i_Max) + ")...";
-                    ToDisplay.resize(77, ' ');
-                    *Err << '\r' << ToDisplay;
-                };
-
-                i++;
-                DisplayInfo("Scanning file");
-            }
-
-            MediaInfo MI;
-            bool Problem = false;
-            try
-            {
-                MI.Open(Input);
-            }
-            catch (exception e)
-            {
-                if (!Problem)
-                {
-                    if (Err)
-                        *Err << "\r                                                                               \r";
-                    if (Out)
-                        *Out << Ztring(MI.Get(Stream_General, 0, __T("FileName"))).To_UTF8();
-                    Problem = true;
-                }
-                if (Out)
-                    *Out << ";Crash";
-            }
-            if (MI.Get(Stream_General, 0, __T("Format")) != __T("NSV")
-                || (MI.Count_Get(Stream_Video) && MI.Get(Stream_Video, 0, __T("Format_Profile")).empty())
-                || (MI.Count_Get(Stream_Audio) &&  MI.Get(Stream_Audio, 0, __T("Format_Version")).empty()))
-            {
-                if (!Problem)
-                {
-                    if (Err)
-                        *Err << "\r                                                                               \r";
-                    if (Out)
-                        *Out << Ztring(MI.Get(Stream_General, 0, __T("FileName"))).To_UTF8();
-                    Problem = true;
-                }
-                if (Out)
-                    *Out << ";No NSV detected";
-            }
-            auto Debug_Speakers = MI.Get(Stream_General, 0, __T("Debug_Speakers"));
-            if (!Debug_Speakers.empty())
-            {
-                if (!Problem)
-                {
-                    if (Err)
-                        *Err << "\r                                                                               \r";
-                    if (Out)
-                        *Out << Ztring(MI.Get(Stream_General, 0, __T("FileName"))).To_UTF8();
-                    Problem = true;
-                }
-                if (Out)
-                    *Out << ";Issue with speakers;" << Ztring(Debug_Speakers).To_UTF8();
-            }
-            if (Problem)
-            {
-                if (Out)
-                    *Out << "\n";
-                i_Bad++;
-            }
+                *Err << "\n" << Index_Unknown.To_UTF8() << " is not a probe index, please provide another index file name.\n";
+            return ReturnValue_ERROR;
         }
+
+        size_t i_Bad = Scan_Files(NsvFileNames);
+        Data->Index.Save();
+        Data->Trace.Write();
         if (Err)
         {
             *Err << "\r                                                                               \r";
@@ -877,36 +1960,8 @@ return_value Core::Process()
         return i_Bad ? ReturnValue_ERROR : ReturnValue_OK;
     }
 
-    char Path_Buffer[MAX_PATH + 1] = { 0 };
-    auto Path_Buffer_Size = ::GetModuleFileNameA(nullptr, Path_Buffer, MAX_PATH);
-    ExePathS.assign(Path_Buffer, Path_Buffer_Size);
-    auto Path_SlashPos = ExePathS.rfind('\\');
-    if (Path_SlashPos == string::npos)
-        return ReturnValue_ERROR;
-    ExePathS.resize(Path_SlashPos + 1);
-    ExePath = Ztring().From_Local(ExePathS).c_str();
-
-    string TempPathS;
-    if (TempPath.empty())
-    {
-        Path_Buffer_Size = ::GetTempPathA(MAX_PATH, Path_Buffer);
-        TempPathS.assign(Path_Buffer, Path_Buffer_Size);
-        TempPath = Ztring().From_Local(TempPathS);
-    }
-    else
-    {
-        if (TempPath.back() != '/' && TempPath.back() != '\\' && Dir::Exists(TempPath))
-            TempPath += '/';
-        TempPathS = Ztring(TempPath).To_Local();
-    }
-    auto TempNamePrefixS = TempPathS + "temp";
-    String TempNamePrefix = Ztring().From_Local(TempNamePrefixS).c_str();
-
-    MediaInfo::Option_Static(__T("Demux"), __T("container"));
-    MediaInfo::Option_Static(__T("ParseSpeed"), __T("1"));
-    MediaInfo::Option_Static(__T("ReadByHuman"), __T("0"));
-
-    MainInDir.Separator_Set(0, __T("\\"));
+    vector<String> NsvFileNames;
+    MainInDir.Separator_Set(0, Ztring(1, PathSeparator));
     for (const auto& Input : Inputs)
     {
         ZtringList AllFiles = Dir::GetAllFileNames(Input);
@@ -919,7 +1974,7 @@ return_value Core::Process()
                 else
                 {
                     ZtringList Temp;
-                    Temp.Separator_Set(0, __T("\\"));
+                    Temp.Separator_Set(0, Ztring(1, PathSeparator));
                     Temp.Write(FileName);
                     if (MainInDir.size() > Temp.size())
                         MainInDir.resize(Temp.size());
@@ -929,13 +1984,161 @@ return_value Core::Process()
                         Temp.pop_back();
                     }
                 }
-                Data.AddFileName(FileName);
+                NsvFileNames.push_back(FileName);
             }
         }
     }
-    if (Data.Count() == 1 && !MainInDir.empty())
+    if (NsvFileNames.size() == 1 && !MainInDir.empty())
         MainInDir.pop_back(); // if 1 file the last item is the file name
-    if (OutputDir[OutputDir.size() - 1] == __T('\\') || OutputDir[OutputDir.size() - 1] == __T('/'))
+
+    // Shards and workers must have the same list, whatever is the mount point of the input directory
+    vector<string> RelativeNames;
+    for (const auto& FileName : NsvFileNames)
+    {
+        auto RelativeName = Relative_Path(MainInDir, FileName);
+        if (ShardCount > 1 && Work_Shard(RelativeName, ShardCount) != Shard - 1)
+            continue;
+        Data->AddFileName(FileName);
+        RelativeNames.push_back(RelativeName);
+    }
+    auto ListHash = Work_ListHash(RelativeNames);
+    if (!CoordinatorSocket.empty())
+        return Coordinate(ListHash);
+
+    // Files of other processes are in the same output directory, so each process has its own journal and temporary files
+    Ztring Instance;
+    if (ShardCount > 1)
+        Instance += __T('_') + Ztring().From_Number((int64u)Shard) + __T("of") + Ztring().From_Number((int64u)ShardCount);
+    if (!WorkerSocket.empty())
+    {
+        if (!Data->Worker.Connect(WorkerSocket, Data->Count(), ListHash))
+        {
+            if (Err)
+                *Err << "Error: " << Data->Worker.ErrorMessage << ".\n";
+            return ReturnValue_ERROR;
+        }
+        Instance += __T("_w") + Ztring().From_Number((int64u)Data->Worker.Slot);
+    }
+    auto Result = Launch(Instance);
+    if (Result != ReturnValue_OK)
+        return Result;
+    return Finish();
+}
+
+//---------------------------------------------------------------------------
+return_value Core::Start()
+{
+    if (!Data->Threads.empty())
+        return ReturnValue_ERROR; // Already started
+
+    if (!ThreadCount)
+        ThreadCount = Platform_ProcessorCount();
+
+    if (!TraceFile.empty() && !Data->Trace.Start(TraceFile) && Err)
+        *Err << "Warning: can not create " << Ztring(TraceFile).To_Local() << ", --trace is ignored.\n";
+
+    // Output paths are relative to the input directory, if any
+    MainInDir.clear();
+    MainInDir.Separator_Set(0, Ztring(1, PathSeparator));
+    if (!Inputs.empty() && Dir::Exists(Inputs[0]))
+    {
+        Ztring InDir(Inputs[0]);
+        while (!InDir.empty() && IsPathSeparator(InDir.back()))
+            InDir.pop_back();
+        MainInDir.Write(InDir);
+    }
+
+    Data->Input_Begin();
+    auto Result = Launch(Ztring());
+    if (Result != ReturnValue_OK)
+        Data->Input_End();
+    return Result;
+}
+
+//---------------------------------------------------------------------------
+void Core::Add(const String& FileName)
+{
+    if (Data->Threads.empty())
+        return; // Not started, or Start() failed
+    Data->Add(FileName);
+}
+
+//---------------------------------------------------------------------------
+return_value Core::Finish()
+{
+    if (Data->Threads.empty())
+        return ReturnValue_ERROR; // Not started
+
+    Data->Input_End();
+    for (auto& Thread : Data->Threads)
+        Thread.get();
+    Data->Threads.clear();
+    Data->Progress.Stop();
+    Data->Scheduler.Save();
+    Data->Index.Save();
+    Data->Journal.End();
+    Data->Trace.Write();
+    Data->Metrics.Stop();
+
+    if (Data->Worker.IsLost() && Err)
+        *Err << "\nWarning: connection to the coordinator lost, remaining files are not transcoded.\n";
+    Data->Progress.Err_Line(Data->Progress.Summary(), true);
+
+    return Data->Progress.ErrorCount() ? ReturnValue_ERROR : ReturnValue_OK;
+}
+
+//---------------------------------------------------------------------------
+// Setup of the output and temporary files, then threads are launched
+// Instance is not empty if other processes have the same output directory
+return_value Core::Launch(const Ztring& Instance)
+{
+    if (OutputDir.empty())
+        return ReturnValue_ERROR;
+
+    ExePath = Platform_ExePath();
+    if (ExePath.empty())
+        return ReturnValue_ERROR;
+    ExePathS = Ztring(ExePath).To_Local();
+
+    // Templates of the tools used by this session
+    if (Streaming)
+    {
+        if (!Template_Load(Data->Template_Decode_Stream, ExePath, __T("LeaveSD_Decode_Stream.txt"), Err)
+         || !Template_Load(Data->Template_Encode_Stream, ExePath, __T("LeaveSD_Encode_Stream.txt"), Err))
+            return ReturnValue_ERROR;
+    }
+    else
+    {
+        if (!Template_Load(Data->Template_Decode, ExePath, __T("LeaveSD_Decode.txt"), Err)
+         || !Template_Load(Data->Template_Encode, ExePath, __T("LeaveSD_Encode.txt"), Err))
+            return ReturnValue_ERROR;
+    }
+    if (Mkvmerge)
+    {
+        if (!Template_Load(Data->Template_Mux_Command, ExePath, __T("LeaveSD_Mux_Command_Template.json"), Err)
+         || !Template_Load(Data->Template_Mux_Tags, ExePath, __T("LeaveSD_Mux_Tags_Template.xml"), Err))
+            return ReturnValue_ERROR;
+    }
+
+    string TempPathS;
+    if (TempPath.empty())
+        TempPath = Platform_TempPath();
+    else if (!IsPathSeparator(TempPath.back()) && Dir::Exists(TempPath))
+        TempPath += PathSeparator;
+    TempPathS = Ztring(TempPath).To_Local();
+    auto TempNamePrefixS = TempPathS + "temp";
+    String TempNamePrefix = Ztring().From_Local(TempNamePrefixS).c_str();
+
+    MediaInfo_Init();
+
+    // Other sessions of this process, or of a previous process having used the same journal, have other temporary files
+    Ztring TempInstance(Instance);
+    if (auto Session = Session_Count++)
+        TempInstance += __T("_p") + Ztring().From_Number((int64u)Platform_ProcessId()) + __T('s') + Ztring().From_Number((int64u)Session);
+    if (!TempInstance.empty())
+        TempNamePrefix += TempInstance + __T('_');
+
+    if (IsPathSeparator(OutputDir[OutputDir.size() - 1]))
         OutputDir.pop_back();
     if (File::Exists(OutputDir))
     {
@@ -943,10 +2146,21 @@ return_value Core::Process()
             *Err << "\n" << Ztring(OutputDir).To_UTF8() << " is a file, please provide a directory name.\n";
         return ReturnValue_ERROR;
     }
-    if (!SkipExistingFiles && !ForceExistingFiles && (File::Exists(OutputDir) || Dir::Exists(OutputDir + __T('\\'))))
+    Data->Journal.FileName = OutputDir + PathSeparator + Journal_FileName;
+    if (!Instance.empty())
+        Data->Journal.FileName.insert(Data->Journal.FileName.size() - 4, Instance);
+    Data->Journal.Load();
+    if (!SkipExistingFiles && !ForceExistingFiles && Instance.empty() && !Data->Journal.IsInterrupted() && (File::Exists(OutputDir) || Dir::Exists(OutputDir + PathSeparator)))
     {
-        ZtringList AllFiles = Dir::GetAllFileNames(OutputDir + __T('\\'), (Dir::dirlist_t)((int)Dir::Include_Files | (int)Dir::Parse_SubDirs));
-        if (!AllFiles.empty())
+        ZtringList AllFiles = Dir::GetAllFileNames(OutputDir + PathSeparator, (Dir::dirlist_t)((int)Dir::Include_Files | (int)Dir::Parse_SubDirs));
+        size_t AllFiles_Count = 0;
+        for (const auto& Item : AllFiles)
+        {
+            auto Name = FileName(Item).Name_Get() + __T('.') + FileName(Item).Extension_Get();
+            if (Name != Index_FileName && Name != Journal_FileName) // Files of a previous scan or run are accepted
+                AllFiles_Count++;
+        }
+        if (AllFiles_Count)
         {
             if (Err)
                 *Err << "\n" << Ztring(OutputDir).To_UTF8() << " exists, please provide a non existing output directory name.\n";
@@ -954,134 +2168,162 @@ return_value Core::Process()
         }
     }
     Dir::Create(OutputDir);
-    ImputIsDir = Dir::Exists(Inputs[0]);
-    if (ImputIsDir && (Inputs[0][Inputs[0].size() - 1] != '\\' || Inputs[0][Inputs[0].size() - 1] != '/'))
-        Inputs[0] += '\\';
-    Data.C = this;
-    if (!ThreadCount)
+    Data->Index.FileName = IndexFile.empty() ? (OutputDir + PathSeparator + Index_FileName) : IndexFile;
+    if (IndexFile.empty() && !Instance.empty())
     {
-        ::SYSTEM_INFO lpSystemInfo;
-        ::GetSystemInfo(&lpSystemInfo);
-        ThreadCount = lpSystemInfo.dwNumberOfProcessors;
-        if (!ThreadCount)
-            ThreadCount = 1;
+        Data->Index.SharedFileName = Data->Index.FileName; // e.g. written by a previous scan
+        Data->Index.FileName.insert(Data->Index.FileName.size() - 4, Instance); // Rewritten at the end, not shared
     }
-    Data.ThreadDatas.resize(ThreadCount);
-    size_t ID = 0;
-    vector<future<int>> Futures;
-    for (auto& ThreadData : Data.ThreadDatas)
+    auto Index_Unknown = Data->Index.Load();
+    if (!Index_Unknown.empty())
+    {
+        if (Err)
+            *Err << "\n" << Index_Unknown.To_UTF8() << " is not a probe index, please provide another index file name.\n";
+        return ReturnValue_ERROR;
+    }
+    ImputIsDir = !Inputs.empty() && Dir::Exists(Inputs[0]);
+    if (ImputIsDir && !IsPathSeparator(Inputs[0][Inputs[0].size() - 1]))
+        Inputs[0] += PathSeparator;
+    Data->Scheduler.HistoryFileName = HistoryFile.empty() ? (TempPath + __T("LeaveSD_History.txt")) : HistoryFile;
+    Data->Scheduler.PriorityFileName = PriorityFile;
+    if (!Data->Worker.IsConnected())
+        Data->Schedule(); // Else the order is decided by the coordinator
+    Data->TempNamePrefix = TempNamePrefix;
+    Data->Staging.Budget = TempMemory;
+    Data->Staging.MemoryPath = TempMemoryPath;
+    if (Data->Staging.Init())
+        Data->TempNamePrefix_Memory = Data->Staging.MemoryPath + __T("temp") + (TempInstance.empty() ? TempInstance : (TempInstance + __T('_')));
+    else if (TempMemory && Err)
+        *Err << "Warning: no memory backed temporary path, --temp-memory is ignored.\n";
+    Journal_Cleanup(*Data);
+    Data->Journal.Start({ TempNamePrefix, Data->TempNamePrefix_Memory });
+    Data->Metrics.FileName = MetricsFile;
+    Data->Metrics.Interval = MetricsInterval;
+    Data->Metrics.Set(Metric_Files, Data->Count());
+    if (!MetricsFile.empty() && !Data->Metrics.Start() && Err)
+        *Err << "Warning: can not create " << Ztring(MetricsFile).To_Local() << ", --metrics is ignored.\n";
+
+    // Disk bound stages have a few threads, CPU bound stage has a thread per core
+    size_t StageThreadCounts_Default[Stage_Max] = { 2, ThreadCount, 2, 1, 1 };
+    size_t Slots_Count = 0;
+    for (size_t i = 0; i < Stage_Max; i++)
+        Slots_Count += StageThreadCounts[i] ? StageThreadCounts[i] : StageThreadCounts_Default[i];
+    Data->Progress.Slots_Set(Slots_Count);
+    Data->Progress_Start(!Data->Worker.IsConnected()); // Files given by the coordinator are not known in advance
+    size_t Slot_Pos = 0;
+    for (size_t i = 0; i < Stage_Max; i++)
     {
-        ThreadData.Reset(ID, this, TempNamePrefix);
-        Futures.push_back(std::async(std::launch::async, Launch_Thread, ID));
-        ID++;
+        auto Count = StageThreadCounts[i] ? StageThreadCounts[i] : StageThreadCounts_Default[i];
+        Data->Queues[i].SetMax(Count); // A job is waiting per thread at most, so there is not too much temporary files
+        for (size_t j = 0; j < Count; j++)
+            Data->Threads.push_back(std::async(std::launch::async, Launch_Thread, std::ref(*Data), (stage)i, Slot_Pos++));
     }
-    for (auto& Future : Futures)
-        Future.get();
 
-    string Message = "Finished, " + to_string(Data.Count() - Data.SkippedCount()) + " file(s) transcoded";
-    if (auto Count = Data.SkippedCount())
-        Message += " + " + to_string(Count) + " skipped file(s)";
-    Message += '.';
-    if (auto Count = Data.ErrorCount())
-        Message += ' ' + to_string(Count) + " error(s).";
-    if (auto Count = Data.WarningCount())
-        Message += ' ' + to_string(Count) + " warning(s).";
-    Data.Err(Message, true);
-
-    return Data.ErrorCount() ? ReturnValue_ERROR : ReturnValue_OK;
+    return ReturnValue_OK;
 }
 
-void Core::Frame(size_t ID, const MediaInfo_Event_Global_Demux_4* FrameData)
+void Core::Frame(data_per_job& Job, const MediaInfo_Event_Global_Demux_4* FrameData)
 {
-    auto& ThreadData = Data.ThreadDatas[ID];
-
-    if (ThreadData.IsChecking)
+    if (Job.IsChecking)
         return;
 
-    static const unsigned char ToSearch_Data[] = { 0x00, 0x00, 0x01, 0x67, 0x64, 0x00, 0x0D, 0xAC, 0x34, 0xE8, 0x16, 0x09, 0x6C, 0x04, 0x40, 0x00, 0x00, 0x03, 0x00, 0x40, 0x00, 0x00, 0x0C, 0xA3, 0xC5, 0x0A, 0xA8, 0x00, 0x00, 0x00, 0x01 };
-    static const size_t ToSearch_Size = sizeof(ToSearch_Data);
+    if (!Job.FullCheck)
+    {
+        if (Job.Slot)
+            Job.Slot->Bytes.fetch_add(FrameData->Content_Size, memory_order_relaxed);
+        Job.Demux_Packets[FrameData->StreamIDs[0]]++;
+        Job.Demux_Bytes[FrameData->StreamIDs[0]] += FrameData->Content_Size;
+    }
+
     if (!FrameData->StreamIDs[0])
     {
-        if (FrameData->Content_Size >= ToSearch_Size)
+        Job.Video.Sizes.push_back((int32u)FrameData->Content_Size);
+        Job.Video.Timestamps.push_back(FrameData->PTS != (int64u)-1 ? FrameData->PTS : FrameData->DTS);
+
+        const sps_patch* Patch;
+        auto i = SpsPatch_Find(FrameData->Content, FrameData->Content_Size, Patch);
+        if (i != (size_t)-1)
         {
-            auto Max = FrameData->Content_Size - ToSearch_Size;
-            for (size_t i = 0; i < Max; i++)
-            {
-                bool IsNok = false;
-                for (size_t j = 0; j < ToSearch_Size; j++)
-                    if (FrameData->Content[i + j] != ToSearch_Data[j])
-                        IsNok = true;
-                if (!IsNok)
-                {
-                    ThreadData.F[FrameData->StreamIDs[0]].Write(FrameData->Content, i + 0x16);
-                    static unsigned char ReplacedBy[] = { 0x0B };
-                    ThreadData.F[FrameData->StreamIDs[0]].Write(ReplacedBy, 1);
-                    ThreadData.F[FrameData->StreamIDs[0]].Write(FrameData->Content + i + 0x17, FrameData->Content_Size - (i + 0x17));
-                    return;
-                }
-            }
+            const int8u* Datas[3] = { FrameData->Content, &Patch->ReplacedBy, FrameData->Content + i + Patch->Offset + 1 };
+            size_t Sizes[3] = { i + Patch->Offset, 1, FrameData->Content_Size - (i + Patch->Offset + 1) };
+            Job.F[FrameData->StreamIDs[0]].Write(Datas, Sizes, 3);
+            return;
         }
     }
     if (FrameData->StreamIDs[0])
     {
+        if (!Job.FullCheck)
+            Job.AudioSizes.push_back(FrameData->Content_Size);
         if (!FrameData->Content_Size)
-            ThreadData.Stats_AudioPacketInvalidSize++;
-        else if (ThreadData.FullCheck)
+            Job.Stats_AudioPacketInvalidSize++;
+        else if (Job.FullCheck)
         {
             size_t Pos = 0;
             while (Pos < FrameData->Content_Size)
             {
-                BitStream BS(FrameData->Content + Pos, FrameData->Content_Size - Pos);
-                auto Sync1 = BS.Get4(30);
-                auto Size = BS.Get2(13);
-                auto Sync2 = BS.Get2(13);
-                if ((Sync1 & 0xFFFFFFE3) != 0x3ffc5400 || Sync2 != 0x1ffc || !Size)
+                size_t Size;
+                if (Job.AdtsValidator.Header(FrameData->Content + Pos, FrameData->Content_Size - Pos, Size) != Adts_Valid)
                 {
-                    ThreadData.Stats_InvalidAudioPackets.push_back(ThreadData.Stats_AacPacketPos);
+                    Job.Stats_InvalidAudioPackets.Add(Job.Stats_AacPacketPos);
 
                     // Let's try to synchronize again
                     Pos++;
-                    while (Pos + 1 < FrameData->Content_Size && (FrameData->Content[Pos] != 0xFF
-                        || (FrameData->Content[Pos + 1] & 0xF6) != 0xF0))
-                        Pos++;
-
-                    if (Pos + 1 >= FrameData->Content_Size)
+                    auto SyncPos = AdtsSync_Find(FrameData->Content + Pos, FrameData->Content_Size - Pos);
+                    if (SyncPos == (size_t)-1)
                         break;
+                    Pos += SyncPos;
                     continue;
                 }
-                MediaInfo MI;
-                MI.Option(__T("File_ForceParser"), __T("Adts"));
-                MI.Option(__T("File_Macroblocks_Parse"), __T("1")); // Used for parsing AAC frame, -1 means no check at all, 1 full check
-                MI.Open_Buffer_Init(Size, 0);
-                MI.Open_Buffer_Continue((MediaInfo_int8u*)FrameData->Content + Pos, Size);
-                MI.Open_Buffer_Finalize();
-                String Format = MI.Get(Stream_Audio, 0, __T("Format"));
-                if (Format != __T("AAC") || !MI.Get(Stream_Audio, 0, __T("GainControl_Present")).empty() || !MI.Get(Stream_Audio, 0, __T("Errors")).empty() || MI.Get(Stream_Audio, 0, __T("Channel(s)")) != ThreadData.ChannelCount)
+                auto Result = AacCheck_MediaInfo
+                    ? Job.AdtsValidator.Frame_MediaInfo(FrameData->Content + Pos, FrameData->Content_Size - Pos, Size, Job.ChannelCount)
+                    : Job.AdtsValidator.Frame(FrameData->Content + Pos, FrameData->Content_Size - Pos, Size, Job.ChannelCount);
+                if (Result != Adts_Valid)
                 {
-                    static const unsigned char EmptyAac_1_Data[] = { 0xFF, 0xF1, 0x50, 0x40, 0x1B, 0x3F, 0xFC, 0x01, 0x16, 0x99, 0xFE, 0x8C, 0x16, 0xA8, 0x8D, 0x09, 0x5A, 0xE2, 0xE9, 0x72, 0x06, 0xB2, 0xF2, 0x4A, 0xB3, 0x07, 0x19, 0xAD, 0xBE, 0xDD, 0x2A, 0x7C, 0x1E, 0x82, 0x67, 0x5E, 0x4D, 0x55, 0xED, 0xE5, 0xA3, 0x71, 0x11, 0x61, 0x4E, 0x2D, 0xCC, 0x87, 0x2F, 0x22, 0x9F, 0xCB, 0xBB, 0x0B, 0x34, 0x7B, 0x3F, 0x5E, 0x9C, 0x72, 0xB7, 0xF1, 0xCE, 0x67, 0xFF, 0x4A, 0x6A, 0xEA, 0xCB, 0xD3, 0xCA, 0x8A, 0xEE, 0x93, 0x45, 0x59, 0xCB, 0x6D, 0x95, 0xD8, 0x49, 0x75, 0x3A, 0xB6, 0x04, 0xF3, 0xC7, 0x11, 0x70, 0x77, 0xBF, 0x51, 0xD4, 0xDE, 0x49, 0xFF, 0x11, 0x4E, 0xCD, 0x2D, 0x79, 0x80, 0x2D, 0x96, 0x3B, 0xA8, 0x06, 0x83, 0x94, 0x6C, 0x54, 0x08, 0x99, 0x06, 0xC2, 0x1B, 0xE4, 0xA5, 0x0D, 0x60, 0xAA, 0x3D, 0xCC, 0x45, 0x50, 0x83, 0x39, 0x14, 0xDD, 0xC3, 0x5A, 0x07, 0x56, 0x27, 0x4F, 0xB8, 0x12, 0xEC, 0x7C, 0x2F, 0x86, 0xDC, 0xA6, 0xAB, 0xD8, 0x55, 0x4B, 0x96, 0x3C, 0x30, 0xBA, 0xFC, 0x6B, 0x8B, 0xF7, 0x3E, 0x72, 0xA6, 0xD2, 0xA3, 0x39, 0xD7, 0xC3, 0xB8, 0xFE, 0x42, 0x71, 0xCE, 0x25, 0x17, 0xBB, 0xEA, 0x57, 0xE8, 0x69, 0xB1, 0x70, 0xF6, 0x9B, 0x3B, 0x3A, 0x1A, 0xBC, 0x36, 0xD1, 0xD7, 0xB6, 0x1A, 0x22, 0x7C, 0x9E, 0xE7, 0x69, 0x05, 0xEB, 0xC2, 0x41, 0xAA, 0xAE, 0x9F, 0x20, 0x0B, 0x3F, 0x0D, 0xF7, 0x12, 0x8D, 0x9E, 0x35, 0x3B, 0xC1, 0xD7, 0xED, 0x78, 0x76, 0x85, 0x9C };
-                    static const size_t EmptyAac_1_Size = sizeof(EmptyAac_1_Data);
-                    static const unsigned char EmptyAac_8_Data[] = { 0xFF, 0xF1, 0x50, 0x00, 0x42, 0x9F, 0xFC, 0xD8, 0x00, 0x00, 0xDE, 0x5E, 0x33, 0x58, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x01, 0x33, 0xFD, 0xAA, 0x30, 0x58, 0xC1, 0x66, 0x89, 0xCB, 0x5F, 0x8B, 0x4A, 0xAA, 0xAA, 0x0C, 0xFA, 0x49, 0x8A, 0xA6, 0x68, 0x95, 0xC8, 0xDE, 0xCE, 0x14, 0x63, 0x66, 0x61, 0x9A, 0xBF, 0x97, 0x21, 0x4D, 0xDD, 0x16, 0x69, 0x23, 0xCE, 0x26, 0xB5, 0xB1, 0x99, 0xDE, 0x20, 0x84, 0xB7, 0xD0, 0x2A, 0x14, 0xC2, 0x1C, 0xBF, 0x92, 0xAC, 0x97, 0x2A, 0x6B, 0x02, 0x05, 0x1C, 0x90, 0x61, 0xCF, 0x0D, 0xC6, 0xCE, 0x6D, 0xC2, 0x10, 0xC3, 0x1F, 0xC4, 0x5C, 0x25, 0x5B, 0x96, 0xF6, 0x02, 0xE8, 0xFE, 0x7C, 0xFD, 0x7B, 0xBF, 0x9E, 0x76, 0x57, 0x81, 0x50, 0x2F, 0x94, 0xFA, 0xAB, 0x68, 0x66, 0xCA, 0x8D, 0x35, 0xF9, 0x2A, 0xA4, 0xAA, 0xE2, 0x25, 0xC2, 0x07, 0x3E, 0x54, 0x67, 0x01, 0x10, 0xA2, 0xF6, 0xF3, 0x05, 0x28, 0x13, 0x70, 0x0A, 0x3C, 0xB7, 0xF5, 0x8C, 0x5E, 0xB7, 0x4F, 0x5D, 0x55, 0x4C, 0x1A, 0x71, 0xAA, 0xF8, 0x9F, 0x1D, 0xB8, 0xA4, 0xED, 0x8C, 0x95, 0x50, 0x72, 0x2E, 0x9C, 0x74, 0x8E, 0x61, 0x9D, 0xAA, 0xB9, 0xEE, 0x58, 0x08, 0x5E, 0x99, 0x29, 0x08, 0x5C, 0xE2, 0x4C, 0xD6, 0x5F, 0x6C, 0xC9, 0x2F, 0x9A, 0xBF, 0x6F, 0x5D, 0x24, 0x8E, 0x8E, 0x04, 0x88, 0x62, 0x64, 0x64, 0x6A, 0x08, 0xB1, 0x23, 0x3D, 0xF5, 0x80, 0x03, 0xF0, 0x38, 0x40, 0xFB, 0xA5, 0xD0, 0xF2, 0xB6, 0x85, 0x02, 0x63, 0x55, 0xBF, 0x70, 0x2B, 0x98, 0xD6, 0xAC, 0x86, 0x78, 0x45, 0xF3, 0x93, 0x7F, 0x13, 0xF3, 0x75, 0xC5, 0x02, 0x3B, 0x3B, 0x5D, 0x8E, 0x39, 0x10, 0xA9, 0x50, 0xC0, 0xB9, 0x61, 0xCD, 0x05, 0x2C, 0x4B, 0x3E, 0x7F, 0x33, 0x14, 0x93, 0x06, 0x55, 0x76, 0x22, 0xA2, 0x52, 0xBC, 0x53, 0xBF, 0x94, 0x5E, 0x32, 0x77, 0xA6, 0x53, 0x55, 0x3A, 0xF0, 0xAB, 0xAC, 0x2B, 0x01, 0x95, 0x55, 0x68, 0x95, 0x18, 0xED, 0xAE, 0x50, 0x42, 0x83, 0xFD, 0xB7, 0x51, 0x0F, 0x22, 0x8F, 0x35, 0x29, 0x4B, 0x94, 0x02, 0x8C, 0x75, 0xCB, 0x01, 0xFE, 0x43, 0xBE, 0xC4, 0xF6, 0xE8, 0x21, 0xF8, 0x2E, 0x28, 0xED, 0xD5, 0xE9, 0x37, 0x9D, 0x0B, 0x0E, 0xE8, 0x0F, 0x40, 0x02, 0x34, 0x1F, 0xED, 0xB6, 0x88, 0x72, 0xD8, 0xB5, 0x04, 0x74, 0x90, 0x75, 0x92, 0xB5, 0x80, 0xBA, 0x62, 0xCF, 0x08, 0xEF, 0xB1, 0x09, 0x68, 0x08, 0x25, 0x41, 0xFE, 0xDB, 0xA8, 0x86, 0xB2, 0x8F, 0x8C, 0x15, 0x55, 0x0F, 0x08, 0x1C, 0xF0, 0xED, 0x41, 0xC7, 0x84, 0x3F, 0x35, 0x45, 0x68, 0x08, 0x02, 0xDC, 0x99, 0xFE, 0x88, 0x36, 0x40, 0x98, 0x81, 0x62, 0xE5, 0x14, 0x83, 0x9A, 0x87, 0xA4, 0x11, 0x79, 0x73, 0xA4, 0xA3, 0x96, 0x07, 0xCD, 0x5C, 0x72, 0x10, 0xFE, 0x90, 0x60, 0x1B, 0x39, 0x16, 0xB7, 0x3B, 0x61, 0x6E, 0x50, 0xA5, 0x65, 0x7A, 0x10, 0x08, 0x31, 0xB1, 0x85, 0x4E, 0x22, 0xF7, 0x99, 0x08, 0x6A, 0x59, 0x39, 0x8B, 0x13, 0x5C, 0xCD, 0x76, 0x34, 0x99, 0x24, 0x6A, 0x90, 0xA4, 0x0A, 0x75, 0x2C, 0x28, 0x59, 0xB0, 0x42, 0xF6, 0x8F, 0x82, 0xD0, 0x06, 0xFE, 0x2B, 0x3B, 0x84, 0xDC, 0x1A, 0xCB, 0xCD, 0x9C, 0x91, 0xC5, 0xD6, 0x85, 0x25, 0x40, 0x10, 0x10, 0xC6, 0x67, 0x54, 0x68, 0xB8, 0xAF, 0xB1, 0x25, 0x01, 0xAA, 0x86, 0x26, 0xDF, 0x28, 0x30, 0xBB, 0x81, 0x4C, 0x84, 0xEB, 0x8A, 0x63, 0x86, 0xAE, 0xDD, 0xBA, 0x3E, 0xDB, 0x1D, 0x2C, 0xD7, 0xCB, 0xF3, 0x30, 0x8D, 0x3C, 0xA3, 0x8D, 0xCE, 0xBE, 0x4E, 0x39, 0x6E, 0xD8, 0x56, 0xB6, 0x3A, 0x59, 0x67, 0xB1, 0x15, 0xAA, 0xC3, 0x6F, 0x9D, 0x9E, 0x79, 0x6D, 0xD4, 0x6C, 0x27, 0x4F, 0x46, 0x79, 0xFD, 0xB7 };
-                    static const size_t EmptyAac_8_Size = sizeof(EmptyAac_8_Data);
-                    if (ThreadData.ChannelCount == __T("1"))
+                    if (Job.ChannelCount == __T("1"))
                     {
-                        ThreadData.Stats_InvalidAacPackets.push_back(ThreadData.Stats_AacPacketPos);
-                        ThreadData.F[FrameData->StreamIDs[0]].Write(EmptyAac_1_Data, EmptyAac_1_Size);
+                        Job.Stats_InvalidAacPackets.Add(Job.Stats_AacPacketPos);
+                        Job.F[FrameData->StreamIDs[0]].Write(AdtsSilence_1_Data, AdtsSilence_1_Size);
                     }
                     else
                     {
-                        ThreadData.Stats_InvalidAacPackets.push_back(ThreadData.Stats_AacPacketPos);
-                        ThreadData.F[FrameData->StreamIDs[0]].Write(EmptyAac_8_Data, EmptyAac_8_Size);
+                        Job.Stats_InvalidAacPackets.Add(Job.Stats_AacPacketPos);
+                        Job.F[FrameData->StreamIDs[0]].Write(AdtsSilence_8_Data, AdtsSilence_8_Size);
                     }
                 }
                 else
-                    ThreadData.F[FrameData->StreamIDs[0]].Write(FrameData->Content + Pos, Size);
-                ThreadData.Stats_AacPacketPos++;
+                    Job.F[FrameData->StreamIDs[0]].Write(FrameData->Content + Pos, Size);
+                Job.Stats_AacPacketPos++;
                 Pos += Size;
             }
             return;
         }
     }
-    ThreadData.F[FrameData->StreamIDs[0]].Write(FrameData->Content, FrameData->Content_Size);
+    Job.F[FrameData->StreamIDs[0]].Write(FrameData->Content, FrameData->Content_Size);
+}
+
+//---------------------------------------------------------------------------
+size_t Core::Frame_Replay(const vector<MediaInfo_Event_Global_Demux_4>& Frames, bool FullCheck, const String& ChannelCount, const String& TempNamePrefix)
+{
+    data_per_job Job;
+    Job.C = this;
+    Job.Data = Data.get();
+    Job.ChannelCount = ChannelCount;
+    if (FullCheck)
+        Job.Reset_FullCheck(); // As the second pass, with what the first pass kept
+    auto Written = Job.F[0].Open(TempNamePrefix + __T(".avc"), WriteBufferSize, WriteBackground);
+    if (!Job.F[1].Open(TempNamePrefix + __T(".aac"), WriteBufferSize, WriteBackground))
+        Written = false;
+    for (const auto& FrameData : Frames)
+        Frame(Job, &FrameData);
+    if (!Job.F[0].Close())
+        Written = false;
+    if (!Job.F[1].Close())
+        Written = false;
+    File::Delete(TempNamePrefix + __T(".avc"));
+    File::Delete(TempNamePrefix + __T(".aac"));
+    if (!Written)
+        return (size_t)-1;
+    return (size_t)(Job.Stats_InvalidAudioPackets.Count() + Job.Stats_InvalidAacPackets.Count());
 }
 
 
@@ -7,6 +7,7 @@
 //---------------------------------------------------------------------------
 #pragma once
 #include "Common/Config.h"
+#include "Common/Scheduler.h"
 #ifdef MEDIAINFO_DLL
     #include "MediaInfoDLL/MediaInfoDLL.h"
     #define MediaInfoNameSpace MediaInfoDLL
@@ -18,6 +19,8 @@
     #define MediaInfoNameSpace MediaInfoLib
 #endif
 #include "MediaInfo/MediaInfo_Events.h"
+#include <functional>
+#include <memory>
 #include <vector>
 using namespace MediaInfoNameSpace;
 #include "iostream"
@@ -32,6 +35,26 @@ using namespace ZenLib;
 // Class core
 //***************************************************************************
 
+struct data_per_job;
+struct all;
+
+// Result of a file converted by this process
+struct file_result
+{
+    String          Input;
+    String          Output;
+    vector<string>  ErrorMessages;
+    vector<string>  WarningMessages;
+    bool            Skipped = false;    // Output already present
+};
+
+enum stage_result
+{
+    StageResult_Finished,
+    StageResult_Next,
+    StageResult_FullCheck,  // Back to demux for a second pass
+};
+
 class Core
 {
 public:
@@ -43,22 +66,75 @@ public:
     vector<String>  Inputs;
     String          OutputDir;
     String          TempPath;
+    String          TempMemoryPath;
+    int64u          TempMemory = 0;
     ostream*        Out = nullptr;
     ostream*        Err = nullptr;
     size_t          ThreadCount = 0;
+    size_t          StageThreadCounts[Stage_Max] = {}; // 0 means default
     bool            KeepTemp = false;
     bool            ForceExistingFiles = false;
     bool            SkipExistingFiles = false;
     bool            LegacyAac = false;
+    bool            Streaming = false;
+    bool            Mkvmerge = false;
+    bool            VerifyFull = false;
+    size_t          VerifySample = 0;
+    bool            DamageReport = false;       // Damaged audio packets of each file are listed next to the output file
+    bool            AacCheck_MediaInfo = false; // AAC frames are checked by a MediaInfo parser instead of the built-in one
+    bool            MappedInput = false;
+    size_t          WriteBufferSize = 8 * 1024 * 1024;
+    bool            WriteBackground = false;
+    String          HistoryFile;
+    String          PriorityFile;
+    String          IndexFile;
+    String          TraceFile;
+    String          MetricsFile;
+    size_t          MetricsInterval = 15;
+    size_t          Shard = 0;                  // 1 to ShardCount, 0 means all files
+    size_t          ShardCount = 0;
+    String          CoordinatorSocket;          // Files are given to worker processes connected to this socket
+    String          WorkerSocket;               // Files are given by the coordinator listening on this socket
 
     bool Scan = false;
 
-    // Process
+    // Callbacks, called by processing threads
+    function<void(const String& Input, stage Stage)> Stage_CallBack; // A file enters a stage
+    function<void(const file_result& Result)> Finished_CallBack;
+
+    // Process, files of Inputs
     return_value    Process();
-    void Frame(size_t ID, const MediaInfo_Event_Global_Demux_4* FrameData);
-    void Convert(size_t ID, size_t FilePos, bool FullCheck = false);
+
+    // Session, files are given one by one while processing, several sessions can run at the same time
+    // Inputs[0], if a directory, is the base of the output paths, else output files are directly in OutputDir
+    return_value    Start();
+    void            Add(const String& FileName);    // Waits if all demux threads are busy
+    return_value    Finish();                       // No more files, returns when all files are finished
+
+    void Frame(data_per_job& Job, const MediaInfo_Event_Global_Demux_4* FrameData);
+    stage_result Convert_Demux(data_per_job& Job);
+    stage_result Convert_Audio(data_per_job& Job);
+    stage_result Convert_Mux(data_per_job& Job);
+    stage_result Convert_Publish(data_per_job& Job);
+    stage_result Convert_Verify(data_per_job& Job);
+
+    // Benchmark, demuxed packets are given to Frame() as in a first pass or a second pass, returns the count of invalid audio packets, -1 if temporary files can not be written
+    size_t Frame_Replay(const vector<MediaInfo_Event_Global_Demux_4>& Frames, bool FullCheck, const String& ChannelCount, const String& TempNamePrefix);
 
 private:
+    // Convert
+    int64u Temp_Estimate(int64u Input_Size, int64u Duration);
+
+    // Scan
+    size_t Scan_Files(const vector<String>& NsvFileNames);
+
+    // Coordinator
+    return_value Coordinate(int64u ListHash);
+
+    // Threads
+    return_value Launch(const Ztring& Instance);
+    unique_ptr<all> Data;
+
     //Stats
     String ExePath;
     string ExePathS;
@@ -0,0 +1,80 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#include "Common/Damage_Map.h"
+#include <cstdio>
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+static const size_t Ranges_Max = 1024;
+
+//***************************************************************************
+// Damages
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+void damage_map::Add(int64u Pos)
+{
+    Total++;
+    if (!Items.empty() && Pos <= Items.back().Last + Gap)
+    {
+        if (Items.back().Last < Pos)
+            Items.back().Last = Pos;
+        Items.back().Count++;
+        return;
+    }
+
+    Items.push_back({ Pos, Pos, 1 });
+    while (Items.size() > Ranges_Max)
+        Merge();
+}
+
+//---------------------------------------------------------------------------
+void damage_map::Merge()
+{
+    Gap *= 2;
+    size_t j = 0;
+    for (size_t i = 1; i < Items.size(); i++)
+    {
+        if (Items[i].First <= Items[j].Last + Gap)
+        {
+            Items[j].Last = Items[i].Last;
+            Items[j].Count += Items[i].Count;
+        }
+        else
+            Items[++j] = Items[i];
+    }
+    Items.resize(j + 1);
+}
+
+//***************************************************************************
+// Report
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+// Milliseconds to HH:MM:SS.mmm
+static string Time_String(int64u Time)
+{
+    char Buffer[32];
+    snprintf(Buffer, sizeof(Buffer), "%02u:%02u:%02u.%03u", (unsigned)(Time / 3600000), (unsigned)(Time / 60000 % 60), (unsigned)(Time / 1000 % 60), (unsigned)(Time % 1000));
+    return Buffer;
+}
+
+//---------------------------------------------------------------------------
+void damage_map::Report(string& Content, const char* Name, int64u Packet_Duration_Num, int64u Packet_Duration_Den) const
+{
+    for (const auto& Item : Items)
+    {
+        Content += Name;
+        Content += '\t' + to_string(Item.First);
+        Content += '\t' + to_string(Item.Last);
+        Content += '\t' + to_string(Item.Count);
+        Content += '\t' + Time_String(Item.First * Packet_Duration_Num / Packet_Duration_Den);
+        Content += '\t' + Time_String((Item.Last + 1) * Packet_Duration_Num / Packet_Duration_Den);
+        Content += '\n';
+    }
+}
@@ -0,0 +1,47 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#pragma once
+#include "ZenLib/Conf.h"
+#include <string>
+#include <vector>
+using namespace ZenLib;
+using namespace std;
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Class damage_map
+//***************************************************************************
+
+struct damage_range
+{
+    int64u              First;                      // Packet positions, Last is included
+    int64u              Last;
+    int64u              Count;                      // Count of damages in the range
+};
+
+// Damaged packets as ranges instead of a position per damage, memory is bounded
+// If there are too many ranges, close ranges are merged so a range may include valid packets
+class damage_map
+{
+public:
+    // Positions are increasing, the same position may be added several times
+    void                Add(int64u Pos);
+
+    // Output
+    int64u              Count() const { return Total; }
+    const vector<damage_range>& Ranges() const { return Items; }
+
+    // Report lines: name, first and last packets, count, begin and end times of the range (HH:MM:SS.mmm)
+    void                Report(string& Content, const char* Name, int64u Packet_Duration_Num, int64u Packet_Duration_Den) const;
+
+private:
+    vector<damage_range> Items;
+    int64u              Total = 0;
+    int64u              Gap = 1;                    // Positions closer than this are in the same range
+    void                Merge();
+};
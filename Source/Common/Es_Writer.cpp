@@ -0,0 +1,306 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#include "Common/Es_Writer.h"
+#include <algorithm>
+#include <cstring>
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <cerrno>
+    #include <fcntl.h>
+    #include <sys/uio.h>
+    #include <unistd.h>
+#endif
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Constants
+//***************************************************************************
+
+static const size_t Buffer_Alignment = 4096;
+static const size_t Gather_MaxCount = 16;
+
+//***************************************************************************
+// Helpers
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+#ifdef _WIN32
+static bool Write_Direct(void* Handle, const int8u* const* Datas, const size_t* Sizes, size_t Count)
+#else
+static bool Write_Direct(int Handle, const int8u* const* Datas, const size_t* Sizes, size_t Count)
+#endif
+{
+    #ifdef _WIN32
+        // No scatter write on buffered files
+        for (size_t i = 0; i < Count; i++)
+        {
+            auto Data = Datas[i];
+            auto Size = Sizes[i];
+            while (Size)
+            {
+                DWORD Written;
+                if (!WriteFile(Handle, Data, (DWORD)min(Size, (size_t)0x40000000), &Written, nullptr) || !Written)
+                    return false;
+                Data += Written;
+                Size -= Written;
+            }
+        }
+    #else
+        iovec Items[Gather_MaxCount];
+        size_t Items_Count = 0;
+        for (size_t i = 0; i < Count; i++)
+        {
+            if (!Sizes[i])
+                continue;
+            Items[Items_Count].iov_base = (void*)Datas[i];
+            Items[Items_Count].iov_len = Sizes[i];
+            Items_Count++;
+        }
+        auto Item = Items;
+        while (Items_Count)
+        {
+            auto Written = writev(Handle, Item, (int)Items_Count);
+            if (Written < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+
+            // Partial write
+            while (Items_Count && (size_t)Written >= Item->iov_len)
+            {
+                Written -= Item->iov_len;
+                Item++;
+                Items_Count--;
+            }
+            if (Items_Count)
+            {
+                Item->iov_base = (int8u*)Item->iov_base + Written;
+                Item->iov_len -= Written;
+            }
+        }
+    #endif
+    return true;
+}
+
+//***************************************************************************
+// Constructor/Destructor
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+es_writer::es_writer(es_writer&& Other)
+{
+    *this = std::move(Other);
+}
+
+//---------------------------------------------------------------------------
+es_writer& es_writer::operator=(es_writer&& Other)
+{
+    if (this == &Other)
+        return *this;
+    Close();
+    Handle = Other.Handle;
+    for (size_t i = 0; i < 2; i++)
+    {
+        Memory[i] = std::move(Other.Memory[i]);
+        Buffer[i] = Other.Buffer[i];
+        Other.Buffer[i] = nullptr;
+    }
+    Buffer_Size = Other.Buffer_Size;
+    Buffer_Used = Other.Buffer_Used;
+    Current = Other.Current;
+    Background = Other.Background;
+    HasError = Other.HasError;
+    Pending = std::move(Other.Pending);
+    #ifdef _WIN32
+        Other.Handle = nullptr;
+    #else
+        Other.Handle = -1;
+    #endif
+    Other.Buffer_Size = 0;
+    Other.Buffer_Used = 0;
+    return *this;
+}
+
+//---------------------------------------------------------------------------
+es_writer::~es_writer()
+{
+    Close();
+}
+
+//***************************************************************************
+// Open/Close
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+bool es_writer::Open(const Ztring& FileName, size_t NewBuffer_Size, bool NewBackground)
+{
+    Close();
+    HasError = false;
+
+    #ifdef _WIN32
+        Handle = CreateFileW(FileName.To_Unicode().c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (Handle == INVALID_HANDLE_VALUE)
+            Handle = nullptr;
+    #else
+        Handle = open(FileName.To_Local().c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    #endif
+    if (!IsOpen())
+    {
+        HasError = true; // Also reported by Close()
+        return false;
+    }
+
+    // Sizes are multiple of the alignment so buffer writes are aligned in the file too
+    Buffer_Size = (NewBuffer_Size + Buffer_Alignment - 1) / Buffer_Alignment * Buffer_Alignment;
+    if (!Buffer_Size)
+        Buffer_Size = Buffer_Alignment;
+    Background = NewBackground;
+    for (size_t i = 0; i < (Background ? 2 : 1); i++)
+    {
+        Memory[i].reset(new int8u[Buffer_Size + Buffer_Alignment]);
+        auto Address = (size_t)Memory[i].get();
+        Buffer[i] = Memory[i].get() + (Buffer_Alignment - Address % Buffer_Alignment) % Buffer_Alignment;
+    }
+    Buffer_Used = 0;
+    Current = 0;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+bool es_writer::Close()
+{
+    if (!IsOpen())
+        return !HasError;
+
+    Flush();
+    if (Pending.valid() && !Pending.get())
+        HasError = true;
+    #ifdef _WIN32
+        CloseHandle(Handle);
+        Handle = nullptr;
+    #else
+        close(Handle);
+        Handle = -1;
+    #endif
+
+    // Jobs keep their writers while waiting for next stages
+    for (size_t i = 0; i < 2; i++)
+    {
+        Memory[i].reset();
+        Buffer[i] = nullptr;
+    }
+    Buffer_Size = 0;
+    Buffer_Used = 0;
+    return !HasError;
+}
+
+//---------------------------------------------------------------------------
+bool es_writer::IsOpen()
+{
+    #ifdef _WIN32
+        return Handle != nullptr;
+    #else
+        return Handle >= 0;
+    #endif
+}
+
+//***************************************************************************
+// Write
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+void es_writer::Write(const int8u* Data, size_t Size)
+{
+    Write(&Data, &Size, 1);
+}
+
+//---------------------------------------------------------------------------
+void es_writer::Write(const int8u* const* Datas, const size_t* Sizes, size_t Count)
+{
+    if (!IsOpen())
+        return;
+
+    size_t Total = 0;
+    for (size_t i = 0; i < Count; i++)
+        Total += Sizes[i];
+    if (Buffer_Used + Total <= Buffer_Size)
+    {
+        for (size_t i = 0; i < Count; i++)
+        {
+            memcpy(Buffer[Current] + Buffer_Used, Datas[i], Sizes[i]);
+            Buffer_Used += Sizes[i];
+        }
+        return;
+    }
+
+    // With background flush, the other buffer is used
+    if (Background && Total <= Buffer_Size)
+    {
+        Flush();
+        Write(Datas, Sizes, Count);
+        return;
+    }
+
+    // Buffer content and new data in one scatter write, new data is not copied
+    if (Count >= Gather_MaxCount)
+    {
+        Flush();
+        for (size_t i = 0; i < Count; i++)
+            Flush(Datas + i, Sizes + i, 1);
+        return;
+    }
+    Flush(Datas, Sizes, Count);
+}
+
+//---------------------------------------------------------------------------
+void es_writer::Flush(const int8u* const* Datas, const size_t* Sizes, size_t Count)
+{
+    if (Background && !Count)
+    {
+        if (!Buffer_Used)
+            return;
+
+        // The other buffer is filled while this one is written
+        if (Pending.valid() && !Pending.get())
+            HasError = true;
+        const int8u* Data = Buffer[Current];
+        size_t Size = Buffer_Used;
+        auto File_Handle = Handle;
+        Pending = async(launch::async, [File_Handle, Data, Size]()
+        {
+            return Write_Direct(File_Handle, &Data, &Size, 1);
+        });
+        Current = 1 - Current;
+        Buffer_Used = 0;
+        return;
+    }
+
+    if (Pending.valid() && !Pending.get())
+        HasError = true;
+    const int8u* Gather_Datas[Gather_MaxCount];
+    size_t Gather_Sizes[Gather_MaxCount];
+    size_t Gather_Count = 0;
+    if (Buffer_Used)
+    {
+        Gather_Datas[Gather_Count] = Buffer[Current];
+        Gather_Sizes[Gather_Count] = Buffer_Used;
+        Gather_Count++;
+    }
+    for (size_t i = 0; i < Count; i++)
+    {
+        Gather_Datas[Gather_Count] = Datas[i];
+        Gather_Sizes[Gather_Count] = Sizes[i];
+        Gather_Count++;
+    }
+    if (Gather_Count && !Write_Direct(Handle, Gather_Datas, Gather_Sizes, Gather_Count))
+        HasError = true;
+    Buffer_Used = 0;
+}
@@ -0,0 +1,54 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#pragma once
+#include "ZenLib/Ztring.h"
+#include <future>
+#include <memory>
+using namespace ZenLib;
+using namespace std;
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Class es_writer
+//***************************************************************************
+
+// Packets are gathered in large buffers, written when a buffer is full
+// With background flush, a full buffer is written by another thread while the other buffer is filled
+class es_writer
+{
+public:
+    static const size_t Buffer_Size_Default = 8 * 1024 * 1024;
+
+    es_writer() {}
+    es_writer(es_writer&& Other);
+    es_writer& operator=(es_writer&& Other);
+    ~es_writer();
+
+    bool                Open(const Ztring& FileName, size_t Buffer_Size = Buffer_Size_Default, bool Background = false); // Existing content is erased
+    void                Write(const int8u* Data, size_t Size);
+    void                Write(const int8u* const* Datas, const size_t* Sizes, size_t Count); // Gathered, e.g. a packet with a patched byte
+    bool                Close();                    // false if the open or a write failed, buffers are released
+
+private:
+    #ifdef _WIN32
+        void*           Handle = nullptr;
+    #else
+        int             Handle = -1;
+    #endif
+    unique_ptr<int8u[]> Memory[2];
+    int8u*              Buffer[2] = {};             // Aligned in Memory
+    size_t              Buffer_Size = 0;
+    size_t              Buffer_Used = 0;
+    size_t              Current = 0;
+    bool                Background = false;
+    bool                HasError = false;
+    future<bool>        Pending;                    // Background write of the other buffer
+
+    bool                IsOpen();
+    void                Flush(const int8u* const* Datas = nullptr, const size_t* Sizes = nullptr, size_t Count = 0);
+};
@@ -0,0 +1,202 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#include "Common/File_Publish.h"
+#include "ZenLib/File.h"
+#include <algorithm>
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <cerrno>
+    #include <cstdio>
+    #include <fcntl.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #ifdef __linux__
+        #include <linux/fs.h>
+        #include <sys/ioctl.h>
+        #include <sys/sendfile.h>
+    #endif
+#endif
+using namespace std;
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Constants
+//***************************************************************************
+
+#ifndef _WIN32
+static const size_t Copy_ChunkSize = 64 * 1024 * 1024; // In kernel copies
+static const size_t Copy_BufferSize = 8 * 1024 * 1024; // Copy through user space, if nothing else works
+#endif
+
+//***************************************************************************
+// Helpers
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+static bool Rename(const Ztring& From, const Ztring& To, bool Replace, bool& CrossDevice)
+{
+    CrossDevice = false;
+    #ifdef _WIN32
+        if (MoveFileExW(From.To_Unicode().c_str(), To.To_Unicode().c_str(), Replace ? MOVEFILE_REPLACE_EXISTING : 0))
+            return true;
+        CrossDevice = GetLastError() == ERROR_NOT_SAME_DEVICE;
+        return false;
+    #else
+        if (!Replace && File::Exists(To))
+            return false;
+        if (!rename(From.To_Local().c_str(), To.To_Local().c_str()))
+            return true;
+        CrossDevice = errno == EXDEV;
+        return false;
+    #endif
+}
+
+//---------------------------------------------------------------------------
+#ifndef _WIN32
+static bool Copy_Content(int In, int Out, int64u Size)
+{
+    int64u Done = 0;
+
+    #ifdef __linux__
+        // Extents shared by both files (Btrfs, XFS...), nothing is copied
+        if (!ioctl(Out, FICLONE, In))
+            return true;
+
+        // Copy in kernel, possibly offloaded by the file system or the storage
+        while (Done < Size)
+        {
+            auto Result = copy_file_range(In, nullptr, Out, nullptr, (size_t)min(Size - Done, (int64u)Copy_ChunkSize), 0);
+            if (Result <= 0)
+                break;
+            Done += Result;
+        }
+        while (Done < Size)
+        {
+            auto Result = sendfile(Out, In, nullptr, (size_t)min(Size - Done, (int64u)Copy_ChunkSize));
+            if (Result <= 0)
+                break;
+            Done += Result;
+        }
+        if (Done == Size)
+            return true;
+    #endif
+
+    // Copy through user space, from where in kernel copies stopped
+    char* Buffer = new char[Copy_BufferSize];
+    bool IsOK = true;
+    while (Done < Size)
+    {
+        auto Read = read(In, Buffer, Copy_BufferSize);
+        if (Read <= 0)
+        {
+            if (Read < 0 && errno == EINTR)
+                continue;
+            IsOK = false;
+            break;
+        }
+        for (ssize_t Pos = 0; Pos < Read;)
+        {
+            auto Written = write(Out, Buffer + Pos, Read - Pos);
+            if (Written <= 0)
+            {
+                if (Written < 0 && errno == EINTR)
+                    continue;
+                IsOK = false;
+                break;
+            }
+            Pos += Written;
+        }
+        if (!IsOK)
+            break;
+        Done += Read;
+    }
+    delete[] Buffer;
+    return IsOK;
+}
+#endif
+
+//---------------------------------------------------------------------------
+static bool Copy(const Ztring& From, const Ztring& To)
+{
+    #ifdef _WIN32
+        // No buffering: large files are copied without filling the system cache, block cloning is used by the system if possible
+        if (!CopyFileExW(From.To_Unicode().c_str(), To.To_Unicode().c_str(), nullptr, nullptr, nullptr, COPY_FILE_NO_BUFFERING))
+            return false;
+        auto Attributes = GetFileAttributesW(To.To_Unicode().c_str());
+        if (Attributes != INVALID_FILE_ATTRIBUTES)
+            SetFileAttributesW(To.To_Unicode().c_str(), Attributes | FILE_ATTRIBUTE_HIDDEN);
+        return true;
+    #else
+        auto In = open(From.To_Local().c_str(), O_RDONLY);
+        if (In < 0)
+            return false;
+        struct stat Stat;
+        if (fstat(In, &Stat))
+        {
+            close(In);
+            return false;
+        }
+        auto Out = open(To.To_Local().c_str(), O_WRONLY | O_CREAT | O_TRUNC, Stat.st_mode & 0777);
+        if (Out < 0)
+        {
+            close(In);
+            return false;
+        }
+        #ifdef POSIX_FADV_SEQUENTIAL
+            posix_fadvise(In, 0, 0, POSIX_FADV_SEQUENTIAL);
+        #endif
+
+        auto IsOK = Copy_Content(In, Out, (int64u)Stat.st_size);
+        if (IsOK && fsync(Out)) // Data is on disk before the file has its final name
+            IsOK = false;
+        close(In);
+        if (close(Out))
+            IsOK = false;
+        return IsOK;
+    #endif
+}
+
+//***************************************************************************
+// Publish
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+Ztring File_Publish_TempName(const Ztring& To)
+{
+    auto Pos = To.find_last_of(__T("/\\"));
+    Pos = Pos == string::npos ? 0 : (Pos + 1);
+    return To.substr(0, Pos) + __T('.') + To.substr(Pos) + __T(".partial");
+}
+
+//---------------------------------------------------------------------------
+bool File_Publish(const Ztring& From, const Ztring& To, bool Replace)
+{
+    bool CrossDevice;
+    if (Rename(From, To, Replace, CrossDevice))
+        return true;
+    if (!CrossDevice)
+        return false;
+
+    // Another volume
+    if (!Replace && File::Exists(To))
+        return false;
+    auto TempName = File_Publish_TempName(To);
+    if (!Copy(From, TempName) || !Rename(TempName, To, Replace, CrossDevice))
+    {
+        File::Delete(TempName);
+        return false;
+    }
+    #ifdef _WIN32
+        auto Attributes = GetFileAttributesW(To.To_Unicode().c_str());
+        if (Attributes != INVALID_FILE_ATTRIBUTES)
+            SetFileAttributesW(To.To_Unicode().c_str(), Attributes & ~FILE_ATTRIBUTE_HIDDEN);
+    #endif
+    File::Delete(From);
+    return true;
+}
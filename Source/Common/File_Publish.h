@@ -0,0 +1,22 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#pragma once
+#include "ZenLib/Ztring.h"
+using namespace ZenLib;
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Publish
+//***************************************************************************
+
+// Move of a finished file to its final location, a partial file is never visible with the final name
+// Renamed if on the same volume, else cloned or copied by the system to a hidden file in the destination directory then renamed
+bool File_Publish(const Ztring& From, const Ztring& To, bool Replace);
+
+// Hidden file used during a copy to another volume
+Ztring File_Publish_TempName(const Ztring& To);
@@ -0,0 +1,224 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#include "Common/Job_Journal.h"
+#include "ZenLib/File.h"
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <cstdio>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Constants
+//***************************************************************************
+
+static const char* Journal_Header = "LeaveSD job journal v1";
+
+static const char* State_Names[JobState_Max] =
+{
+    "Queued",
+    "Demuxed",
+    "Encoded",
+    "Muxed",
+    "Moved",
+    "Verified",
+    "Failed",
+};
+
+static const chrono::seconds Sync_Interval(1);
+
+//***************************************************************************
+// Previous runs
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+void job_journal::Load()
+{
+    if (FileName.empty())
+        return;
+
+    string Content;
+    File In;
+    if (!In.Open(FileName))
+        return;
+    int8u Buffer[65536];
+    while (auto Size = In.Read(Buffer, sizeof(Buffer)))
+        Content.append((const char*)Buffer, Size);
+    In.Close();
+
+    size_t Begin = 0;
+    bool IsFirst = true;
+    while (Begin < Content.size())
+    {
+        auto End = Content.find('\n', Begin);
+        if (End == string::npos)
+            break; // Incomplete record
+        auto Line = Content.substr(Begin, End - Begin);
+        Begin = End + 1;
+        if (IsFirst)
+        {
+            if (Line != Journal_Header)
+                return;
+            IsFirst = false;
+            continue;
+        }
+
+        auto Tab = Line.find('\t');
+        auto Name = Line.substr(0, Tab);
+        Ztring Value;
+        if (Tab != string::npos)
+            Value.From_UTF8(Line.substr(Tab + 1));
+        if (Name == "Run")
+            Interrupted_TempNamePrefixes.push_back(Value);
+        else if (Name == "End")
+            Interrupted_TempNamePrefixes.clear();
+        else
+        {
+            for (size_t i = 0; i < JobState_Max; i++)
+                if (Name == State_Names[i])
+                    States[Value] = (job_state)i;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+bool job_journal::IsInterrupted()
+{
+    return !Interrupted_TempNamePrefixes.empty();
+}
+
+//---------------------------------------------------------------------------
+vector<Ztring> job_journal::TempNamePrefixes()
+{
+    return Interrupted_TempNamePrefixes;
+}
+
+//---------------------------------------------------------------------------
+job_state job_journal::State_Get(const Ztring& Path)
+{
+    auto State = States.find(Path);
+    if (State == States.end())
+        return JobState_Max;
+    return State->second;
+}
+
+//***************************************************************************
+// Current run
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+void job_journal::Start(const vector<Ztring>& TempNamePrefixes)
+{
+    if (FileName.empty())
+        return;
+
+    // Only the last state of each file is kept, the new content replaces the old one atomically
+    string Content(Journal_Header);
+    Content += '\n';
+    for (const auto& Item : States)
+        Content += string(State_Names[Item.second]) + '\t' + Item.first.To_UTF8() + '\n';
+    for (const auto& TempNamePrefix : TempNamePrefixes)
+        if (!TempNamePrefix.empty())
+            Content += "Run\t" + TempNamePrefix.To_UTF8() + '\n';
+
+    Ztring FileName_Temp = FileName + __T(".tmp");
+    #ifdef _WIN32
+        auto Temp = CreateFileW(FileName_Temp.To_Unicode().c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (Temp == INVALID_HANDLE_VALUE)
+            return;
+        DWORD Written;
+        auto IsOk = WriteFile(Temp, Content.data(), (DWORD)Content.size(), &Written, nullptr) && Written == Content.size() && FlushFileBuffers(Temp);
+        CloseHandle(Temp);
+        if (!IsOk || !MoveFileExW(FileName_Temp.To_Unicode().c_str(), FileName.To_Unicode().c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+            return;
+        Handle = CreateFileW(FileName.To_Unicode().c_str(), FILE_APPEND_DATA, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (Handle == INVALID_HANDLE_VALUE)
+            Handle = nullptr;
+    #else
+        auto Temp = open(FileName_Temp.To_Local().c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (Temp < 0)
+            return;
+        auto IsOk = write(Temp, Content.data(), Content.size()) == (ssize_t)Content.size() && !fsync(Temp);
+        close(Temp);
+        if (!IsOk || rename(FileName_Temp.To_Local().c_str(), FileName.To_Local().c_str()))
+            return;
+        Handle = open(FileName.To_Local().c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+    #endif
+    Sync_Last = chrono::steady_clock::now();
+}
+
+//---------------------------------------------------------------------------
+// Terminal states (output in the output directory or failure) are synced immediately, they are not done again by the next run
+void job_journal::Set(const Ztring& Path, job_state State)
+{
+    Write(string(State_Names[State]) + '\t' + Path.To_UTF8() + '\n', State >= JobState_Moved);
+}
+
+//---------------------------------------------------------------------------
+void job_journal::End()
+{
+    Write("End\n", true);
+    Close();
+}
+
+//---------------------------------------------------------------------------
+job_journal::~job_journal()
+{
+    Close();
+}
+
+//---------------------------------------------------------------------------
+// Records survive a crash of the process immediately, a crash of the system after the next sync (at most 1 s later if there is a next record, at close else)
+void job_journal::Write(const string& Content, bool Sync)
+{
+    const lock_guard<mutex> Lock(Mutex);
+    auto Now = chrono::steady_clock::now();
+    if (Now - Sync_Last >= Sync_Interval)
+        Sync = true;
+    #ifdef _WIN32
+        if (!Handle)
+            return;
+        DWORD Written;
+        WriteFile(Handle, Content.data(), (DWORD)Content.size(), &Written, nullptr);
+        if (Sync)
+            FlushFileBuffers(Handle);
+    #else
+        if (Handle < 0)
+            return;
+        if (write(Handle, Content.data(), Content.size()) < 0)
+            return;
+        if (Sync)
+            fsync(Handle);
+    #endif
+    if (Sync)
+        Sync_Last = Now;
+}
+
+//---------------------------------------------------------------------------
+void job_journal::Close()
+{
+    const lock_guard<mutex> Lock(Mutex);
+    #ifdef _WIN32
+        if (Handle)
+        {
+            FlushFileBuffers(Handle);
+            CloseHandle(Handle);
+        }
+        Handle = nullptr;
+    #else
+        if (Handle >= 0)
+        {
+            fsync(Handle);
+            close(Handle);
+        }
+        Handle = -1;
+    #endif
+}
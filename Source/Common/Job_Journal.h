@@ -0,0 +1,71 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#pragma once
+#include "ZenLib/Ztring.h"
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+using namespace ZenLib;
+using namespace std;
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// States
+//***************************************************************************
+
+enum job_state
+{
+    JobState_Queued,
+    JobState_Demuxed,
+    JobState_Encoded,
+    JobState_Muxed,                 // Output is complete in the temporary path
+    JobState_Moved,                 // Output is in the output directory, not verified
+    JobState_Verified,
+    JobState_Failed,
+    JobState_Max
+};
+
+//***************************************************************************
+// Class job_journal
+//***************************************************************************
+
+// Append only, each record is written immediately, disk sync is done at most once per second
+class job_journal
+{
+public:
+    // Input
+    Ztring              FileName;                   // Empty means no journal
+
+    // Previous runs
+    void                Load();
+    bool                IsInterrupted();            // Last run did not reach End()
+    vector<Ztring>      TempNamePrefixes();         // Of interrupted runs
+    job_state           State_Get(const Ztring& Path); // JobState_Max if unknown
+
+    // Current run
+    void                Start(const vector<Ztring>& TempNamePrefixes); // Journal is compacted
+    void                Set(const Ztring& Path, job_state State);
+    void                End();
+
+    ~job_journal();
+
+private:
+    map<Ztring, job_state> States;
+    vector<Ztring>      Interrupted_TempNamePrefixes;
+    #ifdef _WIN32
+        void*           Handle = nullptr;
+    #else
+        int             Handle = -1;
+    #endif
+    chrono::steady_clock::time_point Sync_Last;
+    mutex               Mutex;
+    void                Write(const string& Content, bool Sync);
+    void                Close();
+};
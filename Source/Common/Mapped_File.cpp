@@ -0,0 +1,92 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#include "Common/Mapped_File.h"
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Mapping
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+mapped_file::~mapped_file()
+{
+    Close();
+}
+
+//---------------------------------------------------------------------------
+bool mapped_file::Open(const Ztring& FileName)
+{
+    Close();
+
+    #ifdef _WIN32
+        auto Handle = CreateFileW(FileName.To_Unicode().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (Handle == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER File_Size;
+        if (!GetFileSizeEx(Handle, &File_Size) || !File_Size.QuadPart || (int64u)File_Size.QuadPart != (size_t)File_Size.QuadPart)
+        {
+            CloseHandle(Handle);
+            return false;
+        }
+        Mapping = CreateFileMappingW(Handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(Handle); // The mapping keeps a reference to the file
+        if (!Mapping)
+            return false;
+        Data = (const int8u*)MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!Data)
+        {
+            Close();
+            return false;
+        }
+        Size = File_Size.QuadPart;
+    #else
+        auto Handle = open(FileName.To_Local().c_str(), O_RDONLY | O_CLOEXEC);
+        if (Handle < 0)
+            return false;
+        struct stat Stat;
+        if (fstat(Handle, &Stat) || !Stat.st_size || (int64u)Stat.st_size != (size_t)Stat.st_size)
+        {
+            close(Handle);
+            return false;
+        }
+        auto Address = mmap(nullptr, Stat.st_size, PROT_READ, MAP_PRIVATE, Handle, 0);
+        close(Handle); // The mapping keeps a reference to the file
+        if (Address == MAP_FAILED)
+            return false;
+        madvise(Address, Stat.st_size, MADV_SEQUENTIAL);
+        Data = (const int8u*)Address;
+        Size = Stat.st_size;
+    #endif
+
+    return true;
+}
+
+//---------------------------------------------------------------------------
+void mapped_file::Close()
+{
+    #ifdef _WIN32
+        if (Data)
+            UnmapViewOfFile(Data);
+        if (Mapping)
+            CloseHandle(Mapping);
+        Mapping = nullptr;
+    #else
+        if (Data)
+            munmap((void*)Data, Size);
+    #endif
+    Data = nullptr;
+    Size = 0;
+}
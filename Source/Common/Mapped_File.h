@@ -0,0 +1,33 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#pragma once
+#include "ZenLib/Ztring.h"
+using namespace ZenLib;
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Class mapped_file
+//***************************************************************************
+
+// Read only view of a whole file, the system is told that it is read sequentially
+class mapped_file
+{
+public:
+    ~mapped_file();
+
+    bool                Open(const Ztring& FileName);
+    void                Close();
+
+    const int8u*        Data = nullptr;
+    int64u              Size = 0;
+
+private:
+    #ifdef _WIN32
+        void*           Mapping = nullptr;
+    #endif
+};
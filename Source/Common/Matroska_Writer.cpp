@@ -0,0 +1,811 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#include "Common/Matroska_Writer.h"
+#include "Common/Pattern_Scanner.h"
+#include "ZenLib/File.h"
+#include <cstdio>
+#include <cstring>
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// EBML
+//***************************************************************************
+
+typedef vector<int8u> buffer;
+
+//---------------------------------------------------------------------------
+enum mkv_id : int32u
+{
+    Id_EBML                     = 0x1A45DFA3,
+    Id_EBMLVersion              = 0x4286,
+    Id_EBMLReadVersion          = 0x42F7,
+    Id_EBMLMaxIDLength          = 0x42F2,
+    Id_EBMLMaxSizeLength        = 0x42F3,
+    Id_DocType                  = 0x4282,
+    Id_DocTypeVersion           = 0x4287,
+    Id_DocTypeReadVersion       = 0x4285,
+    Id_Void                     = 0xEC,
+    Id_Segment                  = 0x18538067,
+    Id_SeekHead                 = 0x114D9B74,
+    Id_Seek                     = 0x4DBB,
+    Id_SeekID                   = 0x53AB,
+    Id_SeekPosition             = 0x53AC,
+    Id_Info                     = 0x1549A966,
+    Id_TimestampScale           = 0x2AD7B1,
+    Id_Duration                 = 0x4489,
+    Id_MuxingApp                = 0x4D80,
+    Id_WritingApp               = 0x5741,
+    Id_Tracks                   = 0x1654AE6B,
+    Id_TrackEntry               = 0xAE,
+    Id_TrackNumber              = 0xD7,
+    Id_TrackUID                 = 0x73C5,
+    Id_TrackType                = 0x83,
+    Id_FlagDefault              = 0x88,
+    Id_FlagLacing               = 0x9C,
+    Id_FlagOriginal             = 0x55AE,
+    Id_DefaultDuration          = 0x23E383,
+    Id_Name                     = 0x536E,
+    Id_Language                 = 0x22B59C,
+    Id_CodecID                  = 0x86,
+    Id_CodecPrivate             = 0x63A2,
+    Id_Video                    = 0xE0,
+    Id_PixelWidth               = 0xB0,
+    Id_PixelHeight              = 0xBA,
+    Id_Audio                    = 0xE1,
+    Id_SamplingFrequency        = 0xB5,
+    Id_OutputSamplingFrequency  = 0x78B5,
+    Id_Channels                 = 0x9F,
+    Id_Cluster                  = 0x1F43B675,
+    Id_Timestamp                = 0xE7,
+    Id_SimpleBlock              = 0xA3,
+    Id_Cues                     = 0x1C53BB6B,
+    Id_CuePoint                 = 0xBB,
+    Id_CueTime                  = 0xB3,
+    Id_CueTrackPositions        = 0xB7,
+    Id_CueTrack                 = 0xF7,
+    Id_CueClusterPosition       = 0xF1,
+    Id_Chapters                 = 0x1043A770,
+    Id_EditionEntry             = 0x45B9,
+    Id_EditionUID               = 0x45BC,
+    Id_ChapterAtom              = 0xB6,
+    Id_ChapterUID               = 0x73C4,
+    Id_ChapterTimeStart         = 0x91,
+    Id_ChapterDisplay           = 0x80,
+    Id_ChapString               = 0x85,
+    Id_ChapLanguage             = 0x437C,
+    Id_Tags                     = 0x1254C367,
+    Id_Tag                      = 0x7373,
+    Id_Targets                  = 0x63C0,
+    Id_SimpleTag                = 0x67C8,
+    Id_TagName                  = 0x45A3,
+    Id_TagString                = 0x4487,
+};
+
+//---------------------------------------------------------------------------
+static void Put_Id(buffer& B, int32u Id)
+{
+    if (Id > 0xFFFFFF)
+        B.push_back((int8u)(Id >> 24));
+    if (Id > 0xFFFF)
+        B.push_back((int8u)(Id >> 16));
+    if (Id > 0xFF)
+        B.push_back((int8u)(Id >> 8));
+    B.push_back((int8u)Id);
+}
+
+//---------------------------------------------------------------------------
+static void Put_Size(buffer& B, int64u Size, size_t Length = 0)
+{
+    if (!Length)
+    {
+        Length = 1;
+        while (Length < 8 && Size >= (((int64u)1) << (7 * Length)) - 1) // All 1s is reserved
+            Length++;
+    }
+    for (size_t i = Length; i--;)
+    {
+        auto Byte = (int8u)(Size >> (8 * i));
+        if (i == Length - 1)
+            Byte |= (int8u)(0x80 >> (Length - 1));
+        B.push_back(Byte);
+    }
+}
+
+//---------------------------------------------------------------------------
+static void Put_UInt(buffer& B, int32u Id, int64u Value)
+{
+    size_t Length = 1;
+    while (Length < 8 && (Value >> (8 * Length)))
+        Length++;
+    Put_Id(B, Id);
+    Put_Size(B, Length);
+    for (size_t i = Length; i--;)
+        B.push_back((int8u)(Value >> (8 * i)));
+}
+
+//---------------------------------------------------------------------------
+static void Put_Float(buffer& B, int32u Id, double Value)
+{
+    int64u Bits;
+    memcpy(&Bits, &Value, 8);
+    Put_Id(B, Id);
+    Put_Size(B, 8);
+    for (size_t i = 8; i--;)
+        B.push_back((int8u)(Bits >> (8 * i)));
+}
+
+//---------------------------------------------------------------------------
+static void Put_Binary(buffer& B, int32u Id, const int8u* Data, size_t Size)
+{
+    Put_Id(B, Id);
+    Put_Size(B, Size);
+    B.insert(B.end(), Data, Data + Size);
+}
+
+//---------------------------------------------------------------------------
+static void Put_String(buffer& B, int32u Id, const string& Value)
+{
+    Put_Binary(B, Id, (const int8u*)Value.data(), Value.size());
+}
+
+//---------------------------------------------------------------------------
+static void Put_Master(buffer& B, int32u Id, const buffer& Content)
+{
+    Put_Binary(B, Id, Content.data(), Content.size());
+}
+
+//***************************************************************************
+// Input
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+struct block
+{
+    int64s          Timestamp = 0; // In ms
+    int64u          TrackNumber = 0;
+    bool            IsKeyFrame = false;
+    buffer          Data;
+};
+
+//---------------------------------------------------------------------------
+class buffered_file
+{
+public:
+    bool Open(const Ztring& FileName)
+    {
+        return F.Open(FileName);
+    }
+    bool Read(int8u* Data, size_t Size)
+    {
+        while (Size)
+        {
+            if (Buffer_Pos >= Buffer_Size)
+            {
+                if (Buffer.empty())
+                    Buffer.resize(1 << 20);
+                Buffer_Pos = 0;
+                Buffer_Size = F.Read(Buffer.data(), Buffer.size());
+                if (!Buffer_Size)
+                    return false;
+            }
+            auto ToCopy = Buffer_Size - Buffer_Pos;
+            if (ToCopy > Size)
+                ToCopy = Size;
+            memcpy(Data, Buffer.data() + Buffer_Pos, ToCopy);
+            Buffer_Pos += ToCopy;
+            Data += ToCopy;
+            Size -= ToCopy;
+        }
+        return true;
+    }
+    void Rewind()
+    {
+        F.GoTo(0);
+        Buffer_Pos = 0;
+        Buffer_Size = 0;
+    }
+
+private:
+    File            F;
+    buffer          Buffer;
+    size_t          Buffer_Pos = 0;
+    size_t          Buffer_Size = 0;
+};
+
+//---------------------------------------------------------------------------
+class video_reader
+{
+public:
+    bool Open(const mkv_video& NewVideo, int64u NewTrackNumber)
+    {
+        Video = &NewVideo;
+        TrackNumber = NewTrackNumber;
+        if (!F.Open(Video->FileName))
+            return false;
+
+        // Parameter sets are needed for the track header
+        block Block;
+        while ((Sps.empty() || Pps.empty()) && Next(Block))
+            ;
+        F.Rewind();
+        Pos = 0;
+        return true;
+    }
+
+    bool Next(block& Block)
+    {
+        if (Pos >= Video->Sizes.size())
+            return false;
+        Raw.resize(Video->Sizes[Pos]);
+        if (!F.Read(Raw.data(), Raw.size()))
+            return false;
+
+        // Annex B to length prefixed NAL units
+        static const int8u StartCode[] = { 0x00, 0x00, 0x01 };
+        Block.Data.clear();
+        Block.IsKeyFrame = false;
+        auto Begin = Pattern_Find(Raw.data(), Raw.size(), StartCode, 3);
+        if (Begin == (size_t)-1)
+            Append(Block, Raw.data(), Raw.size());
+        else
+        {
+            Begin += 3;
+            while (Begin < Raw.size())
+            {
+                auto End = Pattern_Find(Raw.data() + Begin, Raw.size() - Begin, StartCode, 3);
+                auto Next = End == (size_t)-1 ? Raw.size() : (Begin + End);
+                End = Next;
+                while (End > Begin && !Raw[End - 1]) // trailing_zero_8bits or 4-byte start code
+                    End--;
+                Append(Block, Raw.data() + Begin, End - Begin);
+                Begin = Next + 3;
+            }
+        }
+
+        auto Timestamp = Pos < Video->Timestamps.size() ? Video->Timestamps[Pos] : (int64u)-1;
+        if (Timestamp == (int64u)-1)
+            Timestamp = Pos * Video->FrameDuration;
+        Block.Timestamp = (int64s)(Timestamp / 1000000) + Video->Delay;
+        Block.TrackNumber = TrackNumber;
+        Pos++;
+        return true;
+    }
+
+    buffer          Sps;
+    buffer          Pps;
+
+private:
+    void Append(block& Block, const int8u* Nal, size_t Nal_Size)
+    {
+        if (!Nal_Size)
+            return;
+        switch (Nal[0] & 0x1F)
+        {
+        case 5: Block.IsKeyFrame = true; break;
+        case 7: Block.IsKeyFrame = true; if (Sps.empty()) Sps.assign(Nal, Nal + Nal_Size); break;
+        case 8: if (Pps.empty()) Pps.assign(Nal, Nal + Nal_Size); break;
+        }
+        for (size_t i = 4; i--;)
+            Block.Data.push_back((int8u)(Nal_Size >> (8 * i)));
+        Block.Data.insert(Block.Data.end(), Nal, Nal + Nal_Size);
+    }
+
+    const mkv_video* Video = nullptr;
+    int64u          TrackNumber = 0;
+    buffered_file   F;
+    buffer          Raw;
+    size_t          Pos = 0;
+};
+
+//---------------------------------------------------------------------------
+static const int32u Aac_SamplingFrequencies[] = { 96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000, 7350 };
+
+//---------------------------------------------------------------------------
+class audio_reader
+{
+public:
+    bool Open(const mkv_audio& NewAudio, int64u NewTrackNumber)
+    {
+        Audio = &NewAudio;
+        TrackNumber = NewTrackNumber;
+        if (!F.Open(Audio->FileName))
+            return false;
+
+        // Configuration is taken from the first frame
+        int8u Header[7];
+        if (!F.Read(Header, 7) || Header[0] != 0xFF || (Header[1] & 0xF6) != 0xF0)
+            return false;
+        ObjectType = (Header[2] >> 6) + 1;
+        SamplingFrequencyIndex = (Header[2] >> 2) & 0x0F;
+        ChannelConfiguration = ((Header[2] & 0x01) << 2) | (Header[3] >> 6);
+        if (SamplingFrequencyIndex >= sizeof(Aac_SamplingFrequencies) / sizeof(*Aac_SamplingFrequencies))
+            return false;
+        SamplingFrequency = Aac_SamplingFrequencies[SamplingFrequencyIndex];
+        F.Rewind();
+        return true;
+    }
+
+    bool Next(block& Block)
+    {
+        int8u Header[7];
+        if (!F.Read(Header, 7) || Header[0] != 0xFF || (Header[1] & 0xF6) != 0xF0)
+            return false;
+        size_t Size = (((size_t)(Header[3] & 0x03)) << 11) | (((size_t)Header[4]) << 3) | (Header[5] >> 5);
+        size_t Header_Size = (Header[1] & 0x01) ? 7 : 9; // CRC
+        if (Size < Header_Size)
+            return false;
+        Raw.resize(Size - 7);
+        if (!F.Read(Raw.data(), Raw.size()))
+            return false;
+        Block.Data.assign(Raw.begin() + (Header_Size - 7), Raw.end());
+        Block.IsKeyFrame = true;
+        Block.Timestamp = (int64s)(Pos * 1024 * 1000 / SamplingFrequency) + Audio->Delay;
+        Block.TrackNumber = TrackNumber;
+        Pos++;
+        return true;
+    }
+
+    buffer AudioSpecificConfig() const
+    {
+        int64u Bits = 0;
+        size_t Bits_Count = 0;
+        auto Put = [&](int32u Value, size_t Count)
+        {
+            Bits = (Bits << Count) | Value;
+            Bits_Count += Count;
+        };
+        Put(ObjectType, 5);
+        Put(SamplingFrequencyIndex, 4);
+        Put(ChannelConfiguration, 4);
+        Put(0, 3); // frameLengthFlag, dependsOnCoreCoder, extensionFlag
+        if (Audio->Sbr && SamplingFrequencyIndex >= 3)
+        {
+            Put(0x2B7, 11); // syncExtensionType
+            Put(5, 5); // SBR
+            Put(1, 1); // sbrPresentFlag
+            Put(SamplingFrequencyIndex - 3, 4);
+        }
+        if (Bits_Count % 8)
+            Put(0, 8 - Bits_Count % 8);
+        buffer ToReturn;
+        for (size_t i = Bits_Count / 8; i--;)
+            ToReturn.push_back((int8u)(Bits >> (8 * i)));
+        return ToReturn;
+    }
+
+    const mkv_audio* Audio = nullptr;
+    int8u           ObjectType = 0;
+    int8u           SamplingFrequencyIndex = 0;
+    int8u           ChannelConfiguration = 0;
+    int32u          SamplingFrequency = 0;
+
+private:
+    int64u          TrackNumber = 0;
+    buffered_file   F;
+    buffer          Raw;
+    int64u          Pos = 0;
+};
+
+//***************************************************************************
+// Write
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+bool matroska_writer::Write(const Ztring& FileName)
+{
+    ErrorMessage.clear();
+
+    // Inputs
+    int64u TrackNumber = 1;
+    video_reader VideoReader;
+    if (Video && !VideoReader.Open(*Video, TrackNumber++))
+    {
+        ErrorMessage = "can not read video stream";
+        return false;
+    }
+    vector<audio_reader> AudioReaders(Audios.size());
+    for (size_t i = 0; i < Audios.size(); i++)
+        if (!AudioReaders[i].Open(Audios[i], TrackNumber++))
+        {
+            ErrorMessage = "can not read audio stream";
+            return false;
+        }
+
+    File F;
+    if (!F.Create(FileName, true))
+    {
+        ErrorMessage = "can not create output file";
+        return false;
+    }
+    int64u Offset = 0;
+    bool WriteError = false;
+    auto Flush = [&](buffer& B)
+    {
+        if (F.Write(B.data(), B.size()) != B.size())
+            WriteError = true;
+        Offset += B.size();
+        B.clear();
+    };
+    buffer B;
+
+    // EBML header
+    {
+        buffer Content;
+        Put_UInt(Content, Id_EBMLVersion, 1);
+        Put_UInt(Content, Id_EBMLReadVersion, 1);
+        Put_UInt(Content, Id_EBMLMaxIDLength, 4);
+        Put_UInt(Content, Id_EBMLMaxSizeLength, 8);
+        Put_String(Content, Id_DocType, "matroska");
+        Put_UInt(Content, Id_DocTypeVersion, 4);
+        Put_UInt(Content, Id_DocTypeReadVersion, 2);
+        Put_Master(B, Id_EBML, Content);
+    }
+
+    // Segment, size is patched at the end
+    Put_Id(B, Id_Segment);
+    auto Segment_SizePos = Offset + B.size();
+    Put_Size(B, 0x00FFFFFFFFFFFFFFULL, 8); // Unknown
+    auto Segment_Begin = Offset + B.size();
+
+    // Place for the seek head, filled at the end
+    static const size_t SeekHead_Reserved = 200;
+    auto SeekHead_Pos = Offset + B.size();
+    Put_Id(B, Id_Void);
+    Put_Size(B, SeekHead_Reserved - 9, 8);
+    B.resize(B.size() + SeekHead_Reserved - 9);
+    vector<pair<int32u, int64u>> Seeks;
+
+    // Info, duration is patched at the end
+    {
+        buffer Content;
+        Put_UInt(Content, Id_TimestampScale, 1000000);
+        Put_String(Content, Id_MuxingApp, App);
+        Put_String(Content, Id_WritingApp, App);
+        Put_Float(Content, Id_Duration, 0);
+        Seeks.push_back({ Id_Info, Offset + B.size() - Segment_Begin });
+        Put_Master(B, Id_Info, Content);
+    }
+    auto Duration_Pos = Offset + B.size() - 8;
+
+    // Tracks
+    {
+        buffer Content;
+        if (Video)
+        {
+            buffer Entry;
+            Put_UInt(Entry, Id_TrackNumber, 1);
+            Put_UInt(Entry, Id_TrackUID, 1);
+            Put_UInt(Entry, Id_TrackType, 1);
+            Put_UInt(Entry, Id_FlagLacing, 0);
+            if (!Video->Language.empty())
+                Put_String(Entry, Id_Language, Video->Language);
+            if (Video->FrameDuration)
+                Put_UInt(Entry, Id_DefaultDuration, Video->FrameDuration);
+            Put_String(Entry, Id_CodecID, "V_MPEG4/ISO/AVC");
+            if (VideoReader.Sps.size() >= 4 && !VideoReader.Pps.empty())
+            {
+                buffer Avcc;
+                Avcc.push_back(1); // configurationVersion
+                Avcc.push_back(VideoReader.Sps[1]); // AVCProfileIndication
+                Avcc.push_back(VideoReader.Sps[2]); // profile_compatibility
+                Avcc.push_back(VideoReader.Sps[3]); // AVCLevelIndication
+                Avcc.push_back(0xFF); // lengthSizeMinusOne = 3
+                Avcc.push_back(0xE1); // 1 SPS
+                Avcc.push_back((int8u)(VideoReader.Sps.size() >> 8));
+                Avcc.push_back((int8u)VideoReader.Sps.size());
+                Avcc.insert(Avcc.end(), VideoReader.Sps.begin(), VideoReader.Sps.end());
+                Avcc.push_back(1); // 1 PPS
+                Avcc.push_back((int8u)(VideoReader.Pps.size() >> 8));
+                Avcc.push_back((int8u)VideoReader.Pps.size());
+                Avcc.insert(Avcc.end(), VideoReader.Pps.begin(), VideoReader.Pps.end());
+                Put_Binary(Entry, Id_CodecPrivate, Avcc.data(), Avcc.size());
+            }
+            if (Video->Width && Video->Height)
+            {
+                buffer Settings;
+                Put_UInt(Settings, Id_PixelWidth, Video->Width);
+                Put_UInt(Settings, Id_PixelHeight, Video->Height);
+                Put_Master(Entry, Id_Video, Settings);
+            }
+            Put_Master(Content, Id_TrackEntry, Entry);
+        }
+        for (size_t i = 0; i < Audios.size(); i++)
+        {
+            const auto& Audio = Audios[i];
+            const auto& Reader = AudioReaders[i];
+            auto Number = (Video ? 2 : 1) + i;
+            buffer Entry;
+            Put_UInt(Entry, Id_TrackNumber, Number);
+            Put_UInt(Entry, Id_TrackUID, Number);
+            Put_UInt(Entry, Id_TrackType, 2);
+            Put_UInt(Entry, Id_FlagDefault, Audio.Default ? 1 : 0);
+            if (Audio.Original)
+                Put_UInt(Entry, Id_FlagOriginal, 1);
+            Put_UInt(Entry, Id_FlagLacing, 0);
+            if (!Audio.Name.empty())
+                Put_String(Entry, Id_Name, Audio.Name);
+            if (!Audio.Language.empty())
+                Put_String(Entry, Id_Language, Audio.Language);
+            Put_String(Entry, Id_CodecID, "A_AAC");
+            auto Asc = Reader.AudioSpecificConfig();
+            Put_Binary(Entry, Id_CodecPrivate, Asc.data(), Asc.size());
+            buffer Settings;
+            Put_Float(Settings, Id_SamplingFrequency, Reader.SamplingFrequency);
+            if (Audio.Sbr)
+                Put_Float(Settings, Id_OutputSamplingFrequency, Reader.SamplingFrequency * 2);
+            Put_UInt(Settings, Id_Channels, Reader.ChannelConfiguration ? Reader.ChannelConfiguration : 1);
+            Put_Master(Entry, Id_Audio, Settings);
+            Put_Master(Content, Id_TrackEntry, Entry);
+        }
+        Seeks.push_back({ Id_Tracks, Offset + B.size() - Segment_Begin });
+        Put_Master(B, Id_Tracks, Content);
+    }
+
+    // Chapters
+    if (!Chapters.empty())
+    {
+        buffer Edition;
+        Put_UInt(Edition, Id_EditionUID, 1);
+        buffer Atom;
+        bool AtomIsOpen = false;
+        auto Chapter = [&](const mkv_chapter& Item, size_t UID)
+        {
+            buffer Display;
+            Put_String(Display, Id_ChapString, Item.Name);
+            Put_String(Display, Id_ChapLanguage, Item.Language.empty() ? string("eng") : Item.Language);
+            buffer Content;
+            Put_UInt(Content, Id_ChapterUID, UID);
+            Put_UInt(Content, Id_ChapterTimeStart, Item.Start * 1000000);
+            Put_Master(Content, Id_ChapterDisplay, Display);
+            return Content;
+        };
+        for (size_t i = 0; i < Chapters.size(); i++)
+        {
+            const auto& Item = Chapters[i];
+            if (Item.IsSub && AtomIsOpen)
+            {
+                Put_Master(Atom, Id_ChapterAtom, Chapter(Item, i + 1));
+                continue;
+            }
+            if (AtomIsOpen)
+                Put_Master(Edition, Id_ChapterAtom, Atom);
+            Atom = Chapter(Item, i + 1);
+            AtomIsOpen = true;
+        }
+        if (AtomIsOpen)
+            Put_Master(Edition, Id_ChapterAtom, Atom);
+        buffer Content;
+        Put_Master(Content, Id_EditionEntry, Edition);
+        Seeks.push_back({ Id_Chapters, Offset + B.size() - Segment_Begin });
+        Put_Master(B, Id_Chapters, Content);
+    }
+
+    // Tags
+    if (!Tags.empty())
+    {
+        buffer Content;
+        for (const auto& Item : Tags)
+        {
+            buffer Simple;
+            Put_String(Simple, Id_TagName, Item.Name);
+            Put_String(Simple, Id_TagString, Item.Value);
+            buffer Tag;
+            Put_Master(Tag, Id_Targets, buffer());
+            Put_Master(Tag, Id_SimpleTag, Simple);
+            Put_Master(Content, Id_Tag, Tag);
+        }
+        Seeks.push_back({ Id_Tags, Offset + B.size() - Segment_Begin });
+        Put_Master(B, Id_Tags, Content);
+    }
+    Flush(B);
+
+    // Clusters
+    struct pending
+    {
+        block       Block;
+        bool        IsValid = false;
+    };
+    vector<pending> Pendings(1 + AudioReaders.size());
+    auto Read = [&](size_t i)
+    {
+        Pendings[i].IsValid = i ? AudioReaders[i - 1].Next(Pendings[i].Block) : (Video && VideoReader.Next(Pendings[i].Block));
+    };
+    for (size_t i = 0; i < Pendings.size(); i++)
+        Read(i);
+    vector<pair<int64s, int64u>> Cues; // Timestamp, cluster position
+    buffer Cluster;
+    int64s Cluster_Timestamp = 0;
+    int64s Segment_Duration = 0;
+    Video_FrameCount = 0;
+    Audio_FrameCounts.assign(AudioReaders.size(), 0);
+    auto Cluster_Flush = [&]()
+    {
+        if (Cluster.empty())
+            return;
+        Put_Id(B, Id_Cluster);
+        Put_Size(B, Cluster.size());
+        Flush(B);
+        Flush(Cluster);
+    };
+    for (;;)
+    {
+        // Next block is the one with the lowest timestamp
+        size_t Next = (size_t)-1;
+        for (size_t i = 0; i < Pendings.size(); i++)
+            if (Pendings[i].IsValid && (Next == (size_t)-1 || Pendings[i].Block.Timestamp < Pendings[Next].Block.Timestamp))
+                Next = i;
+        if (Next == (size_t)-1)
+            break;
+        auto& Block = Pendings[Next].Block;
+        if (Block.Timestamp < 0)
+            Block.Timestamp = 0;
+
+        // New cluster on video key frames (or regularly if no video), and when the relative timestamp would not fit
+        auto Relative = Block.Timestamp - Cluster_Timestamp;
+        bool IsCueTrack = Video ? !Next : Next == 1;
+        if (Cluster.empty()
+         || (IsCueTrack && Block.IsKeyFrame && Relative >= 5000)
+         || Relative > 0x7FFF || Relative < -0x8000)
+        {
+            Cluster_Flush();
+            Cluster_Timestamp = Block.Timestamp;
+            Relative = 0;
+            Put_UInt(Cluster, Id_Timestamp, Cluster_Timestamp);
+            if (IsCueTrack && Block.IsKeyFrame)
+                Cues.push_back({ Cluster_Timestamp, Offset - Segment_Begin });
+        }
+
+        Put_Id(Cluster, Id_SimpleBlock);
+        Put_Size(Cluster, 4 + Block.Data.size());
+        Cluster.push_back((int8u)(0x80 | Block.TrackNumber));
+        Cluster.push_back((int8u)(Relative >> 8));
+        Cluster.push_back((int8u)Relative);
+        Cluster.push_back(Block.IsKeyFrame ? 0x80 : 0x00);
+        Cluster.insert(Cluster.end(), Block.Data.begin(), Block.Data.end());
+        if (Segment_Duration < Block.Timestamp)
+            Segment_Duration = Block.Timestamp;
+        if (Next)
+            Audio_FrameCounts[Next - 1]++;
+        else
+            Video_FrameCount++;
+
+        Read(Next);
+        if (WriteError)
+            break;
+    }
+    Cluster_Flush();
+
+    // Cues
+    if (!Cues.empty())
+    {
+        buffer Content;
+        for (const auto& Item : Cues)
+        {
+            buffer Positions;
+            Put_UInt(Positions, Id_CueTrack, 1);
+            Put_UInt(Positions, Id_CueClusterPosition, Item.second);
+            buffer Point;
+            Put_UInt(Point, Id_CueTime, Item.first);
+            Put_Master(Point, Id_CueTrackPositions, Positions);
+            Put_Master(Content, Id_CuePoint, Point);
+        }
+        Seeks.push_back({ Id_Cues, Offset - Segment_Begin });
+        Put_Master(B, Id_Cues, Content);
+        Flush(B);
+    }
+    auto Segment_Size = Offset - Segment_Begin;
+
+    // Seek head
+    {
+        buffer Content;
+        for (const auto& Item : Seeks)
+        {
+            buffer Seek;
+            buffer SeekID;
+            Put_Id(SeekID, Item.first);
+            Put_Binary(Seek, Id_SeekID, SeekID.data(), SeekID.size());
+            Put_UInt(Seek, Id_SeekPosition, Item.second);
+            Put_Master(Content, Id_Seek, Seek);
+        }
+        Put_Master(B, Id_SeekHead, Content);
+        auto Void_Size = SeekHead_Reserved - B.size() - 9;
+        Put_Id(B, Id_Void);
+        Put_Size(B, Void_Size, 8);
+        B.resize(SeekHead_Reserved);
+        F.GoTo(SeekHead_Pos);
+        Flush(B);
+    }
+
+    // Duration
+    {
+        if (Video && Video->FrameDuration)
+            Segment_Duration += Video->FrameDuration / 1000000;
+        Duration = Segment_Duration;
+        double Value = (double)Segment_Duration;
+        int64u Bits;
+        memcpy(&Bits, &Value, 8);
+        for (size_t i = 8; i--;)
+            B.push_back((int8u)(Bits >> (8 * i)));
+        F.GoTo(Duration_Pos);
+        Flush(B);
+    }
+
+    // Segment size
+    Put_Size(B, Segment_Size, 8);
+    F.GoTo(Segment_SizePos);
+    Flush(B);
+    F.Close();
+
+    if (WriteError)
+    {
+        ErrorMessage = "can not write output file";
+        return false;
+    }
+    return true;
+}
+
+//***************************************************************************
+// Chapters for mkvmerge
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+static Ztring Chapters_Xml_TimeStamp(int64u Start)
+{
+    char Temp[32];
+    snprintf(Temp, sizeof(Temp), "%02u:%02u:%02u.%03u", (unsigned)(Start / 3600000), (unsigned)(Start / 60000 % 60), (unsigned)(Start / 1000 % 60), (unsigned)(Start % 1000));
+    return Ztring().From_UTF8(Temp);
+}
+
+//---------------------------------------------------------------------------
+Ztring Chapters_Xml(const vector<mkv_chapter>& Chapters)
+{
+    if (Chapters.empty())
+        return Ztring();
+
+    Ztring ToReturn;
+    ToReturn += __T("<?xml version=\"1.0\"?>\r\n<Chapters>\r\n  <EditionEntry>\r\n");
+    bool ChapterIsOpen = false;
+    for (const auto& Item : Chapters)
+    {
+        auto TimeStamp = Chapters_Xml_TimeStamp(Item.Start);
+        auto Name = Ztring().From_UTF8(Item.Name);
+        auto Language = Ztring().From_UTF8(Item.Language.empty() ? string("eng") : Item.Language);
+        if (Item.IsSub)
+        {
+            if (!ChapterIsOpen)
+            {
+                ToReturn += __T("    <ChapterAtom>\r\n");
+                ChapterIsOpen = true;
+            }
+            ToReturn += __T("      <ChapterAtom>\r\n");
+            ToReturn += __T("        <ChapterTimeStart>") + TimeStamp + __T("</ChapterTimeStart>\r\n");
+            ToReturn += __T("        <ChapterDisplay>\r\n");
+            ToReturn += __T("          <ChapterString>") + Name + __T("</ChapterString>\r\n");
+            ToReturn += __T("          <ChapterLanguage>") + Language + __T("</ChapterLanguage>\r\n");
+            ToReturn += __T("        </ChapterDisplay>\r\n");
+            ToReturn += __T("      </ChapterAtom>\r\n");
+        }
+        else
+        {
+            if (ChapterIsOpen)
+                ToReturn += __T("    </ChapterAtom>\r\n");
+            else
+                ChapterIsOpen = true;
+            ToReturn += __T("    <ChapterAtom>\r\n");
+            ToReturn += __T("      <ChapterTimeStart>") + TimeStamp + __T("</ChapterTimeStart>\r\n");
+            ToReturn += __T("      <ChapterDisplay>\r\n");
+            ToReturn += __T("        <ChapterString>") + Name + __T("</ChapterString>\r\n");
+            ToReturn += __T("        <ChapterLanguage>") + Language + __T("</ChapterLanguage>\r\n");
+            ToReturn += __T("      </ChapterDisplay>\r\n");
+        }
+    }
+    if (ChapterIsOpen)
+        ToReturn += __T("    </ChapterAtom>\r\n");
+    ToReturn += __T("  </EditionEntry>\r\n</Chapters>\r\n");
+    return ToReturn;
+}
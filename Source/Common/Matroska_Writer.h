@@ -0,0 +1,86 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#pragma once
+#include "ZenLib/Ztring.h"
+#include <string>
+#include <vector>
+using namespace ZenLib;
+using namespace std;
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Input description
+//***************************************************************************
+
+struct mkv_video
+{
+    Ztring          FileName;       // Annex B H.264
+    vector<int32u>  Sizes;          // One item per frame
+    vector<int64u>  Timestamps;     // In ns, one item per frame
+    int64s          Delay = 0;      // In ms
+    int64u          FrameDuration = 0; // In ns
+    int32u          Width = 0;
+    int32u          Height = 0;
+    string          Language;
+};
+
+struct mkv_audio
+{
+    Ztring          FileName;       // ADTS
+    int64s          Delay = 0;      // In ms
+    bool            Sbr = false;    // HE-AAC with implicit SBR
+    bool            Default = false;
+    bool            Original = false;
+    string          Language;
+    string          Name;
+};
+
+struct mkv_chapter
+{
+    int64u          Start = 0;      // In ms
+    string          Name;
+    string          Language;
+    bool            IsSub = false;  // Sub-chapter of the previous chapter
+};
+
+struct mkv_tag
+{
+    string          Name;
+    string          Value;
+};
+
+//***************************************************************************
+// Class matroska_writer
+//***************************************************************************
+
+class matroska_writer
+{
+public:
+    // Input
+    string              App;
+    mkv_video*          Video = nullptr;
+    vector<mkv_audio>   Audios;
+    vector<mkv_chapter> Chapters;
+    vector<mkv_tag>     Tags;
+
+    // Process
+    bool                Write(const Ztring& FileName);
+
+    // Output
+    string              ErrorMessage;
+    size_t              Video_FrameCount = 0;
+    vector<size_t>      Audio_FrameCounts;
+    int64u              Duration = 0;   // In ms
+};
+
+//***************************************************************************
+// Chapters for mkvmerge
+//***************************************************************************
+
+// Chapter file in mkvmerge XML format
+Ztring Chapters_Xml(const vector<mkv_chapter>& Chapters);
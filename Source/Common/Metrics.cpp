@@ -0,0 +1,154 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#include "Common/Metrics.h"
+#include "Common/File_Publish.h"
+#include "ZenLib/File.h"
+#include <string>
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Constants
+//***************************************************************************
+
+struct metric_info
+{
+    const char*         Name;
+    const char*         Labels;
+    const char*         Type;
+    const char*         Help;
+};
+
+// Items with the same name are consecutive
+static const metric_info Metric_Infos[Metric_Max] =
+{
+    { "leavesd_files",                  "",                         "gauge",    "Files to convert." },
+    { "leavesd_temp_bytes",             "{location=\"disk\"}",      "gauge",    "Estimated size of temporary files of the files in progress." },
+    { "leavesd_temp_bytes",             "{location=\"memory\"}",    "gauge",    nullptr },
+    { "leavesd_files_finished_total",   "",                         "counter",  "Files finished, including files with errors and skipped files." },
+    { "leavesd_files_error_total",      "",                         "counter",  "Files finished with errors." },
+    { "leavesd_files_warning_total",    "",                         "counter",  "Files finished with warnings." },
+    { "leavesd_files_skipped_total",    "",                         "counter",  "Files skipped, output already present." },
+    { "leavesd_demuxed_bytes_total",    "{stream=\"video\"}",       "counter",  "Bytes of demuxed packets." },
+    { "leavesd_demuxed_bytes_total",    "{stream=\"audio\"}",       "counter",  nullptr },
+    { "leavesd_demuxed_packets_total",  "{stream=\"video\"}",       "counter",  "Demuxed packets." },
+    { "leavesd_demuxed_packets_total",  "{stream=\"audio\"}",       "counter",  nullptr },
+    { "leavesd_aac_invalid_syncs_total","",                         "counter",  "Invalid AAC syncs in audio packets, skipped." },
+    { "leavesd_aac_replaced_total",     "",                         "counter",  "Invalid AAC packets, replaced by silence." },
+    { "leavesd_junk_bytes_total",       "",                         "counter",  "Junk bytes in input files." },
+};
+
+//***************************************************************************
+// Constructor/Destructor
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+metrics::metrics()
+{
+    for (auto& Value : Values)
+        Value = 0;
+    for (auto& Value : Workers)
+        Value = 0;
+}
+
+//---------------------------------------------------------------------------
+metrics::~metrics()
+{
+    Stop();
+}
+
+//***************************************************************************
+// Snapshots
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+bool metrics::Start()
+{
+    if (FileName.empty() || Thread.joinable())
+        return false;
+    if (!Write())
+        return false;
+
+    Stopping = false;
+    Thread = thread([this]()
+    {
+        unique_lock<mutex> Lock(Mutex);
+        while (!Stopping_Changed.wait_for(Lock, chrono::seconds(Interval), [this]() { return Stopping; }))
+        {
+            Lock.unlock();
+            Write();
+            Lock.lock();
+        }
+    });
+    return true;
+}
+
+//---------------------------------------------------------------------------
+void metrics::Stop()
+{
+    if (!Thread.joinable())
+        return;
+
+    {
+        const lock_guard<mutex> Lock(Mutex);
+        Stopping = true;
+    }
+    Stopping_Changed.notify_all();
+    Thread.join();
+    Write();
+}
+
+//---------------------------------------------------------------------------
+bool metrics::Write()
+{
+    if (FileName.empty())
+        return true;
+
+    string Content;
+    for (size_t i = 0; i < Metric_Max; i++)
+    {
+        const auto& Info = Metric_Infos[i];
+        if (Info.Help)
+        {
+            Content += string("# HELP ") + Info.Name + ' ' + Info.Help + '\n';
+            Content += string("# TYPE ") + Info.Name + ' ' + Info.Type + '\n';
+        }
+        Content += string(Info.Name) + Info.Labels + ' ' + to_string(Values[i].load(memory_order_relaxed)) + '\n';
+    }
+
+    Content += "# HELP leavesd_workers_busy Threads processing a file, per stage.\n";
+    Content += "# TYPE leavesd_workers_busy gauge\n";
+    for (size_t i = 0; i < Stage_Max; i++)
+        Content += string("leavesd_workers_busy{stage=\"") + Stage_Name((stage)i) + "\"} " + to_string(Workers[i].load(memory_order_relaxed)) + '\n';
+
+    // Rate since previous snapshot
+    auto Now = chrono::steady_clock::now();
+    auto Bytes = Values[Metric_Bytes_Video].load(memory_order_relaxed) + Values[Metric_Bytes_Audio].load(memory_order_relaxed);
+    double Rate = 0;
+    if (Previous_Time != chrono::steady_clock::time_point())
+    {
+        auto Seconds = chrono::duration<double>(Now - Previous_Time).count();
+        if (Seconds > 0)
+            Rate = (Bytes - Previous_Bytes) / Seconds;
+    }
+    Previous_Time = Now;
+    Previous_Bytes = Bytes;
+    Content += "# HELP leavesd_demuxed_bytes_per_second Demux throughput since previous snapshot.\n";
+    Content += "# TYPE leavesd_demuxed_bytes_per_second gauge\n";
+    Content += "leavesd_demuxed_bytes_per_second " + to_string((int64u)Rate) + '\n';
+
+    // Scrapers never see a partial file
+    Ztring FileName_Temp = FileName + __T(".tmp");
+    File F;
+    if (!F.Create(FileName_Temp))
+        return false;
+    auto Written = F.Write((const int8u*)Content.data(), Content.size());
+    F.Close();
+    if (Written != Content.size())
+        return false;
+    return File_Publish(FileName_Temp, FileName, true);
+}
@@ -0,0 +1,83 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#pragma once
+#include "Common/Scheduler.h"
+#include "ZenLib/Ztring.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+using namespace ZenLib;
+using namespace std;
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Metrics
+//***************************************************************************
+
+enum metric
+{
+    Metric_Files,                   // Gauges
+    Metric_TempBytes_Disk,
+    Metric_TempBytes_Memory,
+    Metric_Files_Finished,          // Counters
+    Metric_Files_Error,
+    Metric_Files_Warning,
+    Metric_Files_Skipped,
+    Metric_Bytes_Video,
+    Metric_Bytes_Audio,
+    Metric_Packets_Video,
+    Metric_Packets_Audio,
+    Metric_Aac_InvalidSyncs,
+    Metric_Aac_Replaced,
+    Metric_JunkBytes,
+    Metric_Max
+};
+
+//***************************************************************************
+// Class metrics
+//***************************************************************************
+
+// Counters updated by jobs without lock, snapshots written periodically in Prometheus text format (node_exporter textfile collector)
+class metrics
+{
+public:
+    metrics();
+    ~metrics();
+
+    // Config
+    Ztring              FileName;
+    size_t              Interval = 15;      // In seconds
+
+    // Values
+    void                Add(metric Metric, int64u Value = 1) { Values[Metric].fetch_add(Value, memory_order_relaxed); }
+    void                Sub(metric Metric, int64u Value) { Values[Metric].fetch_sub(Value, memory_order_relaxed); }
+    void                Set(metric Metric, int64u Value) { Values[Metric].store(Value, memory_order_relaxed); }
+    void                Worker_Begin(stage Stage) { Workers[Stage].fetch_add(1, memory_order_relaxed); }
+    void                Worker_End(stage Stage) { Workers[Stage].fetch_sub(1, memory_order_relaxed); }
+
+    // Snapshots
+    bool                Start();            // A snapshot every Interval
+    void                Stop();             // Last snapshot
+    bool                Write();
+
+private:
+    atomic<int64u>      Values[Metric_Max];
+    atomic<int64u>      Workers[Stage_Max];
+
+    // Rate
+    chrono::steady_clock::time_point Previous_Time;
+    int64u              Previous_Bytes = 0;
+
+    // Snapshot thread
+    thread              Thread;
+    mutex               Mutex;
+    condition_variable  Stopping_Changed;
+    bool                Stopping = false;
+};
@@ -0,0 +1,282 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#include "Common/Pattern_Scanner.h"
+#include <cstring>
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define PATTERNSCANNER_SSE2
+    #include <immintrin.h>
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+        #define PATTERNSCANNER_AVX2
+        #define PATTERNSCANNER_AVX2_TARGET
+    #elif defined(__GNUC__)
+        #define PATTERNSCANNER_AVX2
+        #define PATTERNSCANNER_AVX2_TARGET __attribute__((target("avx2")))
+    #endif
+#endif
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Known patterns
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+// SPS found in some files, 0x0C at offset 0x16 has to be 0x0B
+static const int8u SpsPatch_0_Data[] = { 0x00, 0x00, 0x01, 0x67, 0x64, 0x00, 0x0D, 0xAC, 0x34, 0xE8, 0x16, 0x09, 0x6C, 0x04, 0x40, 0x00, 0x00, 0x03, 0x00, 0x40, 0x00, 0x00, 0x0C, 0xA3, 0xC5, 0x0A, 0xA8, 0x00, 0x00, 0x00, 0x01 };
+
+//---------------------------------------------------------------------------
+const sps_patch SpsPatches[] =
+{
+    { SpsPatch_0_Data, sizeof(SpsPatch_0_Data), 0x16, 0x0B },
+};
+const size_t SpsPatches_Size = sizeof(SpsPatches) / sizeof(*SpsPatches);
+
+//***************************************************************************
+// Helpers
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+#ifdef PATTERNSCANNER_SSE2
+static inline size_t CountTrailingZeros(unsigned int Value)
+{
+    #if defined(_MSC_VER)
+        unsigned long Index;
+        _BitScanForward(&Index, Value);
+        return Index;
+    #else
+        return __builtin_ctz(Value);
+    #endif
+}
+#endif
+
+//---------------------------------------------------------------------------
+#ifdef PATTERNSCANNER_AVX2
+static bool Avx2_IsSupported()
+{
+    #if defined(_MSC_VER)
+        int Info[4];
+        __cpuid(Info, 0);
+        if (Info[0] < 7)
+            return false;
+        __cpuid(Info, 1);
+        if (!(Info[2] & (1 << 27)) || !(Info[2] & (1 << 28))) // OSXSAVE and AVX
+            return false;
+        if ((_xgetbv(0) & 6) != 6) // XMM and YMM states saved by the OS
+            return false;
+        __cpuidex(Info, 7, 0);
+        return (Info[1] & (1 << 5)) != 0;
+    #else
+        __builtin_cpu_init(); // Needed before constructors run
+        return __builtin_cpu_supports("avx2");
+    #endif
+}
+static const bool Avx2_Supported = Avx2_IsSupported();
+#endif
+
+//***************************************************************************
+// Pattern
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+// Candidates are positions where both the first and the last bytes of the pattern match, then the middle is compared
+static size_t Pattern_Find_Scalar(const int8u* Buffer, size_t Buffer_Size, const int8u* Pattern, size_t Pattern_Size)
+{
+    if (Buffer_Size < Pattern_Size)
+        return (size_t)-1;
+    const auto Last = Pattern[Pattern_Size - 1];
+    const auto Max = Buffer_Size - Pattern_Size;
+    size_t i = 0;
+    while (i <= Max)
+    {
+        auto Candidate = (const int8u*)memchr(Buffer + i, Pattern[0], Max + 1 - i);
+        if (!Candidate)
+            break;
+        i = Candidate - Buffer;
+        if (Buffer[i + Pattern_Size - 1] == Last && !memcmp(Buffer + i + 1, Pattern + 1, Pattern_Size - 2))
+            return i;
+        i++;
+    }
+    return (size_t)-1;
+}
+
+//---------------------------------------------------------------------------
+#ifdef PATTERNSCANNER_SSE2
+static size_t Pattern_Find_SSE2(const int8u* Buffer, size_t Buffer_Size, const int8u* Pattern, size_t Pattern_Size)
+{
+    const auto First = _mm_set1_epi8((char)Pattern[0]);
+    const auto Last = _mm_set1_epi8((char)Pattern[Pattern_Size - 1]);
+    const auto Count = Buffer_Size - Pattern_Size + 1; // Count of possible start positions
+    size_t i = 0;
+    for (; i + 16 <= Count; i += 16)
+    {
+        auto Block_First = _mm_loadu_si128((const __m128i*)(Buffer + i));
+        auto Block_Last = _mm_loadu_si128((const __m128i*)(Buffer + i + Pattern_Size - 1));
+        auto Mask = (unsigned int)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(First, Block_First), _mm_cmpeq_epi8(Last, Block_Last)));
+        while (Mask)
+        {
+            auto Pos = i + CountTrailingZeros(Mask);
+            if (!memcmp(Buffer + Pos + 1, Pattern + 1, Pattern_Size - 2))
+                return Pos;
+            Mask &= Mask - 1;
+        }
+    }
+    auto Pos = Pattern_Find_Scalar(Buffer + i, Buffer_Size - i, Pattern, Pattern_Size);
+    return Pos == (size_t)-1 ? Pos : (i + Pos);
+}
+#endif
+
+//---------------------------------------------------------------------------
+#ifdef PATTERNSCANNER_AVX2
+PATTERNSCANNER_AVX2_TARGET
+static size_t Pattern_Find_AVX2(const int8u* Buffer, size_t Buffer_Size, const int8u* Pattern, size_t Pattern_Size)
+{
+    const auto First = _mm256_set1_epi8((char)Pattern[0]);
+    const auto Last = _mm256_set1_epi8((char)Pattern[Pattern_Size - 1]);
+    const auto Count = Buffer_Size - Pattern_Size + 1; // Count of possible start positions
+    size_t i = 0;
+    for (; i + 32 <= Count; i += 32)
+    {
+        auto Block_First = _mm256_loadu_si256((const __m256i*)(Buffer + i));
+        auto Block_Last = _mm256_loadu_si256((const __m256i*)(Buffer + i + Pattern_Size - 1));
+        auto Mask = (unsigned int)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(First, Block_First), _mm256_cmpeq_epi8(Last, Block_Last)));
+        while (Mask)
+        {
+            auto Pos = i + CountTrailingZeros(Mask);
+            if (!memcmp(Buffer + Pos + 1, Pattern + 1, Pattern_Size - 2))
+                return Pos;
+            Mask &= Mask - 1;
+        }
+    }
+    auto Pos = Pattern_Find_SSE2(Buffer + i, Buffer_Size - i, Pattern, Pattern_Size);
+    return Pos == (size_t)-1 ? Pos : (i + Pos);
+}
+#endif
+
+//---------------------------------------------------------------------------
+size_t Pattern_Find(const int8u* Buffer, size_t Buffer_Size, const int8u* Pattern, size_t Pattern_Size)
+{
+    if (Pattern_Size > Buffer_Size)
+        return (size_t)-1;
+    if (Pattern_Size < 2)
+    {
+        if (!Pattern_Size)
+            return 0;
+        auto Candidate = (const int8u*)memchr(Buffer, Pattern[0], Buffer_Size);
+        return Candidate ? (Candidate - Buffer) : (size_t)-1;
+    }
+
+    #ifdef PATTERNSCANNER_AVX2
+        if (Avx2_Supported)
+            return Pattern_Find_AVX2(Buffer, Buffer_Size, Pattern, Pattern_Size);
+    #endif
+    #ifdef PATTERNSCANNER_SSE2
+        return Pattern_Find_SSE2(Buffer, Buffer_Size, Pattern, Pattern_Size);
+    #else
+        return Pattern_Find_Scalar(Buffer, Buffer_Size, Pattern, Pattern_Size);
+    #endif
+}
+
+//---------------------------------------------------------------------------
+size_t SpsPatch_Find(const int8u* Buffer, size_t Buffer_Size, const sps_patch*& Patch)
+{
+    size_t ToReturn = (size_t)-1;
+    Patch = nullptr;
+    for (size_t i = 0; i < SpsPatches_Size; i++)
+    {
+        // Only the part before the current best match is interesting
+        const auto& Item = SpsPatches[i];
+        auto Limit = Buffer_Size;
+        if (ToReturn != (size_t)-1 && ToReturn + Item.Size < Limit)
+            Limit = ToReturn + Item.Size - 1;
+        auto Pos = Pattern_Find(Buffer, Limit, Item.Data, Item.Size);
+        if (Pos < ToReturn)
+        {
+            ToReturn = Pos;
+            Patch = &Item;
+        }
+    }
+    return ToReturn;
+}
+
+//***************************************************************************
+// ADTS
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+static size_t AdtsSync_Find_Scalar(const int8u* Buffer, size_t Buffer_Size)
+{
+    size_t i = 0;
+    while (i + 1 < Buffer_Size)
+    {
+        auto Candidate = (const int8u*)memchr(Buffer + i, 0xFF, Buffer_Size - 1 - i);
+        if (!Candidate)
+            break;
+        i = Candidate - Buffer;
+        if ((Buffer[i + 1] & 0xF6) == 0xF0)
+            return i;
+        i++;
+    }
+    return (size_t)-1;
+}
+
+//---------------------------------------------------------------------------
+#ifdef PATTERNSCANNER_SSE2
+static size_t AdtsSync_Find_SSE2(const int8u* Buffer, size_t Buffer_Size)
+{
+    const auto Sync1 = _mm_set1_epi8((char)0xFF);
+    const auto Sync2_Mask = _mm_set1_epi8((char)0xF6);
+    const auto Sync2 = _mm_set1_epi8((char)0xF0);
+    size_t i = 0;
+    for (; i + 17 <= Buffer_Size; i += 16)
+    {
+        auto Block1 = _mm_loadu_si128((const __m128i*)(Buffer + i));
+        auto Block2 = _mm_loadu_si128((const __m128i*)(Buffer + i + 1));
+        auto Mask = (unsigned int)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(Block1, Sync1), _mm_cmpeq_epi8(_mm_and_si128(Block2, Sync2_Mask), Sync2)));
+        if (Mask)
+            return i + CountTrailingZeros(Mask);
+    }
+    auto Pos = AdtsSync_Find_Scalar(Buffer + i, Buffer_Size - i);
+    return Pos == (size_t)-1 ? Pos : (i + Pos);
+}
+#endif
+
+//---------------------------------------------------------------------------
+#ifdef PATTERNSCANNER_AVX2
+PATTERNSCANNER_AVX2_TARGET
+static size_t AdtsSync_Find_AVX2(const int8u* Buffer, size_t Buffer_Size)
+{
+    const auto Sync1 = _mm256_set1_epi8((char)0xFF);
+    const auto Sync2_Mask = _mm256_set1_epi8((char)0xF6);
+    const auto Sync2 = _mm256_set1_epi8((char)0xF0);
+    size_t i = 0;
+    for (; i + 33 <= Buffer_Size; i += 32)
+    {
+        auto Block1 = _mm256_loadu_si256((const __m256i*)(Buffer + i));
+        auto Block2 = _mm256_loadu_si256((const __m256i*)(Buffer + i + 1));
+        auto Mask = (unsigned int)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(Block1, Sync1), _mm256_cmpeq_epi8(_mm256_and_si256(Block2, Sync2_Mask), Sync2)));
+        if (Mask)
+            return i + CountTrailingZeros(Mask);
+    }
+    auto Pos = AdtsSync_Find_SSE2(Buffer + i, Buffer_Size - i);
+    return Pos == (size_t)-1 ? Pos : (i + Pos);
+}
+#endif
+
+//---------------------------------------------------------------------------
+size_t AdtsSync_Find(const int8u* Buffer, size_t Buffer_Size)
+{
+    #ifdef PATTERNSCANNER_AVX2
+        if (Avx2_Supported)
+            return AdtsSync_Find_AVX2(Buffer, Buffer_Size);
+    #endif
+    #ifdef PATTERNSCANNER_SSE2
+        return AdtsSync_Find_SSE2(Buffer, Buffer_Size);
+    #else
+        return AdtsSync_Find_Scalar(Buffer, Buffer_Size);
+    #endif
+}
@@ -0,0 +1,35 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#pragma once
+#include "ZenLib/Conf.h"
+#include <cstddef>
+using namespace ZenLib;
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Known patterns
+//***************************************************************************
+
+struct sps_patch
+{
+    const int8u*    Data;
+    size_t          Size;
+    size_t          Offset; // Position of the byte to rewrite, relative to the beginning of the pattern
+    int8u           ReplacedBy;
+};
+extern const sps_patch  SpsPatches[];
+extern const size_t     SpsPatches_Size;
+
+//***************************************************************************
+// Scanning (SSE2/AVX2 when available, scalar otherwise)
+//***************************************************************************
+
+// All functions return (size_t)-1 if nothing is found
+size_t Pattern_Find(const int8u* Buffer, size_t Buffer_Size, const int8u* Pattern, size_t Pattern_Size);
+size_t SpsPatch_Find(const int8u* Buffer, size_t Buffer_Size, const sps_patch*& Patch);
+size_t AdtsSync_Find(const int8u* Buffer, size_t Buffer_Size); // 0xFF 0xF? with layer 0, 2 bytes must be available
@@ -0,0 +1,154 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#include "Common/Platform.h"
+#include "ZenLib/File.h"
+#include <vector>
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <cstdlib>
+    #include <unistd.h>
+    #ifdef __linux__
+        #include <sched.h>
+    #endif
+    #ifdef __APPLE__
+        #include <climits>
+        #include <mach-o/dyld.h>
+    #endif
+#endif
+using namespace std;
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Paths
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+Ztring Platform_ExePath()
+{
+    Ztring Path;
+    #ifdef _WIN32
+        vector<wchar_t> Buffer(MAX_PATH + 1);
+        for (;;)
+        {
+            auto Size = GetModuleFileNameW(nullptr, Buffer.data(), (DWORD)Buffer.size());
+            if (!Size)
+                return Ztring();
+            if (Size < Buffer.size())
+                break;
+            Buffer.resize(Buffer.size() * 2); // Truncated
+        }
+        Path.From_Unicode(Buffer.data());
+    #elif defined(__APPLE__)
+        uint32_t Size = 0;
+        _NSGetExecutablePath(nullptr, &Size);
+        vector<char> Buffer(Size + 1);
+        if (_NSGetExecutablePath(Buffer.data(), &Size))
+            return Ztring();
+        vector<char> Resolved(PATH_MAX + 1);
+        Path.From_Local(realpath(Buffer.data(), Resolved.data()) ? Resolved.data() : Buffer.data());
+    #else
+        vector<char> Buffer(4096);
+        for (;;)
+        {
+            auto Size = readlink("/proc/self/exe", Buffer.data(), Buffer.size());
+            if (Size <= 0)
+                return Ztring();
+            if ((size_t)Size < Buffer.size())
+            {
+                Path.From_Local(Buffer.data(), (size_t)Size);
+                break;
+            }
+            Buffer.resize(Buffer.size() * 2); // Truncated
+        }
+    #endif
+
+    auto SlashPos = Path.find_last_of(__T("/\\"));
+    if (SlashPos == string::npos)
+        return Ztring();
+    Path.resize(SlashPos + 1);
+    return Path;
+}
+
+//---------------------------------------------------------------------------
+Ztring Platform_TempPath()
+{
+    Ztring Path;
+    #ifdef _WIN32
+        wchar_t Buffer[MAX_PATH + 2] = { 0 };
+        if (GetTempPathW(MAX_PATH + 1, Buffer))
+            Path.From_Unicode(Buffer);
+    #else
+        auto TmpDir = getenv("TMPDIR");
+        if (TmpDir && *TmpDir)
+            Path.From_Local(TmpDir);
+        else
+            Path = __T("/tmp");
+    #endif
+
+    if (!Path.empty() && !IsPathSeparator(Path.back()))
+        Path += PathSeparator;
+    return Path;
+}
+
+//---------------------------------------------------------------------------
+Ztring Platform_ToolPath(const Ztring& ExePath, const Ztring& Name)
+{
+    #ifdef _WIN32
+        return ExePath + Name;
+    #else
+        Ztring Name_NoExt(Name);
+        if (Name_NoExt.size() > 4 && !Name_NoExt.compare(Name_NoExt.size() - 4, 4, __T(".exe")))
+            Name_NoExt.resize(Name_NoExt.size() - 4);
+        Ztring Path(ExePath + Name_NoExt);
+        if (File::Exists(Path))
+            return Path;
+        if (Name_NoExt.find(__T('/')) != string::npos)
+            return Path; // Relative path, not for PATH lookup
+        return Name_NoExt; // Tools installed by the system
+    #endif
+}
+
+//***************************************************************************
+// System
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+size_t Platform_ProcessorCount()
+{
+    size_t Count = 0;
+    #ifdef _WIN32
+        SYSTEM_INFO SystemInfo;
+        GetSystemInfo(&SystemInfo);
+        Count = SystemInfo.dwNumberOfProcessors;
+    #else
+        #ifdef __linux__
+            // Affinity set by the scheduler or a container
+            cpu_set_t Set;
+            if (!sched_getaffinity(0, sizeof(Set), &Set))
+                Count = CPU_COUNT(&Set);
+        #endif
+        if (!Count)
+        {
+            auto Online = sysconf(_SC_NPROCESSORS_ONLN);
+            if (Online > 0)
+                Count = (size_t)Online;
+        }
+    #endif
+    return Count ? Count : 1;
+}
+
+//---------------------------------------------------------------------------
+size_t Platform_ProcessId()
+{
+    #ifdef _WIN32
+        return (size_t)GetCurrentProcessId();
+    #else
+        return (size_t)getpid();
+    #endif
+}
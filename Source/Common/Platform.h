@@ -0,0 +1,45 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#pragma once
+#include "ZenLib/Ztring.h"
+using namespace ZenLib;
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Paths
+//***************************************************************************
+
+#ifdef _WIN32
+    const Char PathSeparator = __T('\\');
+#else
+    const Char PathSeparator = __T('/');
+#endif
+
+// Both separators are accepted in input paths
+inline bool IsPathSeparator(Char Value) { return Value == __T('/') || Value == __T('\\'); }
+
+// Directory of the running executable, with a trailing separator, empty if unknown
+Ztring Platform_ExePath();
+
+// Directory for temporary files, with a trailing separator
+Ztring Platform_TempPath();
+
+// Executable of an external tool, from its name in a template (e.g. "faad.exe")
+// Windows: in the directory of LeaveSD
+// Others: without the .exe extension, in the directory of LeaveSD if present there, else found with PATH
+Ztring Platform_ToolPath(const Ztring& ExePath, const Ztring& Name);
+
+//***************************************************************************
+// System
+//***************************************************************************
+
+// Count of logical processors available to the process, at least 1
+size_t Platform_ProcessorCount();
+
+// Identifier of the running process
+size_t Platform_ProcessId();
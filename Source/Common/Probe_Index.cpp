@@ -0,0 +1,243 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#include "Common/Probe_Index.h"
+#include <cstdlib>
+#include <vector>
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Constants
+//***************************************************************************
+
+// One line per probed file, tab separated, later lines replace previous ones
+static const char* Index_Header = "LeaveSD probe index v1";
+
+enum index_field
+{
+    Field_Path,
+    Field_Size,
+    Field_Modified,
+    Field_Format,
+    Field_Flags,            // Video present, video profile, audio present, audio version, crash
+    Field_Audio_Format,
+    Field_Audio_Channels,
+    Field_Duration,
+    Field_Video_FrameCount,
+    Field_Audio_FrameCount,
+    Field_Debug_Speakers,
+    Field_Max
+};
+
+//***************************************************************************
+// Helpers
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+static string Field(const Ztring& Value)
+{
+    auto ToReturn = Value.To_UTF8();
+    for (auto& Item : ToReturn)
+        if (Item == '\t' || Item == '\r' || Item == '\n')
+            Item = ' ';
+    return ToReturn;
+}
+
+//***************************************************************************
+// Content
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+Ztring probe_index::Load()
+{
+    if (FileName.empty())
+        return Ztring();
+
+    // Lines of the shared index are older than the lines of this index
+    if (!SharedFileName.empty() && SharedFileName != FileName)
+    {
+        size_t Shared_Lines = 0;
+        if (Read(SharedFileName, Shared_Lines) == Read_Unknown)
+        {
+            FileName.clear(); // Not used
+            return SharedFileName;
+        }
+    }
+
+    // Rewritten if not valid, else new lines are appended
+    switch (Read(FileName, Lines))
+    {
+        case Read_Valid:
+            break;
+        case Read_Rewrite:
+            Lines = 0;
+            Save();
+            break;
+        case Read_Unknown:
+            {
+                Lines = 0;
+                auto Unknown = FileName;
+                FileName.clear(); // Not overwritten by Save()
+                return Unknown;
+            }
+    }
+    return Ztring();
+}
+
+//---------------------------------------------------------------------------
+probe_index::read_result probe_index::Read(const Ztring& Name, size_t& Name_Lines)
+{
+    string Content;
+    File In;
+    if (In.Open(Name))
+    {
+        int8u Buffer[65536];
+        while (auto Size = In.Read(Buffer, sizeof(Buffer)))
+            Content.append((const char*)Buffer, Size);
+        In.Close();
+    }
+
+    // Only an empty or missing file may be replaced by a new index
+    if (Content.empty())
+        return Read_Rewrite;
+    string Header(Index_Header);
+    Header += '\n';
+    if (Content.compare(0, Header.size(), Header))
+        return Read_Unknown;
+
+    bool IsValid = Content.back() == '\n'; // Last line is incomplete if a run was interrupted
+    size_t Begin = 0;
+    while (Begin < Content.size())
+    {
+        auto End = Content.find('\n', Begin);
+        if (End == string::npos)
+            break;
+        auto Line = Content.substr(Begin, End - Begin);
+        Begin = End + 1;
+        if (!Name_Lines++)
+            continue; // Header
+
+        vector<string> Fields;
+        size_t Field_Begin = 0;
+        for (;;)
+        {
+            auto Field_End = Line.find('\t', Field_Begin);
+            Fields.push_back(Line.substr(Field_Begin, Field_End - Field_Begin));
+            if (Field_End == string::npos)
+                break;
+            Field_Begin = Field_End + 1;
+        }
+        if (Fields.size() != Field_Max || Fields[Field_Flags].size() != 5)
+            continue;
+
+        item Item;
+        Item.Size = strtoull(Fields[Field_Size].c_str(), nullptr, 10);
+        Item.Modified.From_UTF8(Fields[Field_Modified]);
+        auto& Result = Item.Result;
+        Result.Format.From_UTF8(Fields[Field_Format]);
+        Result.Video_IsPresent = Fields[Field_Flags][0] == '1';
+        Result.Video_HasProfile = Fields[Field_Flags][1] == '1';
+        Result.Audio_IsPresent = Fields[Field_Flags][2] == '1';
+        Result.Audio_HasVersion = Fields[Field_Flags][3] == '1';
+        Result.Crash = Fields[Field_Flags][4] == '1';
+        Result.Audio_Format.From_UTF8(Fields[Field_Audio_Format]);
+        Result.Audio_Channels.From_UTF8(Fields[Field_Audio_Channels]);
+        Result.Duration = strtoull(Fields[Field_Duration].c_str(), nullptr, 10);
+        Result.Video_FrameCount = strtoull(Fields[Field_Video_FrameCount].c_str(), nullptr, 10);
+        Result.Audio_FrameCount = strtoull(Fields[Field_Audio_FrameCount].c_str(), nullptr, 10);
+        Result.Debug_Speakers.From_UTF8(Fields[Field_Debug_Speakers]);
+        Ztring Path;
+        Path.From_UTF8(Fields[Field_Path]);
+        Items[Path] = Item;
+    }
+    return IsValid ? Read_Valid : Read_Rewrite;
+}
+
+//---------------------------------------------------------------------------
+bool probe_index::Get(const Ztring& Path, probe_result& Result)
+{
+    if (FileName.empty())
+        return false;
+
+    auto Size = File::Size_Get(Path);
+    auto Modified = File::Modified_Get(Path);
+
+    const lock_guard<mutex> Lock(Mutex);
+    auto Item = Items.find(Path);
+    if (Item == Items.end() || Item->second.Size != Size || Item->second.Modified != Modified || Modified.empty())
+        return false;
+    Result = Item->second.Result;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+void probe_index::Set(const Ztring& Path, const probe_result& Result)
+{
+    if (FileName.empty())
+        return;
+
+    item Item;
+    Item.Size = File::Size_Get(Path);
+    Item.Modified = File::Modified_Get(Path);
+    Item.Result = Result;
+    auto Content = Line(Path, Item);
+
+    const lock_guard<mutex> Lock(Mutex);
+    Items[Path] = Item;
+    if (!F.Opened_Get() && !F.Open(FileName, File::Access_Write_Append))
+        return;
+    F.Write((const int8u*)Content.data(), Content.size());
+    Lines++;
+}
+
+//---------------------------------------------------------------------------
+void probe_index::Save()
+{
+    if (FileName.empty())
+        return;
+
+    const lock_guard<mutex> Lock(Mutex);
+    F.Close();
+    if (Lines && Lines == Items.size() + 1)
+        return; // No obsolete line
+
+    string Content(Index_Header);
+    Content += '\n';
+    for (const auto& Item : Items)
+        Content += Line(Item.first, Item.second);
+
+    File Out;
+    if (!Out.Create(FileName))
+        return;
+    Out.Write((const int8u*)Content.data(), Content.size());
+    Out.Close();
+    Lines = Items.size() + 1;
+}
+
+//---------------------------------------------------------------------------
+string probe_index::Line(const Ztring& Path, const item& Item)
+{
+    const auto& Result = Item.Result;
+    string ToReturn;
+    ToReturn += Field(Path) + '\t';
+    ToReturn += to_string(Item.Size) + '\t';
+    ToReturn += Field(Item.Modified) + '\t';
+    ToReturn += Field(Result.Format) + '\t';
+    ToReturn += Result.Video_IsPresent ? '1' : '0';
+    ToReturn += Result.Video_HasProfile ? '1' : '0';
+    ToReturn += Result.Audio_IsPresent ? '1' : '0';
+    ToReturn += Result.Audio_HasVersion ? '1' : '0';
+    ToReturn += Result.Crash ? '1' : '0';
+    ToReturn += '\t';
+    ToReturn += Field(Result.Audio_Format) + '\t';
+    ToReturn += Field(Result.Audio_Channels) + '\t';
+    ToReturn += to_string(Result.Duration) + '\t';
+    ToReturn += to_string(Result.Video_FrameCount) + '\t';
+    ToReturn += to_string(Result.Audio_FrameCount) + '\t';
+    ToReturn += Field(Result.Debug_Speakers) + '\n';
+    return ToReturn;
+}
@@ -0,0 +1,75 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#pragma once
+#include "ZenLib/File.h"
+#include "ZenLib/Ztring.h"
+#include <map>
+#include <mutex>
+#include <string>
+using namespace ZenLib;
+using namespace std;
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Probe result
+//***************************************************************************
+
+struct probe_result
+{
+    Ztring              Format;
+    bool                Video_IsPresent = false;
+    bool                Video_HasProfile = false;
+    bool                Audio_IsPresent = false;
+    bool                Audio_HasVersion = false;
+    bool                Crash = false;              // Exception during parsing
+    Ztring              Audio_Format;
+    Ztring              Audio_Channels;
+    int64u              Duration = 0;               // In ms
+    int64u              Video_FrameCount = 0;
+    int64u              Audio_FrameCount = 0;
+    Ztring              Debug_Speakers;
+};
+
+//***************************************************************************
+// Class probe_index
+//***************************************************************************
+
+// Probe results of previous runs, a result is valid only if size and modification date of the file did not change
+class probe_index
+{
+public:
+    // Input
+    Ztring              FileName;                   // Empty means no index
+    Ztring              SharedFileName;             // Read only, e.g. the index of a scan when each process has its own index
+
+    // Content
+    Ztring              Load();                     // Name of a file which is not an index, it is not overwritten, empty if none
+    bool                Get(const Ztring& Path, probe_result& Result);
+    void                Set(const Ztring& Path, const probe_result& Result); // Appended to the file
+    void                Save();                     // Obsolete lines are removed
+
+private:
+    struct item
+    {
+        int64u          Size;
+        Ztring          Modified;
+        probe_result    Result;
+    };
+    map<Ztring, item>   Items;
+    size_t              Lines = 0;
+    File                F;
+    mutex               Mutex;
+    enum read_result
+    {
+        Read_Valid,
+        Read_Rewrite,                               // Index with an incomplete or obsolete content
+        Read_Unknown,                               // Not an index
+    };
+    read_result         Read(const Ztring& Name, size_t& Name_Lines);
+    string              Line(const Ztring& Path, const item& Item);
+};
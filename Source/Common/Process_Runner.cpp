@@ -0,0 +1,393 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#include "Common/Process_Runner.h"
+#include "Common/Pattern_Scanner.h"
+#include <cstring>
+#include <thread>
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <cerrno>
+    #include <fcntl.h>
+    #include <spawn.h>
+    #include <sys/wait.h>
+    #include <unistd.h>
+    extern char** environ;
+#endif
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Capture
+//***************************************************************************
+
+class capture
+{
+public:
+    capture(process& NewP, size_t Log_MaxSize) :
+        P(NewP),
+        Ring(Log_MaxSize)
+    {
+        for (const auto& Pattern : P.ErrorPatterns)
+            if (Carry_MaxSize < Pattern.size())
+                Carry_MaxSize = Pattern.size();
+        if (Carry_MaxSize)
+            Carry_MaxSize--;
+    }
+
+    void Append(const int8u* Buffer, size_t Buffer_Size)
+    {
+        // Error patterns, the end of the previous chunk is kept for patterns spread over 2 chunks
+        if (!P.HasError && !P.ErrorPatterns.empty())
+        {
+            Carry.append((const char*)Buffer, Buffer_Size);
+            for (const auto& Pattern : P.ErrorPatterns)
+                if (Pattern_Find((const int8u*)Carry.data(), Carry.size(), (const int8u*)Pattern.data(), Pattern.size()) != (size_t)-1)
+                    P.HasError = true;
+            if (Carry.size() > Carry_MaxSize)
+                Carry.erase(0, Carry.size() - Carry_MaxSize);
+        }
+
+        // Last bytes
+        if (Ring.empty())
+            return;
+        if (Buffer_Size >= Ring.size())
+        {
+            memcpy(Ring.data(), Buffer + Buffer_Size - Ring.size(), Ring.size());
+            Ring_Pos = 0;
+            Ring_IsFull = true;
+            return;
+        }
+        auto Part = Ring.size() - Ring_Pos;
+        if (Part > Buffer_Size)
+            Part = Buffer_Size;
+        memcpy(Ring.data() + Ring_Pos, Buffer, Part);
+        memcpy(Ring.data(), Buffer + Part, Buffer_Size - Part);
+        Ring_Pos += Buffer_Size;
+        if (Ring_Pos >= Ring.size())
+        {
+            Ring_Pos -= Ring.size();
+            Ring_IsFull = true;
+        }
+    }
+
+    void Finish()
+    {
+        if (Ring_IsFull)
+        {
+            P.Log.assign(Ring.begin() + Ring_Pos, Ring.end());
+            P.Log.append(Ring.begin(), Ring.begin() + Ring_Pos);
+        }
+        else
+            P.Log.assign(Ring.begin(), Ring.begin() + Ring_Pos);
+    }
+
+private:
+    process&        P;
+    vector<char>    Ring;
+    size_t          Ring_Pos = 0;
+    bool            Ring_IsFull = false;
+    string          Carry;
+    size_t          Carry_MaxSize = 0;
+};
+
+//***************************************************************************
+// Platform
+//***************************************************************************
+
+#ifdef _WIN32
+
+typedef HANDLE pipe_end;
+typedef HANDLE child;
+static const pipe_end Pipe_None = nullptr;
+
+//---------------------------------------------------------------------------
+static bool Pipe_Create(pipe_end& Read, pipe_end& Write)
+{
+    // Handles are inheritable but only the ones listed in PROC_THREAD_ATTRIBUTE_HANDLE_LIST are inherited
+    SECURITY_ATTRIBUTES Attributes = { sizeof(Attributes), nullptr, TRUE };
+    if (CreatePipe(&Read, &Write, &Attributes, 0))
+        return true;
+    Read = Pipe_None;
+    Write = Pipe_None;
+    return false;
+}
+
+//---------------------------------------------------------------------------
+static void Pipe_Close(pipe_end& End)
+{
+    if (End == Pipe_None)
+        return;
+    CloseHandle(End);
+    End = Pipe_None;
+}
+
+//---------------------------------------------------------------------------
+static size_t Pipe_Read(pipe_end End, int8u* Buffer, size_t Buffer_Size)
+{
+    DWORD Size;
+    if (!ReadFile(End, Buffer, (DWORD)Buffer_Size, &Size, nullptr))
+        return 0; // ERROR_BROKEN_PIPE when all write ends are closed
+    return Size;
+}
+
+//---------------------------------------------------------------------------
+// Quoting compatible with CommandLineToArgvW
+static wstring Arg_Quote(const wstring& Arg)
+{
+    if (!Arg.empty() && Arg.find_first_of(L" \t\"") == wstring::npos)
+        return Arg;
+
+    wstring ToReturn(1, L'"');
+    size_t Backslashes = 0;
+    for (auto Item : Arg)
+    {
+        if (Item == L'\\')
+        {
+            Backslashes++;
+            continue;
+        }
+        ToReturn.append(Item == L'"' ? (Backslashes * 2 + 1) : Backslashes, L'\\');
+        ToReturn += Item;
+        Backslashes = 0;
+    }
+    ToReturn.append(Backslashes * 2, L'\\');
+    ToReturn += L'"';
+    return ToReturn;
+}
+
+//---------------------------------------------------------------------------
+static bool Spawn(const vector<Ztring>& Args, pipe_end In, pipe_end Out, pipe_end Err, child& Child)
+{
+    wstring CommandLine;
+    for (const auto& Arg : Args)
+    {
+        if (!CommandLine.empty())
+            CommandLine += L' ';
+        CommandLine += Arg_Quote(Arg.To_Unicode());
+    }
+
+    HANDLE Null = nullptr;
+    if (In == Pipe_None)
+    {
+        SECURITY_ATTRIBUTES Attributes = { sizeof(Attributes), nullptr, TRUE };
+        Null = CreateFileW(L"NUL", GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, &Attributes, OPEN_EXISTING, 0, nullptr);
+        if (Null == INVALID_HANDLE_VALUE)
+            return false;
+        In = Null;
+    }
+
+    // Only the standard handles are inherited, other threads may be spawning processes at the same time
+    HANDLE Handles[3] = { In, Out, Err };
+    DWORD Handles_Count = Out == Err ? 2 : 3;
+    SIZE_T AttributeList_Size = 0;
+    InitializeProcThreadAttributeList(nullptr, 1, 0, &AttributeList_Size);
+    vector<int8u> AttributeList_Buffer(AttributeList_Size);
+    auto AttributeList = (LPPROC_THREAD_ATTRIBUTE_LIST)AttributeList_Buffer.data();
+    bool ToReturn = false;
+    if (InitializeProcThreadAttributeList(AttributeList, 1, 0, &AttributeList_Size))
+    {
+        if (UpdateProcThreadAttribute(AttributeList, 0, PROC_THREAD_ATTRIBUTE_HANDLE_LIST, Handles, Handles_Count * sizeof(HANDLE), nullptr, nullptr))
+        {
+            STARTUPINFOEXW StartupInfo = {};
+            StartupInfo.StartupInfo.cb = sizeof(StartupInfo);
+            StartupInfo.StartupInfo.dwFlags = STARTF_USESTDHANDLES;
+            StartupInfo.StartupInfo.hStdInput = In;
+            StartupInfo.StartupInfo.hStdOutput = Out;
+            StartupInfo.StartupInfo.hStdError = Err;
+            StartupInfo.lpAttributeList = AttributeList;
+            PROCESS_INFORMATION ProcessInfo;
+            if (CreateProcessW(nullptr, &CommandLine[0], nullptr, nullptr, TRUE, EXTENDED_STARTUPINFO_PRESENT, nullptr, nullptr, &StartupInfo.StartupInfo, &ProcessInfo))
+            {
+                CloseHandle(ProcessInfo.hThread);
+                Child = ProcessInfo.hProcess;
+                ToReturn = true;
+            }
+        }
+        DeleteProcThreadAttributeList(AttributeList);
+    }
+
+    if (Null)
+        CloseHandle(Null);
+    return ToReturn;
+}
+
+//---------------------------------------------------------------------------
+static int Wait(child Child)
+{
+    DWORD ExitCode = (DWORD)-1;
+    WaitForSingleObject(Child, INFINITE);
+    GetExitCodeProcess(Child, &ExitCode);
+    CloseHandle(Child);
+    return (int)ExitCode;
+}
+
+#else //_WIN32
+
+typedef int pipe_end;
+typedef pid_t child;
+static const pipe_end Pipe_None = -1;
+
+//---------------------------------------------------------------------------
+static bool Pipe_Create(pipe_end& Read, pipe_end& Write)
+{
+    // Close-on-exec, other threads may be spawning processes at the same time
+    int Fds[2];
+    #ifdef __linux__
+        if (pipe2(Fds, O_CLOEXEC))
+            Fds[0] = Fds[1] = Pipe_None;
+    #else
+        if (pipe(Fds))
+            Fds[0] = Fds[1] = Pipe_None;
+        else
+        {
+            fcntl(Fds[0], F_SETFD, FD_CLOEXEC);
+            fcntl(Fds[1], F_SETFD, FD_CLOEXEC);
+        }
+    #endif
+    Read = Fds[0];
+    Write = Fds[1];
+    return Read != Pipe_None;
+}
+
+//---------------------------------------------------------------------------
+static void Pipe_Close(pipe_end& End)
+{
+    if (End == Pipe_None)
+        return;
+    close(End);
+    End = Pipe_None;
+}
+
+//---------------------------------------------------------------------------
+static size_t Pipe_Read(pipe_end End, int8u* Buffer, size_t Buffer_Size)
+{
+    for (;;)
+    {
+        auto Size = read(End, Buffer, Buffer_Size);
+        if (Size >= 0)
+            return (size_t)Size;
+        if (errno != EINTR)
+            return 0;
+    }
+}
+
+//---------------------------------------------------------------------------
+static bool Spawn(const vector<Ztring>& Args, pipe_end In, pipe_end Out, pipe_end Err, child& Child)
+{
+    vector<string> Args_Local;
+    for (const auto& Arg : Args)
+        Args_Local.push_back(Arg.To_Local());
+    vector<char*> Argv;
+    for (auto& Arg : Args_Local)
+        Argv.push_back(&Arg[0]);
+    Argv.push_back(nullptr);
+
+    posix_spawn_file_actions_t Actions;
+    posix_spawn_file_actions_init(&Actions);
+    if (In == Pipe_None)
+        posix_spawn_file_actions_addopen(&Actions, 0, "/dev/null", O_RDONLY, 0);
+    else
+        posix_spawn_file_actions_adddup2(&Actions, In, 0);
+    posix_spawn_file_actions_adddup2(&Actions, Out, 1);
+    posix_spawn_file_actions_adddup2(&Actions, Err, 2);
+    auto Result = posix_spawnp(&Child, Argv[0], &Actions, nullptr, Argv.data(), environ); // PATH lookup if there is no directory
+    posix_spawn_file_actions_destroy(&Actions);
+    return !Result;
+}
+
+//---------------------------------------------------------------------------
+static int Wait(child Child)
+{
+    int Status;
+    while (waitpid(Child, &Status, 0) == -1)
+        if (errno != EINTR)
+            return -1;
+    if (WIFEXITED(Status))
+        return WEXITSTATUS(Status);
+    return 128 + WTERMSIG(Status);
+}
+
+#endif //_WIN32
+
+//***************************************************************************
+// Run
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+void Process_Run(vector<process>& Pipeline, size_t Log_MaxSize)
+{
+    // Launch
+    vector<pipe_end> Logs(Pipeline.size(), Pipe_None);
+    vector<child> Children(Pipeline.size());
+    pipe_end In = Pipe_None;
+    pipe_end Output = Pipe_None;
+    for (size_t i = 0; i < Pipeline.size(); i++)
+    {
+        auto& P = Pipeline[i];
+        P.Started = false;
+        P.ExitCode = -1;
+        P.HasError = false;
+        P.Log.clear();
+        P.Output.clear();
+
+        pipe_end Log_Write;
+        pipe_end Out;
+        pipe_end Next_In = Pipe_None;
+        Pipe_Create(Logs[i], Log_Write);
+        if (i + 1 < Pipeline.size())
+            Pipe_Create(Next_In, Out);
+        else if (P.KeepOutput)
+            Pipe_Create(Output, Out);
+        else
+            Out = Log_Write; // Same as 2>&1
+        if (!P.Args.empty() && Log_Write != Pipe_None && Out != Pipe_None)
+            P.Started = Spawn(P.Args, In, Out, Log_Write, Children[i]);
+
+        // Write ends are closed in this process so reads end when children exit
+        Pipe_Close(In);
+        if (Out != Log_Write)
+            Pipe_Close(Out);
+        Pipe_Close(Log_Write);
+        In = Next_In;
+    }
+
+    // Capture
+    vector<thread> Readers;
+    for (size_t i = 0; i < Pipeline.size(); i++)
+    {
+        if (Logs[i] == Pipe_None)
+            continue;
+        Readers.emplace_back([&, i]()
+        {
+            capture Capture(Pipeline[i], Log_MaxSize);
+            int8u Buffer[65536];
+            while (auto Size = Pipe_Read(Logs[i], Buffer, sizeof(Buffer)))
+                Capture.Append(Buffer, Size);
+            Capture.Finish();
+            Pipe_Close(Logs[i]);
+        });
+    }
+    if (Output != Pipe_None)
+    {
+        Readers.emplace_back([&]()
+        {
+            auto& P = Pipeline.back();
+            int8u Buffer[65536];
+            while (auto Size = Pipe_Read(Output, Buffer, sizeof(Buffer)))
+                P.Output.append((const char*)Buffer, Size);
+            Pipe_Close(Output);
+        });
+    }
+    for (auto& Reader : Readers)
+        Reader.join();
+
+    // Exit codes
+    for (size_t i = 0; i < Pipeline.size(); i++)
+        if (Pipeline[i].Started)
+            Pipeline[i].ExitCode = Wait(Children[i]);
+}
@@ -0,0 +1,41 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#pragma once
+#include "ZenLib/Ztring.h"
+#include <string>
+#include <vector>
+using namespace ZenLib;
+using namespace std;
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Class process
+//***************************************************************************
+
+class process
+{
+public:
+    // Input
+    vector<Ztring>  Args;               // Args[0] is the path of the executable, no shell is involved
+    vector<string>  ErrorPatterns;      // Searched in stdout and stderr while the process runs
+    bool            KeepOutput = false; // Last process only, its stdout goes entirely to Output instead of Log
+
+    // Output
+    bool            Started = false;
+    int             ExitCode = -1;
+    bool            HasError = false;   // One of ErrorPatterns was found
+    string          Log;                // Last bytes of stdout and stderr
+    string          Output;             // Whole stdout, if KeepOutput
+};
+
+//***************************************************************************
+// Run
+//***************************************************************************
+
+// stdout of each process is connected to stdin of the next one, stdout of the last one and stderr of all are captured
+void Process_Run(vector<process>& Pipeline, size_t Log_MaxSize = 65536);
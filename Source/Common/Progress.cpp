@@ -0,0 +1,243 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#include "Common/Progress.h"
+#include "ZenLib/FileName.h"
+#include <cstdio>
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Constants
+//***************************************************************************
+
+static const size_t Line_Size = 77;
+
+//***************************************************************************
+// Constructor/Destructor
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+progress::~progress()
+{
+    Stop();
+}
+
+//***************************************************************************
+// Files
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+void progress::Files_Add(size_t Count, int64u Bytes)
+{
+    Files.fetch_add(Count, memory_order_relaxed);
+    Bytes_Total.fetch_add(Bytes, memory_order_relaxed);
+}
+
+//---------------------------------------------------------------------------
+void progress::Finished(bool Error, bool Warning, bool Skipped, int64u Bytes)
+{
+    Files_Finished.fetch_add(1, memory_order_relaxed);
+    if (Error)
+        Files_Error.fetch_add(1, memory_order_relaxed);
+    if (Warning)
+        Files_Warning.fetch_add(1, memory_order_relaxed);
+    if (Skipped)
+    {
+        Files_Skipped.fetch_add(1, memory_order_relaxed);
+        Bytes_Total.fetch_sub(Bytes, memory_order_relaxed); // Not in the ETA
+    }
+    else
+        Bytes_Finished.fetch_add(Bytes, memory_order_relaxed);
+}
+
+//---------------------------------------------------------------------------
+string progress::Summary() const
+{
+    string Message = "Finished, " + to_string(Pos() - SkippedCount()) + " file(s) transcoded";
+    if (auto Count = SkippedCount())
+        Message += " + " + to_string(Count) + " skipped file(s)";
+    Message += '.';
+    if (auto Count = ErrorCount())
+        Message += ' ' + to_string(Count) + " error(s).";
+    if (auto Count = WarningCount())
+        Message += ' ' + to_string(Count) + " warning(s).";
+    return Message;
+}
+
+//***************************************************************************
+// Threads
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+void progress::Slots_Set(size_t Count)
+{
+    Slots.reset(new progress_slot[Count]);
+    Slots_Count = Count;
+}
+
+//***************************************************************************
+// Messages
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+void progress::Message(const string& Line)
+{
+    if (!Out)
+        return;
+
+    {
+        const lock_guard<mutex> Lock(Messages_Mutex);
+        Messages.push_back(Line);
+    }
+    if (!Thread.joinable())
+        Render(); // No renderer
+}
+
+//***************************************************************************
+// Renderer
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+void progress::Start()
+{
+    if ((!Out && !Err) || Thread.joinable())
+        return;
+
+    Start_Time = chrono::steady_clock::now();
+    Stopping = false;
+    Thread = thread([this]()
+    {
+        unique_lock<mutex> Lock(Mutex);
+        while (!Stopping_Changed.wait_for(Lock, chrono::milliseconds(Interval), [this]() { return Stopping; }))
+        {
+            Lock.unlock();
+            Render();
+            Lock.lock();
+        }
+    });
+}
+
+//---------------------------------------------------------------------------
+void progress::Stop()
+{
+    if (!Thread.joinable())
+        return;
+
+    {
+        const lock_guard<mutex> Lock(Mutex);
+        Stopping = true;
+    }
+    Stopping_Changed.notify_all();
+    Thread.join();
+    Render();
+}
+
+//---------------------------------------------------------------------------
+void progress::Err_Line(const string& Line, bool CarriageReturn)
+{
+    if (!Err)
+        return;
+
+    auto ToDisplay = '\r' + Line;
+    ToDisplay.resize(Line_Size, ' ');
+    const lock_guard<mutex> Lock(Output_Mutex);
+    *Err << ToDisplay;
+    if (CarriageReturn)
+        *Err << '\n';
+    Status_Previous.clear();
+}
+
+//---------------------------------------------------------------------------
+void progress::Render()
+{
+    deque<string> Lines;
+    {
+        const lock_guard<mutex> Lock(Messages_Mutex);
+        Lines.swap(Messages);
+    }
+    auto Status_Line = (Err && Thread.joinable()) ? Status() : string();
+
+    const lock_guard<mutex> Lock(Output_Mutex);
+    if (!Lines.empty())
+    {
+        if (Err && !Status_Previous.empty())
+        {
+            string Clear(1, '\r');
+            Clear.resize(Line_Size, ' ');
+            *Err << Clear << '\r';
+            Status_Previous.clear();
+        }
+        string ToDisplay;
+        for (const auto& Line : Lines)
+            ToDisplay += Line + '\n';
+        *Out << ToDisplay;
+    }
+    if (!Status_Line.empty() && Status_Line != Status_Previous)
+    {
+        *Err << Status_Line;
+        Status_Previous = std::move(Status_Line);
+    }
+}
+
+//---------------------------------------------------------------------------
+// Current file, position, throughput and estimated remaining time
+string progress::Status()
+{
+    auto Elapsed = chrono::duration<double>(chrono::steady_clock::now() - Start_Time).count();
+
+    // A file being demuxed, else any file in progress
+    size_t FilePos = (size_t)-1;
+    for (size_t i = 0; i < Slots_Count; i++)
+    {
+        auto Pos = Slots[i].FilePos.load(memory_order_relaxed);
+        if (Pos == (size_t)-1)
+            continue;
+        FilePos = Pos;
+        if (Slots[i].Stage.load(memory_order_relaxed) == Stage_Demux)
+            break;
+    }
+    if (FilePos == (size_t)-1 && !Pos())
+        return string(); // Nothing started
+
+    char Buffer[64];
+    auto Files_Count = Count();
+    string Suffix = " (" + to_string(Pos() < Files_Count ? (Pos() + 1) : Files_Count) + '/' + to_string(Files_Count) + ')';
+    if (Elapsed >= 1)
+    {
+        int64u Bytes = 0;
+        for (size_t i = 0; i < Slots_Count; i++)
+            Bytes += Slots[i].Bytes.load(memory_order_relaxed);
+        snprintf(Buffer, sizeof(Buffer), " %.2f files/s %.1f MB/s", (Pos() - SkippedCount()) / Elapsed, Bytes / Elapsed / 1000000);
+        Suffix += Buffer;
+    }
+    auto Total = Bytes_Total.load(memory_order_relaxed);
+    auto Finished = Bytes_Finished.load(memory_order_relaxed);
+    if (Total && Finished && Finished <= Total)
+    {
+        auto Remaining = (int64u)((Total - Finished) * Elapsed / Finished);
+        snprintf(Buffer, sizeof(Buffer), " ETA %u:%02u:%02u", (unsigned)(Remaining / 3600), (unsigned)(Remaining / 60 % 60), (unsigned)(Remaining % 60));
+        Suffix += Buffer;
+    }
+
+    string Line("\rTranscoding");
+    if (FilePos != (size_t)-1 && FileName)
+    {
+        auto ShortenedFileName = ZenLib::FileName(FileName(FilePos)).Name_Get().To_Local();
+        auto Size_Max = Line.size() + 1 + Suffix.size() < Line_Size ? (Line_Size - Line.size() - 1 - Suffix.size()) : 0;
+        if (Size_Max < 15)
+            Size_Max = 15;
+        if (ShortenedFileName.size() > Size_Max)
+        {
+            auto Begin_Size = (Size_Max - 5) / 2;
+            ShortenedFileName = ShortenedFileName.substr(0, Begin_Size) + "[...]" + ShortenedFileName.substr(ShortenedFileName.size() - (Size_Max - 5 - Begin_Size));
+        }
+        Line += ' ' + ShortenedFileName;
+    }
+    Line += Suffix;
+    Line.resize(Line_Size, ' ');
+    return Line;
+}
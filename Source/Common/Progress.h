@@ -0,0 +1,97 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#pragma once
+#include "Common/Scheduler.h"
+#include "ZenLib/Ztring.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+using namespace ZenLib;
+using namespace std;
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Class progress
+//***************************************************************************
+
+// State of a processing thread, written by its thread only
+struct progress_slot
+{
+    atomic<size_t>      FilePos{ (size_t)-1 };      // (size_t)-1 if waiting for a job
+    atomic<int>         Stage{ Stage_Max };
+    atomic<int64u>      Bytes{ 0 };                 // Demuxed bytes, all files of the thread
+};
+
+// Counters updated by jobs without lock, console output is done by a renderer thread at a fixed rate
+class progress
+{
+public:
+    ~progress();
+
+    // Config
+    ostream*            Out = nullptr;              // Messages
+    ostream*            Err = nullptr;              // Status line
+    function<Ztring(size_t)> FileName;              // From a file position
+    size_t              Interval = 250;             // In milliseconds
+
+    // Files
+    void                Files_Add(size_t Count, int64u Bytes); // Bytes is 0 if unknown, no ETA
+    void                Finished(bool Error, bool Warning, bool Skipped, int64u Bytes);
+    size_t              Count() const { return Files.load(memory_order_relaxed); }
+    size_t              Pos() const { return Files_Finished.load(memory_order_relaxed); }
+    size_t              ErrorCount() const { return Files_Error.load(memory_order_relaxed); }
+    size_t              WarningCount() const { return Files_Warning.load(memory_order_relaxed); }
+    size_t              SkippedCount() const { return Files_Skipped.load(memory_order_relaxed); }
+    string              Summary() const;
+
+    // Threads, slots are set before the threads are launched
+    void                Slots_Set(size_t Count);
+    progress_slot&      Slot(size_t Pos) { return Slots[Pos]; }
+
+    // Messages, lines written to Out by the renderer
+    void                Message(const string& Line);
+
+    // Renderer
+    void                Start();
+    void                Stop();                     // Pending messages are written
+    void                Err_Line(const string& Line, bool CarriageReturn = false); // Replaces the status line, renderer must be stopped
+
+private:
+    // Counters
+    atomic<size_t>      Files{ 0 };
+    atomic<size_t>      Files_Finished{ 0 };
+    atomic<size_t>      Files_Error{ 0 };
+    atomic<size_t>      Files_Warning{ 0 };
+    atomic<size_t>      Files_Skipped{ 0 };
+    atomic<int64u>      Bytes_Total{ 0 };           // Not skipped files
+    atomic<int64u>      Bytes_Finished{ 0 };
+    unique_ptr<progress_slot[]> Slots;
+    size_t              Slots_Count = 0;
+
+    // Messages
+    deque<string>       Messages;
+    mutex               Messages_Mutex;
+    mutex               Output_Mutex;
+
+    // Renderer thread
+    chrono::steady_clock::time_point Start_Time;
+    string              Status_Previous;
+    string              Status();
+    void                Render();
+    thread              Thread;
+    mutex               Mutex;
+    condition_variable  Stopping_Changed;
+    bool                Stopping = false;
+};
@@ -0,0 +1,240 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#include "Common/Scheduler.h"
+#include "ZenLib/File.h"
+#include "ZenLib/FileName.h"
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <string>
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Constants
+//***************************************************************************
+
+static const char* Stage_Names[Stage_Max] =
+{
+    "Demux",
+    "Audio",
+    "Mux",
+    "Publish",
+    "Check",
+};
+
+// Used until something is measured, only relative values between stages matter
+static const double Stage_SecondsPerUnit_Default[Stage_Max] =
+{
+    1.0 / 100000000,        // 100 MB/s
+    1.0 / 50000,            // 50x real time
+    1.0 / 200000000,        // 200 MB/s
+    1.0 / 1000000000,       // 1 GB/s, rename if same volume
+    1.0 / 500000000,        // 500 MB/s
+};
+
+static const double History_Decay = 0.95; // Older measures have less weight
+static const int64u BytesPerMillisecond_Default = 125; // 1 Mb/s, if the duration is not in the NSV file header
+
+//***************************************************************************
+// Helpers
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+// file_len_ms from the NSVf header, 0 if not available
+static int64u Nsv_Duration(const Ztring& FileName)
+{
+    File F;
+    if (!F.Open(FileName))
+        return 0;
+    int8u Header[16];
+    if (F.Read(Header, 16) != 16 || Header[0] != 'N' || Header[1] != 'S' || Header[2] != 'V' || Header[3] != 'f')
+        return 0;
+    int32u Duration = Header[12] | (Header[13] << 8) | (Header[14] << 16) | ((int32u)Header[15] << 24);
+    if (Duration == (int32u)-1)
+        return 0;
+    return Duration;
+}
+
+//---------------------------------------------------------------------------
+static vector<string> Lines(const Ztring& FileName)
+{
+    vector<string> ToReturn;
+    File F;
+    if (!F.Open(FileName))
+        return ToReturn;
+    string Content;
+    int8u Buffer[65536];
+    while (auto Size = F.Read(Buffer, sizeof(Buffer)))
+        Content.append((const char*)Buffer, Size);
+
+    size_t Begin = 0;
+    while (Begin < Content.size())
+    {
+        auto End = Content.find('\n', Begin);
+        if (End == string::npos)
+            End = Content.size();
+        auto Line = Content.substr(Begin, End - Begin);
+        if (!Line.empty() && Line.back() == '\r')
+            Line.pop_back();
+        if (!Line.empty())
+            ToReturn.push_back(Line);
+        Begin = End + 1;
+    }
+    return ToReturn;
+}
+
+//***************************************************************************
+// Stages
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+const char* Stage_Name(stage Stage)
+{
+    return Stage_Names[Stage];
+}
+
+//***************************************************************************
+// Estimates
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+int64u Duration_Estimate(const Ztring& FileName)
+{
+    auto Duration = Nsv_Duration(FileName);
+    if (Duration)
+        return Duration;
+    auto Size = File::Size_Get(FileName);
+    if (Size == (int64u)-1)
+        return 0;
+    return Size / BytesPerMillisecond_Default;
+}
+
+//***************************************************************************
+// Order
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+vector<size_t> scheduler::Order(const vector<Ztring>& FileNames)
+{
+    // History
+    if (!HistoryFileName.empty())
+    {
+        for (const auto& Line : Lines(HistoryFileName))
+        {
+            auto Separator1 = Line.find(';');
+            auto Separator2 = Line.find(';', Separator1 + 1);
+            if (Separator1 == string::npos || Separator2 == string::npos)
+                continue;
+            auto Name = Line.substr(0, Separator1);
+            for (size_t i = 0; i < Stage_Max; i++)
+            {
+                if (Name == Stage_Names[i])
+                {
+                    History[i].Seconds = strtod(Line.c_str() + Separator1 + 1, nullptr);
+                    History[i].Units = strtod(Line.c_str() + Separator2 + 1, nullptr);
+                }
+            }
+        }
+    }
+
+    // Priorities
+    map<Ztring, size_t> Priorities;
+    if (!PriorityFileName.empty())
+    {
+        for (const auto& Line : Lines(PriorityFileName))
+        {
+            Ztring Name;
+            Name.From_UTF8(Line);
+            Priorities.insert({ Name, Priorities.size() });
+        }
+    }
+
+    // Estimated cost
+    struct item
+    {
+        size_t  Pos;
+        size_t  Priority;
+        double  Cost;
+    };
+    vector<item> Items;
+    for (size_t i = 0; i < FileNames.size(); i++)
+    {
+        const auto& Name = FileNames[i];
+        auto Size = File::Size_Get(Name);
+        if (Size == (int64u)-1)
+            Size = 0;
+        auto Duration = Duration_Estimate(Name);
+
+        item Item;
+        Item.Pos = i;
+        Item.Cost = Size * (SecondsPerUnit(Stage_Demux) + SecondsPerUnit(Stage_Mux) + SecondsPerUnit(Stage_Publish) + SecondsPerUnit(Stage_Check))
+                  + Duration * SecondsPerUnit(Stage_Audio);
+        auto Priority = Priorities.find(Name);
+        if (Priority == Priorities.end())
+            Priority = Priorities.find(ZenLib::FileName(Name).Name_Get() + __T('.') + ZenLib::FileName(Name).Extension_Get());
+        Item.Priority = Priority == Priorities.end() ? (size_t)-1 : Priority->second;
+        Items.push_back(Item);
+    }
+    stable_sort(Items.begin(), Items.end(), [](const item& A, const item& B)
+    {
+        if (A.Priority != B.Priority)
+            return A.Priority < B.Priority;
+        return A.Cost > B.Cost;
+    });
+
+    vector<size_t> ToReturn;
+    for (const auto& Item : Items)
+        ToReturn.push_back(Item.Pos);
+    return ToReturn;
+}
+
+//***************************************************************************
+// History
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+double scheduler::SecondsPerUnit(stage Stage)
+{
+    const auto& Item = History[Stage];
+    if (Item.Units <= 0 || Item.Seconds <= 0)
+        return Stage_SecondsPerUnit_Default[Stage];
+    return Item.Seconds / Item.Units;
+}
+
+//---------------------------------------------------------------------------
+void scheduler::Measured(stage Stage, int64u Units, double Seconds)
+{
+    if (!Units || Seconds <= 0)
+        return;
+
+    const lock_guard<mutex> Lock(Mutex);
+    auto& Item = History[Stage];
+    Item.Seconds = Item.Seconds * History_Decay + Seconds;
+    Item.Units = Item.Units * History_Decay + Units;
+}
+
+//---------------------------------------------------------------------------
+void scheduler::Save()
+{
+    if (HistoryFileName.empty())
+        return;
+
+    string Content;
+    {
+        const lock_guard<mutex> Lock(Mutex);
+        for (size_t i = 0; i < Stage_Max; i++)
+            if (History[i].Units > 0)
+                Content += string(Stage_Names[i]) + ';' + to_string(History[i].Seconds) + ';' + to_string(History[i].Units) + '\n';
+    }
+
+    File F;
+    if (!F.Create(HistoryFileName))
+        return;
+    F.Write((const int8u*)Content.data(), Content.size());
+    F.Close();
+}
@@ -0,0 +1,66 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#pragma once
+#include "ZenLib/Ztring.h"
+#include <mutex>
+#include <vector>
+using namespace ZenLib;
+using namespace std;
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Stages
+//***************************************************************************
+
+enum stage
+{
+    Stage_Demux,            // Unit is input byte
+    Stage_Audio,            // Unit is millisecond of content
+    Stage_Mux,              // Unit is input byte
+    Stage_Publish,          // Unit is input byte
+    Stage_Check,            // Unit is input byte
+    Stage_Max
+};
+
+const char* Stage_Name(stage Stage);
+
+//***************************************************************************
+// Estimates
+//***************************************************************************
+
+// In ms, from the NSV file header else from the file size
+int64u Duration_Estimate(const Ztring& FileName);
+
+//***************************************************************************
+// Class scheduler
+//***************************************************************************
+
+class scheduler
+{
+public:
+    // Input
+    Ztring              HistoryFileName;    // Measured throughput per stage, loaded by Order() and updated by Save()
+    Ztring              PriorityFileName;   // One file name per line, listed files are processed first
+
+    // Order of processing, listed files then longest processing time first
+    vector<size_t>      Order(const vector<Ztring>& FileNames);
+
+    // History
+    void                Measured(stage Stage, int64u Units, double Seconds);
+    void                Save();
+
+private:
+    struct history_item
+    {
+        double          Seconds = 0;
+        double          Units = 0;
+    };
+    history_item        History[Stage_Max];
+    mutex               Mutex;
+    double              SecondsPerUnit(stage Stage);
+};
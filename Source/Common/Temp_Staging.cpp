@@ -0,0 +1,90 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#include "Common/Temp_Staging.h"
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <sys/statvfs.h>
+#endif
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Config
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+bool temp_staging::Init()
+{
+    if (!Budget)
+        return false;
+
+    if (MemoryPath.empty())
+    {
+        #ifdef _WIN32
+            Budget = 0; // No memory backed file system by default
+            return false;
+        #else
+            MemoryPath = __T("/dev/shm/");
+        #endif
+    }
+    else if (MemoryPath.back() != __T('/') && MemoryPath.back() != __T('\\'))
+    {
+        #ifdef _WIN32
+            MemoryPath += __T('\\');
+        #else
+            MemoryPath += __T('/');
+        #endif
+    }
+
+    // Budget can not be more than what is available
+    auto Free = Free_Get();
+    if (Budget > Free)
+        Budget = Free;
+    return Budget != 0;
+}
+
+//---------------------------------------------------------------------------
+int64u temp_staging::Free_Get()
+{
+    #ifdef _WIN32
+        ULARGE_INTEGER FreeBytesAvailable;
+        if (!GetDiskFreeSpaceExW(MemoryPath.To_Unicode().c_str(), &FreeBytesAvailable, nullptr, nullptr))
+            return 0;
+        return FreeBytesAvailable.QuadPart;
+    #else
+        struct statvfs Stat;
+        if (statvfs(MemoryPath.To_Local().c_str(), &Stat))
+            return 0;
+        return (int64u)Stat.f_bavail * Stat.f_frsize;
+    #endif
+}
+
+//***************************************************************************
+// Jobs
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+bool temp_staging::Reserve(int64u Size)
+{
+    const lock_guard<mutex> Lock(Mutex);
+    if (Used + Size > Budget)
+        return false;
+
+    // The file system is shared with other shards and processes, what is free now is checked too
+    if (Size > Free_Get())
+        return false;
+    Used += Size;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+void temp_staging::Release(int64u Size)
+{
+    const lock_guard<mutex> Lock(Mutex);
+    Used -= Size;
+}
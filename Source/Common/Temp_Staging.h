@@ -0,0 +1,39 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#pragma once
+#include "ZenLib/Ztring.h"
+#include <mutex>
+using namespace ZenLib;
+using namespace std;
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Class temp_staging
+//***************************************************************************
+
+// Temporary files of a job are in a memory backed directory if its estimated size fits in the budget shared by all jobs, else in the disk temporary path
+class temp_staging
+{
+public:
+    // Input
+    Ztring              MemoryPath;                 // tmpfs or RAM disk, with trailing separator, empty means default (/dev/shm/ on Linux)
+    int64u              Budget = 0;                 // In bytes, 0 means no memory staging
+
+    // Config
+    bool                Init();                     // false if memory staging is not possible, budget is limited to the free space
+
+    // Jobs
+    bool                Reserve(int64u Size);       // false if the job has to use the disk, also if the file system has not enough free space now
+    void                Release(int64u Size);
+
+private:
+    int64u              Used = 0;
+    mutex               Mutex;
+
+    int64u              Free_Get();                 // 0 if unknown
+};
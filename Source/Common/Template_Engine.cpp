@@ -0,0 +1,271 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#include "Common/Template_Engine.h"
+#include "ZenLib/File.h"
+#include <string>
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Constants
+//***************************************************************************
+
+static const Char* Field_Names[Field_Max] =
+{
+    __T("TEMPPATH"),
+    __T("MEETING"),
+    __T("COMMISSION"),
+    __T("ROOM"),
+    __T("DATE_ENCODED"),
+    __T("DELAY_V"),
+    __T("DELAY_A"),
+    __T("CHANNELS"),
+    __T("AAC_PROFILE"),
+};
+
+static const Char* Block_Names[Block_Max] =
+{
+    __T("CHAPTERS"),
+    __T("VIDEO"),
+    __T("AUDIO"),
+    __T("LANGUAGES"),
+};
+
+//***************************************************************************
+// Helpers
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+static bool Content_Read(const Ztring& FileName, Ztring& Content)
+{
+    File F;
+    if (!F.Open(FileName))
+        return false;
+    string Buffer;
+    int8u Temp[65536];
+    while (auto Size = F.Read(Temp, sizeof(Temp)))
+        Buffer.append((const char*)Temp, Size);
+    Content.From_UTF8(Buffer);
+    return true;
+}
+
+//---------------------------------------------------------------------------
+template<size_t Size>
+static size_t Name_Find(const Char* const (&Names)[Size], const Ztring& Content, size_t Begin, size_t End)
+{
+    for (size_t i = 0; i < Size; i++)
+        if (!Content.compare(Begin, End - Begin, Names[i]))
+            return i;
+    return Size;
+}
+
+//---------------------------------------------------------------------------
+static bool Marker_Is(const Ztring& Value)
+{
+    return Value.size() > 2 && Value.front() == __T('%') && Value.back() == __T('%')
+        && (!Value.compare(1, 3, __T("IF:")) || !Value.compare(1, 4, __T("END:")));
+}
+
+//***************************************************************************
+// Values
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+template_values::template_values()
+{
+    for (auto& Block : Blocks)
+        Block = true;
+}
+
+//***************************************************************************
+// text_template
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+bool text_template::Load(const Ztring& FileName)
+{
+    Ztring Content;
+    if (!Content_Read(FileName, Content))
+        return false;
+    Compile(Content);
+    return true;
+}
+
+//---------------------------------------------------------------------------
+void text_template::Compile(const Ztring& Content)
+{
+    Text = Content;
+    Segments.clear();
+
+    vector<size_t> Ifs;
+    size_t Text_Begin = 0;
+    size_t Pos = 0;
+    auto Text_Add = [&](size_t End)
+    {
+        if (End > Text_Begin)
+            Segments.push_back({ Segment_Text, 0, Text_Begin, End - Text_Begin });
+    };
+    while ((Pos = Text.find(__T('%'), Pos)) != string::npos)
+    {
+        auto End = Text.find(__T('%'), Pos + 1);
+        if (End == string::npos)
+            break;
+
+        // Field
+        auto Index = Name_Find(Field_Names, Text, Pos + 1, End);
+        if (Index < Field_Max)
+        {
+            Text_Add(Pos);
+            Segments.push_back({ Segment_Field, Index, 0, 0 });
+            Pos = Text_Begin = End + 1;
+            continue;
+        }
+
+        // Block
+        auto IsIf = !Text.compare(Pos + 1, 3, __T("IF:"));
+        auto IsEnd = !Text.compare(Pos + 1, 4, __T("END:"));
+        Index = IsIf ? Name_Find(Block_Names, Text, Pos + 4, End) : IsEnd ? Name_Find(Block_Names, Text, Pos + 5, End) : (size_t)Block_Max;
+        if (Index < Block_Max)
+        {
+            Text_Add(Pos);
+            if (IsIf)
+            {
+                Ifs.push_back(Segments.size());
+                Segments.push_back({ Segment_If, Index, 0, 0 });
+            }
+            else if (!Ifs.empty())
+            {
+                Segments[Ifs.back()].Pos = Segments.size();
+                Ifs.pop_back();
+                Segments.push_back({ Segment_End, Index, 0, 0 });
+            }
+            Pos = Text_Begin = End + 1;
+            continue;
+        }
+
+        // Not a template item, second '%' may be the beginning of one
+        Pos = End;
+    }
+    Text_Add(Text.size());
+
+    // Blocks not closed go up to the end
+    for (auto If : Ifs)
+        Segments[If].Pos = Segments.size();
+}
+
+//---------------------------------------------------------------------------
+Ztring text_template::Render(const template_values& Values) const
+{
+    Ztring ToReturn;
+    ToReturn.reserve(Text.size() + 1024);
+    for (size_t i = 0; i < Segments.size(); i++)
+    {
+        const auto& Segment = Segments[i];
+        switch (Segment.Type)
+        {
+            case Segment_Text:
+                ToReturn.append(Text, Segment.Pos, Segment.Size);
+                break;
+            case Segment_Field:
+                ToReturn += Values.Fields[Segment.Index];
+                break;
+            case Segment_If:
+                if (!Values.Blocks[Segment.Index])
+                    i = Segment.Pos;
+                break;
+            default:;
+        }
+    }
+    return ToReturn;
+}
+
+//***************************************************************************
+// mkvmerge_command
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+bool mkvmerge_command::Load(const Ztring& FileName)
+{
+    Ztring Content;
+    if (!Content_Read(FileName, Content))
+        return false;
+
+    // JSON array of strings to arguments, line endings and separators do not matter
+    Ztring Text;
+    for (size_t i = 0; i < Content.size(); i++)
+    {
+        if (Content[i] != __T('"'))
+            continue;
+        Ztring Value;
+        for (i++; i < Content.size() && Content[i] != __T('"'); i++)
+        {
+            auto Item = Content[i];
+            if (Item == __T('\\') && i + 1 < Content.size())
+            {
+                Item = Content[++i];
+                switch (Item)
+                {
+                    case __T('b'): Item = __T('\b'); break;
+                    case __T('f'): Item = __T('\f'); break;
+                    case __T('n'): Item = __T('\n'); break;
+                    case __T('r'): Item = __T('\r'); break;
+                    case __T('t'): Item = __T('\t'); break;
+                    case __T('u'):
+                        if (i + 4 < Content.size())
+                        {
+                            Item = (Char)Ztring(Content.substr(i + 1, 4)).To_int32u(16);
+                            i += 4;
+                        }
+                        break;
+                    default:;
+                }
+            }
+            Value += Item;
+        }
+        Text += Value;
+        if (!Marker_Is(Value))
+            Text += __T('\0');
+    }
+    Template.Compile(Text);
+    return true;
+}
+
+//---------------------------------------------------------------------------
+Ztring mkvmerge_command::Json(const template_values& Values) const
+{
+    auto Text = Template.Render(Values);
+    Ztring ToReturn;
+    ToReturn.reserve(Text.size() * 2);
+    ToReturn += __T("[\n");
+    bool IsFirst = true;
+    bool IsOpen = false;
+    for (auto Item : Text)
+    {
+        if (!IsOpen)
+        {
+            if (!IsFirst)
+                ToReturn += __T(",\n");
+            ToReturn += __T('"');
+            IsFirst = false;
+            IsOpen = true;
+        }
+        switch (Item)
+        {
+            case __T('\0'): ToReturn += __T('"'); IsOpen = false; break;
+            case __T('"'): ToReturn += __T("\\\""); break;
+            case __T('\\'): ToReturn += __T("\\\\"); break;
+            case __T('\n'): ToReturn += __T("\\n"); break;
+            case __T('\r'): ToReturn += __T("\\r"); break;
+            case __T('\t'): ToReturn += __T("\\t"); break;
+            default: ToReturn += Item;
+        }
+    }
+    if (IsOpen)
+        ToReturn += __T('"');
+    ToReturn += __T("\n]\n");
+    return ToReturn;
+}
@@ -0,0 +1,98 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#pragma once
+#include "ZenLib/Ztring.h"
+#include <vector>
+using namespace ZenLib;
+using namespace std;
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Values
+//***************************************************************************
+
+// %NAME% in templates
+enum template_field
+{
+    Field_TempPath,
+    Field_Meeting,
+    Field_Commission,
+    Field_Room,
+    Field_DateEncoded,
+    Field_DelayV,
+    Field_DelayA,
+    Field_Channels,
+    Field_AacProfile,
+    Field_Max
+};
+
+// %IF:NAME% ... %END:NAME% in templates
+enum template_block
+{
+    Block_Chapters,
+    Block_Video,
+    Block_Audio,
+    Block_Languages,        // Audio tracks other than the main one
+    Block_Max
+};
+
+struct template_values
+{
+    Ztring              Fields[Field_Max];
+    bool                Blocks[Block_Max];
+
+    template_values();
+};
+
+//***************************************************************************
+// Class text_template
+//***************************************************************************
+
+// Compiled once, then rendered in a single pass per file
+class text_template
+{
+public:
+    bool                Load(const Ztring& FileName);
+    void                Compile(const Ztring& Content);
+
+    Ztring              Render(const template_values& Values) const;
+
+private:
+    enum segment_type
+    {
+        Segment_Text,
+        Segment_Field,
+        Segment_If,
+        Segment_End,
+    };
+    struct segment
+    {
+        segment_type    Type;
+        size_t          Index;              // Field or block
+        size_t          Pos;                // Text: position in Text, If: position of the matching End in Segments
+        size_t          Size;
+    };
+    Ztring              Text;
+    vector<segment>     Segments;
+};
+
+//***************************************************************************
+// Class mkvmerge_command
+//***************************************************************************
+
+// mkvmerge JSON option file, blocks are "%IF:NAME%" and "%END:NAME%" array items
+class mkvmerge_command
+{
+public:
+    bool                Load(const Ztring& FileName);
+
+    Ztring              Json(const template_values& Values) const;
+
+private:
+    text_template       Template;           // Each argument is terminated by '\0'
+};
@@ -0,0 +1,170 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#include "Common/Trace.h"
+#include "ZenLib/File.h"
+#include <atomic>
+#include <cstdio>
+#include <string>
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Helpers
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+static string Json_Escape(const string& Value)
+{
+    string ToReturn;
+    for (auto Item : Value)
+    {
+        switch (Item)
+        {
+            case '"': ToReturn += "\\\""; break;
+            case '\\': ToReturn += "\\\\"; break;
+            default:
+                if ((unsigned char)Item < 0x20)
+                {
+                    char Temp[7];
+                    snprintf(Temp, sizeof(Temp), "\\u%04X", (unsigned char)Item);
+                    ToReturn += Temp;
+                }
+                else
+                    ToReturn += Item;
+        }
+    }
+    return ToReturn;
+}
+
+// Buffers of the current thread are for one run only, runs of all traces of the process have different numbers
+static atomic<size_t> Run_Count(0);
+
+//***************************************************************************
+// Config
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+bool trace::Start(const Ztring& FileName_)
+{
+    File F;
+    if (!F.Create(FileName_))
+        return false;
+    F.Close();
+
+    FileName = FileName_;
+    Start_Time = chrono::steady_clock::now();
+    Run = ++Run_Count;
+    return true;
+}
+
+//***************************************************************************
+// Recording
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+trace::buffer& trace::Buffer_Get()
+{
+    thread_local size_t Buffer_Run = 0;
+    thread_local buffer* Buffer = nullptr;
+    if (Buffer_Run != Run)
+    {
+        const lock_guard<mutex> Lock(Mutex);
+        Buffers.emplace_back(new buffer);
+        Buffer = Buffers.back().get();
+        Buffer->Name = "Thread " + to_string(Buffers.size());
+        Buffer->Events.reserve(1024);
+        Buffer_Run = Run;
+    }
+    return *Buffer;
+}
+
+//---------------------------------------------------------------------------
+int64u trace::Time_Get(time_point Time) const
+{
+    return chrono::duration_cast<chrono::microseconds>(Time - Start_Time).count();
+}
+
+//---------------------------------------------------------------------------
+void trace::Thread_Set(const char* Name)
+{
+    if (!Enabled())
+        return;
+
+    auto& Buffer = Buffer_Get();
+    const lock_guard<mutex> Lock(Mutex);
+    Buffer.Name = string(Name) + ' ' + to_string(++ThreadCounts[Name]);
+}
+
+//---------------------------------------------------------------------------
+void trace::File_Set(size_t File, const Ztring& Name)
+{
+    if (!Enabled())
+        return;
+
+    const lock_guard<mutex> Lock(Mutex);
+    FileNames[File] = Name;
+}
+
+//---------------------------------------------------------------------------
+void trace::Add(const char* Name, size_t File, time_point Begin, const char* Value_Name, int64u Value)
+{
+    if (!Enabled())
+        return;
+
+    auto Begin_Time = Time_Get(Begin);
+    Buffer_Get().Events.push_back({ Name, File, Begin_Time, Time_Get(chrono::steady_clock::now()) - Begin_Time, Value_Name, Value });
+}
+
+//***************************************************************************
+// Output
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+bool trace::Write()
+{
+    if (!Enabled())
+        return true;
+
+    string Content = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool IsFirst = true;
+    const lock_guard<mutex> Lock(Mutex);
+    map<size_t, string> Files;
+    for (const auto& Item : FileNames)
+        Files[Item.first] = Json_Escape(Item.second.To_UTF8());
+    for (size_t i = 0; i < Buffers.size(); i++)
+    {
+        const auto& Buffer = *Buffers[i];
+        auto ThreadID = to_string(i + 1);
+        if (!IsFirst)
+            Content += ",\n";
+        IsFirst = false;
+        Content += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + ThreadID + ",\"args\":{\"name\":\"" + Json_Escape(Buffer.Name) + "\"}}";
+        for (const auto& Event : Buffer.Events)
+        {
+            Content += ",\n{\"name\":\"" + Json_Escape(Event.Name) + "\",\"ph\":\"X\",\"pid\":1,\"tid\":" + ThreadID
+                     + ",\"ts\":" + to_string(Event.Begin) + ",\"dur\":" + to_string(Event.Duration) + ",\"args\":{";
+            auto File_Name = Files.find(Event.File);
+            if (File_Name != Files.end())
+                Content += "\"file\":\"" + File_Name->second + '"';
+            if (Event.Value_Name)
+            {
+                if (File_Name != Files.end())
+                    Content += ',';
+                Content += '"' + Json_Escape(Event.Value_Name) + "\":" + to_string(Event.Value);
+            }
+            Content += "}}";
+        }
+    }
+    Content += "\n]}\n";
+
+    File F;
+    if (!F.Create(FileName))
+        return false;
+    auto Written = F.Write((const int8u*)Content.data(), Content.size());
+    F.Close();
+    return Written == Content.size();
+}
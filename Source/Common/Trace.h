@@ -0,0 +1,97 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#pragma once
+#include "ZenLib/Ztring.h"
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+using namespace ZenLib;
+using namespace std;
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Class trace
+//***************************************************************************
+
+// Timing of processing steps, written at the end in Chrome trace event format (chrome://tracing, Perfetto)
+// Each thread records in its own buffer, so there is no lock while recording
+class trace
+{
+public:
+    typedef chrono::steady_clock::time_point time_point;
+
+    // Config
+    bool                Start(const Ztring& FileName);
+    bool                Enabled() const { return !FileName.empty(); }
+
+    // Recording
+    void                Thread_Set(const char* Name);                   // Name of the current thread, a number is added
+    void                File_Set(size_t File, const Ztring& Name);
+    void                Add(const char* Name, size_t File, time_point Begin, const char* Value_Name = nullptr, int64u Value = 0); // Ends now
+
+    // Output, when recording threads are finished
+    bool                Write();
+
+private:
+    struct event
+    {
+        const char*     Name;
+        size_t          File;
+        int64u          Begin;              // In microseconds since Start()
+        int64u          Duration;
+        const char*     Value_Name;
+        int64u          Value;
+    };
+    struct buffer
+    {
+        string          Name;
+        vector<event>   Events;
+    };
+    buffer&             Buffer_Get();
+    int64u              Time_Get(time_point Time) const;
+
+    Ztring              FileName;
+    time_point          Start_Time;
+    size_t              Run = 0;
+    vector<unique_ptr<buffer>> Buffers;
+    map<size_t, Ztring> FileNames;
+    map<string, size_t> ThreadCounts;
+    mutex               Mutex;
+};
+
+//***************************************************************************
+// Class trace_scope
+//***************************************************************************
+
+// Event from construction to destruction
+class trace_scope
+{
+public:
+    trace_scope(trace& Trace_, const char* Name_, size_t File_ = (size_t)-1) :
+        Trace(Trace_),
+        Name(Name_),
+        File(File_)
+    {
+        if (Trace.Enabled())
+            Begin = chrono::steady_clock::now();
+    }
+
+    ~trace_scope()
+    {
+        if (Trace.Enabled())
+            Trace.Add(Name, File, Begin);
+    }
+
+private:
+    trace&              Trace;
+    const char*         Name;
+    size_t              File;
+    trace::time_point   Begin;
+};
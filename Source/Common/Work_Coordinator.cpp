@@ -0,0 +1,530 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#ifdef _WIN32
+    #include <winsock2.h>
+    #include <afunix.h>
+    #include <windows.h>
+    #ifdef _MSC_VER
+        #pragma comment(lib, "ws2_32.lib")
+    #endif
+#else
+    #include <cerrno>
+    #include <poll.h>
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <unistd.h>
+#endif
+#include "Common/Work_Coordinator.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Constants
+//***************************************************************************
+
+static const size_t Attempts_Max = 2; // Workers disconnected during the processing of the same file
+
+//***************************************************************************
+// Sockets
+//***************************************************************************
+
+#ifdef _WIN32
+typedef SOCKET socket_handle;
+static const socket_handle Socket_None = INVALID_SOCKET;
+#else
+typedef int socket_handle;
+static const socket_handle Socket_None = -1;
+#endif
+
+//---------------------------------------------------------------------------
+static bool Socket_Init()
+{
+    #ifdef _WIN32
+        static const bool IsOk = []
+        {
+            WSADATA Data;
+            return !WSAStartup(MAKEWORD(2, 2), &Data);
+        }();
+        return IsOk;
+    #else
+        return true;
+    #endif
+}
+
+//---------------------------------------------------------------------------
+static void Socket_Close(socket_handle Socket)
+{
+    #ifdef _WIN32
+        closesocket(Socket);
+    #else
+        close(Socket);
+    #endif
+}
+
+//---------------------------------------------------------------------------
+static bool Socket_Address(sockaddr_un& Address, const Ztring& SocketName)
+{
+    auto Name = SocketName.To_Local();
+    memset(&Address, 0, sizeof(Address));
+    Address.sun_family = AF_UNIX;
+    if (Name.empty() || Name.size() >= sizeof(Address.sun_path))
+        return false;
+    memcpy(Address.sun_path, Name.c_str(), Name.size());
+    return true;
+}
+
+//---------------------------------------------------------------------------
+static void Socket_Remove(const Ztring& SocketName)
+{
+    #ifdef _WIN32
+        DeleteFileW(SocketName.To_Unicode().c_str());
+    #else
+        unlink(SocketName.To_Local().c_str());
+    #endif
+}
+
+//---------------------------------------------------------------------------
+static bool Socket_Send(socket_handle Socket, const string& Content)
+{
+    #ifdef MSG_NOSIGNAL
+        static const int Flags = MSG_NOSIGNAL; // A disconnected peer is an error, not a signal
+    #else
+        static const int Flags = 0;
+    #endif
+
+    size_t Offset = 0;
+    while (Offset < Content.size())
+    {
+        auto Size = send(Socket, Content.data() + Offset, (int)(Content.size() - Offset), Flags);
+        if (Size <= 0)
+        {
+            #ifndef _WIN32
+                if (Size < 0 && errno == EINTR)
+                    continue;
+            #endif
+            return false;
+        }
+        Offset += (size_t)Size;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// 0 if disconnected or on error
+static size_t Socket_Receive(socket_handle Socket, char* Buffer, size_t Buffer_Size)
+{
+    for (;;)
+    {
+        auto Size = recv(Socket, Buffer, (int)Buffer_Size, 0);
+        if (Size > 0)
+            return (size_t)Size;
+        #ifndef _WIN32
+            if (Size < 0 && errno == EINTR)
+                continue;
+        #endif
+        return 0;
+    }
+}
+
+//---------------------------------------------------------------------------
+static int Socket_Poll(vector<pollfd>& Fds)
+{
+    #ifdef _WIN32
+        return WSAPoll(Fds.data(), (ULONG)Fds.size(), -1);
+    #else
+        int Result;
+        do
+            Result = poll(Fds.data(), (nfds_t)Fds.size(), -1);
+        while (Result < 0 && errno == EINTR);
+        return Result;
+    #endif
+}
+
+//---------------------------------------------------------------------------
+// Complete line removed from the buffer, without the line feed
+static bool Line_Get(string& Buffer, string& Line)
+{
+    auto End = Buffer.find('\n');
+    if (End == string::npos)
+        return false;
+    Line.assign(Buffer, 0, End);
+    Buffer.erase(0, End + 1);
+    return true;
+}
+
+//***************************************************************************
+// List
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+// FNV-1a, stable across runs and platforms
+static void Hash_Add(int64u& Hash, const string& Value)
+{
+    for (auto Item : Value)
+    {
+        Hash ^= (int8u)Item;
+        Hash *= 0x100000001B3ULL;
+    }
+    Hash ^= '\n';
+    Hash *= 0x100000001B3ULL;
+}
+
+//---------------------------------------------------------------------------
+int64u Work_ListHash(const vector<string>& Names)
+{
+    int64u Hash = 0xCBF29CE484222325ULL;
+    Hash_Add(Hash, to_string(Names.size()));
+    for (const auto& Name : Names)
+        Hash_Add(Hash, Name);
+    return Hash;
+}
+
+//---------------------------------------------------------------------------
+size_t Work_Shard(const string& Name, size_t ShardCount)
+{
+    int64u Hash = 0xCBF29CE484222325ULL;
+    Hash_Add(Hash, Name);
+    return (size_t)(Hash % ShardCount);
+}
+
+//***************************************************************************
+// Coordinator
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+bool work_coordinator::Run(const vector<size_t>& Order, int64u ListHash)
+{
+    sockaddr_un Address;
+    if (!Socket_Init() || !Socket_Address(Address, SocketName))
+    {
+        ErrorMessage = "invalid socket name " + SocketName.To_Local();
+        return false;
+    }
+
+    // A socket file left by a previous coordinator is replaced, a running coordinator is kept
+    socket_handle Probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (Probe != Socket_None)
+    {
+        auto IsRunning = !connect(Probe, (sockaddr*)&Address, sizeof(Address));
+        Socket_Close(Probe);
+        if (IsRunning)
+        {
+            ErrorMessage = "another coordinator is using " + SocketName.To_Local();
+            return false;
+        }
+    }
+    Socket_Remove(SocketName);
+
+    socket_handle Listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (Listener == Socket_None || bind(Listener, (sockaddr*)&Address, sizeof(Address)) || listen(Listener, 64))
+    {
+        if (Listener != Socket_None)
+            Socket_Close(Listener);
+        ErrorMessage = "can not listen on " + SocketName.To_Local();
+        return false;
+    }
+
+    struct worker
+    {
+        socket_handle   Socket;
+        size_t          Slot = (size_t)-1;          // -1 until HELLO
+        string          Buffer;
+        vector<size_t>  InFlight;
+    };
+    vector<worker> Workers;
+    deque<size_t> Queue(Order.begin(), Order.end());
+    vector<bool> IsFinished(Order.size());
+    vector<size_t> Attempts(Order.size());
+    size_t Finished_Count = 0;
+
+    auto Slot_Get = [&]
+    {
+        for (size_t Slot = 0;; Slot++)
+            if (none_of(Workers.begin(), Workers.end(), [&](const worker& Worker) { return Worker.Slot == Slot; }))
+                return Slot;
+    };
+
+    // false if the worker must be disconnected
+    auto Line_Parse = [&](worker& Worker, const string& Line)
+    {
+        vector<string> Fields;
+        size_t Begin = 0;
+        while (Fields.size() < 3)
+        {
+            auto End = Line.find('\t', Begin);
+            if (End == string::npos)
+                break;
+            Fields.push_back(Line.substr(Begin, End - Begin));
+            Begin = End + 1;
+        }
+        Fields.push_back(Line.substr(Begin));
+
+        if (Fields[0] == "HELLO" && Fields.size() == 3)
+        {
+            if (Worker.Slot != (size_t)-1)
+                return false;
+            if (strtoull(Fields[1].c_str(), nullptr, 10) != Order.size() || strtoull(Fields[2].c_str(), nullptr, 10) != ListHash)
+            {
+                Socket_Send(Worker.Socket, "ERROR\tthe list of files is not the same as the one of the coordinator\n");
+                return false;
+            }
+            Worker.Slot = Slot_Get();
+            Socket_Send(Worker.Socket, "SLOT\t" + to_string(Worker.Slot) + '\n');
+            return true;
+        }
+        if (Worker.Slot == (size_t)-1)
+            return false;
+        if (Fields[0] == "NEXT")
+        {
+            if (Queue.empty())
+                return Socket_Send(Worker.Socket, Finished_Count >= Order.size() ? "END\n" : "WAIT\n");
+            auto Pos = Queue.front();
+            Queue.pop_front();
+            Worker.InFlight.push_back(Pos);
+            Socket_Send(Worker.Socket, "FILE\t" + to_string(Pos) + '\n'); // If it fails, disconnection is detected by poll()
+            return true;
+        }
+        if (Fields[0] == "DONE" && Fields.size() == 4)
+        {
+            work_result Result;
+            Result.Pos = strtoul(Fields[1].c_str(), nullptr, 10);
+            auto InFlight = find(Worker.InFlight.begin(), Worker.InFlight.end(), Result.Pos);
+            if (InFlight == Worker.InFlight.end())
+                return true; // Not given to this worker
+            Worker.InFlight.erase(InFlight);
+            if (IsFinished[Result.Pos])
+                return true;
+            IsFinished[Result.Pos] = true;
+            Finished_Count++;
+            Result.Error = Fields[2].find('E') != string::npos;
+            Result.Warning = Fields[2].find('W') != string::npos;
+            Result.Skipped = Fields[2].find('S') != string::npos;
+            Result.Message = Fields[3];
+            if (Finished)
+                Finished(Result);
+            return true;
+        }
+        return false;
+    };
+
+    bool IsOk = true;
+    for (;;)
+    {
+        if (Finished_Count >= Order.size() && Workers.empty())
+            break;
+
+        vector<pollfd> Fds(Workers.size() + 1);
+        Fds[0].fd = Listener;
+        Fds[0].events = POLLIN;
+        for (size_t i = 0; i < Workers.size(); i++)
+        {
+            Fds[i + 1].fd = Workers[i].Socket;
+            Fds[i + 1].events = POLLIN;
+        }
+        if (Socket_Poll(Fds) < 0)
+        {
+            ErrorMessage = "can not wait for workers";
+            IsOk = false;
+            break;
+        }
+
+        // From the last one, for removal
+        for (size_t i = Workers.size(); i--;)
+        {
+            if (!Fds[i + 1].revents)
+                continue;
+            auto& Worker = Workers[i];
+            char Buffer[4096];
+            auto Size = Socket_Receive(Worker.Socket, Buffer, sizeof(Buffer));
+            auto IsConnected = Size != 0;
+            Worker.Buffer.append(Buffer, Size);
+            string Line;
+            while (IsConnected && Line_Get(Worker.Buffer, Line))
+                IsConnected = Line_Parse(Worker, Line);
+            if (IsConnected)
+                continue;
+
+            if (!Worker.InFlight.empty() && Warning)
+                Warning("worker " + to_string(Worker.Slot) + " disconnected during the processing of " + to_string(Worker.InFlight.size()) + " file(s)");
+            for (auto Pos = Worker.InFlight.rbegin(); Pos != Worker.InFlight.rend(); ++Pos)
+            {
+                if (++Attempts[*Pos] < Attempts_Max)
+                {
+                    Queue.push_front(*Pos);
+                    continue;
+                }
+                work_result Result; // Maybe the file crashes workers
+                Result.Pos = *Pos;
+                Result.Error = true;
+                Result.Lost = true;
+                IsFinished[*Pos] = true;
+                Finished_Count++;
+                if (Finished)
+                    Finished(Result);
+            }
+            Socket_Close(Worker.Socket);
+            Workers.erase(Workers.begin() + i);
+        }
+
+        if (Fds[0].revents & POLLIN)
+        {
+            socket_handle Socket = accept(Listener, nullptr, nullptr);
+            if (Socket != Socket_None)
+            {
+                Workers.emplace_back();
+                Workers.back().Socket = Socket;
+            }
+        }
+    }
+
+    for (auto& Worker : Workers)
+        Socket_Close(Worker.Socket);
+    Socket_Close(Listener);
+    Socket_Remove(SocketName);
+    return IsOk;
+}
+
+//***************************************************************************
+// Client
+//***************************************************************************
+
+//---------------------------------------------------------------------------
+bool work_client::Connect(const Ztring& SocketName, size_t Count, int64u ListHash)
+{
+    sockaddr_un Address;
+    if (!Socket_Init() || !Socket_Address(Address, SocketName))
+    {
+        ErrorMessage = "invalid socket name " + SocketName.To_Local();
+        return false;
+    }
+
+    socket_handle NewSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (NewSocket == Socket_None || connect(NewSocket, (sockaddr*)&Address, sizeof(Address)))
+    {
+        if (NewSocket != Socket_None)
+            Socket_Close(NewSocket);
+        ErrorMessage = "can not connect to the coordinator at " + SocketName.To_Local();
+        return false;
+    }
+    Socket = NewSocket;
+
+    string Line;
+    if (!Send("HELLO\t" + to_string(Count) + '\t' + to_string(ListHash)) || !Receive(Line))
+    {
+        Close();
+        ErrorMessage = "no answer from the coordinator";
+        return false;
+    }
+    if (Line.compare(0, 5, "SLOT\t"))
+    {
+        Close();
+        ErrorMessage = Line.compare(0, 6, "ERROR\t") ? "unexpected answer from the coordinator" : Line.substr(6);
+        return false;
+    }
+    Slot = strtoul(Line.c_str() + 5, nullptr, 10);
+    return true;
+}
+
+//---------------------------------------------------------------------------
+bool work_client::IsConnected()
+{
+    return Socket != (decltype(Socket))Socket_None;
+}
+
+//---------------------------------------------------------------------------
+work_answer work_client::Next(size_t& Pos)
+{
+    const lock_guard<mutex> Lock(Next_Mutex);
+    if (Ended)
+        return WorkAnswer_End;
+
+    string Line;
+    if (!Send("NEXT") || !Receive(Line))
+    {
+        Ended = true;
+        Lost = true;
+        return WorkAnswer_End;
+    }
+    if (!Line.compare(0, 5, "FILE\t"))
+    {
+        Pos = strtoul(Line.c_str() + 5, nullptr, 10);
+        return WorkAnswer_File;
+    }
+    if (Line == "WAIT")
+        return WorkAnswer_Wait;
+    Ended = true;
+    Lost = Line != "END";
+    return WorkAnswer_End;
+}
+
+//---------------------------------------------------------------------------
+void work_client::Finished(const work_result& Result)
+{
+    string Flags;
+    if (Result.Error)
+        Flags += 'E';
+    if (Result.Warning)
+        Flags += 'W';
+    if (Result.Skipped)
+        Flags += 'S';
+    if (Flags.empty())
+        Flags += '-';
+    auto Message = Result.Message;
+    replace(Message.begin(), Message.end(), '\n', ' ');
+    replace(Message.begin(), Message.end(), '\r', ' ');
+
+    Send("DONE\t" + to_string(Result.Pos) + '\t' + Flags + '\t' + Message);
+}
+
+//---------------------------------------------------------------------------
+bool work_client::IsLost()
+{
+    const lock_guard<mutex> Lock(Next_Mutex);
+    return Lost;
+}
+
+//---------------------------------------------------------------------------
+work_client::~work_client()
+{
+    Close();
+}
+
+//---------------------------------------------------------------------------
+bool work_client::Send(const string& Line)
+{
+    const lock_guard<mutex> Lock(Write_Mutex);
+    if (!IsConnected())
+        return false;
+    return Socket_Send((socket_handle)Socket, Line + '\n');
+}
+
+//---------------------------------------------------------------------------
+bool work_client::Receive(string& Line)
+{
+    while (!Line_Get(Buffer, Line))
+    {
+        char Temp[4096];
+        auto Size = Socket_Receive((socket_handle)Socket, Temp, sizeof(Temp));
+        if (!Size)
+            return false;
+        Buffer.append(Temp, Size);
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+void work_client::Close()
+{
+    if (!IsConnected())
+        return;
+    Socket_Close((socket_handle)Socket);
+    Socket = (decltype(Socket))Socket_None;
+}
@@ -0,0 +1,109 @@
+/*  Copyright (c) MediaArea.net SARL. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-2-Clause license that can
+ *  be found in the LICENSE.txt file in the root of the source tree.
+ */
+
+//---------------------------------------------------------------------------
+#pragma once
+#include "ZenLib/Ztring.h"
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+using namespace ZenLib;
+using namespace std;
+//---------------------------------------------------------------------------
+
+//***************************************************************************
+// Protocol
+//***************************************************************************
+
+// Lines over a Unix domain socket, fields are separated by tabs
+// Worker                               Coordinator
+// HELLO <count> <list hash>        ->
+//                                  <-  SLOT <n> (lowest free worker number) or ERROR <message>
+// NEXT                             ->
+//                                  <-  FILE <position in the list>, WAIT (other workers may give files back) or END
+// DONE <pos> <flags> <report line> ->  no answer, flags are E (error), W (warning), S (skipped) or -
+// Files of a worker disconnected before DONE are given to another worker, then reported as lost
+
+struct work_result
+{
+    size_t              Pos = 0;
+    bool                Error = false;
+    bool                Warning = false;
+    bool                Skipped = false;
+    bool                Lost = false;               // Not finished, workers were disconnected during its processing
+    string              Message;                    // Report line, empty if no error and no warning
+};
+
+enum work_answer
+{
+    WorkAnswer_File,
+    WorkAnswer_Wait,                                // Ask again later
+    WorkAnswer_End,                                 // No more work, or coordinator lost
+};
+
+// Both sides must have the same list, in the same order
+int64u Work_ListHash(const vector<string>& Names);
+
+// Shard of a file, 0 to ShardCount - 1, from a name which is the same on all nodes
+size_t Work_Shard(const string& Name, size_t ShardCount);
+
+//***************************************************************************
+// Class work_coordinator
+//***************************************************************************
+
+class work_coordinator
+{
+public:
+    // Input
+    Ztring              SocketName;
+    function<void(const work_result&)> Finished;
+    function<void(const string&)> Warning;
+
+    // Files are given in this order, returns when all files are finished and all workers are disconnected
+    bool                Run(const vector<size_t>& Order, int64u ListHash);
+
+    // Output
+    string              ErrorMessage;
+};
+
+//***************************************************************************
+// Class work_client
+//***************************************************************************
+
+// Next() and Finished() can be called from several threads
+class work_client
+{
+public:
+    // Connection
+    bool                Connect(const Ztring& SocketName, size_t Count, int64u ListHash);
+    bool                IsConnected();
+    size_t              Slot = 0;
+    string              ErrorMessage;
+
+    // Work
+    work_answer         Next(size_t& Pos);
+    void                Finished(const work_result& Result);
+    bool                IsLost();                   // Coordinator disconnected before the end
+
+    ~work_client();
+
+private:
+    #ifdef _WIN32
+        uintptr_t       Socket = (uintptr_t)-1;
+    #else
+        int             Socket = -1;
+    #endif
+    string              Buffer;
+    bool                Ended = false;
+    bool                Lost = false;
+    mutex               Next_Mutex;
+    mutex               Write_Mutex;
+    bool                Send(const string& Line);
+    bool                Receive(string& Line);
+    void                Close();
+};